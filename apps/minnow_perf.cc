@@ -0,0 +1,849 @@
+#include "exception.hh"
+#include "netsim.hh"
+#include "packet_capture.hh"
+#include "socket.hh"
+#include "tcp_config.hh"
+#include "tcp_minnow_socket.hh"
+#include "tcp_minnow_socket_impl.hh"
+#include "trace.hh"
+#include "tun.hh"
+#include "loopback_adapter.hh"
+#include "tuntap_adapter.hh"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <netinet/tcp.h>
+#include <optional>
+#include <random>
+#include <span>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+constexpr const char* TUN_DFLT = "tun144";
+constexpr const char* LOCAL_ADDRESS_DFLT = "169.254.144.9";
+constexpr const char* PORT_DFLT = "5201";
+
+namespace {
+
+// Round trips timed on one connection
+struct TransportCounters
+{
+  mutex lock {};
+  vector<double> rtt_ms {}; // samples since they were last collected
+};
+
+// Wraps a datagram adapter to time the round trip of every segment that the TCPPeer sends through it (per Karn's
+// algorithm, so a sequence range that was ever retransmitted gives no sample). The TCPPeer's own SRTT is a
+// smoothed average, but the report gives percentiles.
+template<TCPDatagramAdapter AdapterT>
+class MeasuredAdapter
+{
+public:
+  MeasuredAdapter( AdapterT&& adapter, shared_ptr<TransportCounters> counters )
+    : adapter_( std::move( adapter ) ), counters_( std::move( counters ) )
+  {}
+
+  optional<TCPMessage> read()
+  {
+    auto msg = adapter_.read();
+    if ( msg ) {
+      time_acks( span { &msg.value(), 1 } );
+    }
+    return msg;
+  }
+
+  void read_batch( vector<TCPMessage>& segments, const size_t max_datagrams )
+  {
+    const size_t first = segments.size();
+    adapter_.read_batch( segments, max_datagrams );
+    time_acks( span { segments }.subspan( first ) );
+  }
+
+  void write( const TCPMessage& seg )
+  {
+    const uint64_t length = seg.sender.sequence_length();
+    if ( seg.sender.SYN and not isn_ ) {
+      isn_ = seg.sender.seqno;
+    }
+    if ( length > 0 and isn_ ) {
+      const uint64_t start = seg.sender.seqno.unwrap( *isn_, highest_sent_ );
+      if ( start < highest_sent_ ) {
+        retransmitted_up_to_ = max( retransmitted_up_to_, start + length );
+      } else {
+        highest_sent_ = start + length;
+        unacked_.push_back( { highest_sent_, steady_clock::now() } );
+      }
+    }
+    adapter_.write( seg );
+  }
+
+  void tick( const size_t ms ) { adapter_.tick( ms ); }
+  FileDescriptor& fd() { return adapter_.fd(); }
+  void set_listening( const bool l ) { adapter_.set_listening( l ); }
+  const FdAdapterConfig& config() const { return adapter_.config(); }
+  FdAdapterConfig& config_mut() { return adapter_.config_mut(); }
+
+private:
+  void time_acks( const span<const TCPMessage> msgs )
+  {
+    if ( not isn_ ) {
+      return;
+    }
+    const auto now = steady_clock::now();
+    const lock_guard lock { counters_->lock };
+    for ( const auto& msg : msgs ) {
+      if ( not msg.receiver.ackno ) {
+        continue;
+      }
+      const uint64_t ackno = msg.receiver.ackno->unwrap( *isn_, highest_sent_ );
+      while ( not unacked_.empty() and unacked_.front().end <= ackno ) {
+        if ( unacked_.front().end > retransmitted_up_to_ ) {
+          counters_->rtt_ms.push_back( duration<double, milli>( now - unacked_.front().sent ).count() );
+        }
+        unacked_.pop_front();
+      }
+    }
+  }
+
+  struct Unacked
+  {
+    uint64_t end;                  // absolute sequence number just past the segment
+    steady_clock::time_point sent; // when it was first sent
+  };
+
+  AdapterT adapter_;
+  shared_ptr<TransportCounters> counters_;
+  optional<Wrap32> isn_ {};
+  uint64_t highest_sent_ {};
+  uint64_t retransmitted_up_to_ {};
+  deque<Unacked> unacked_ {};
+};
+
+} // namespace
+
+template class TCPMinnowSocket<MeasuredAdapter<TCPOverIPv4OverTunFdAdapter>>;
+template class TCPMinnowSocket<MeasuredAdapter<TCPOverIPv4OverLoopbackFdAdapter>>;
+
+namespace {
+
+enum class Mode
+{
+  Client,
+  Server,
+  Loopback
+};
+
+struct Options
+{
+  Mode mode = Mode::Loopback;
+  bool kernel = false;              // use the kernel's TCP instead of minnow
+  string host {};                   // to connect to (client) or bind (server)
+  string port = PORT_DFLT;          // to connect to (client) or bind (server)
+  size_t streams = 1;               // parallel connections
+  optional<uint64_t> bytes {};      // to send per stream (otherwise, send for `seconds`)
+  double seconds = 10;              // to send for, unless `bytes` is set
+  optional<size_t> request_size {}; // request/response mode, with messages of this size
+  double interval = 1;              // between reports, in seconds
+  bool json = false;                // report as JSON
+  string tundev = TUN_DFLT;         // the tun device minnow uses (client and server modes)
+  string source_address = LOCAL_ADDRESS_DFLT;
+  TCPConfig tcp {};
+  shared_ptr<PacketCapture> capture {}; // records the datagrams of minnow's streams, if set
+};
+
+// One connection under test, whichever stack carries it
+class Connection
+{
+public:
+  virtual ~Connection() = default;
+  virtual Socket& socket() = 0;
+
+  // Add the retransmissions so far and the round-trip samples since the last call
+  virtual void collect( uint64_t& retransmits, SampleSet& rtt_ms ) = 0;
+
+  // Once both directions have finished, wait for the stack to finish the connection
+  virtual void finish() {}
+};
+
+template<TCPDatagramAdapter AdapterT>
+class MinnowConnection : public Connection
+{
+public:
+  explicit MinnowConnection( AdapterT&& adapter )
+    : socket_( MeasuredAdapter<AdapterT> { std::move( adapter ), counters_ } )
+  {}
+
+  TCPMinnowSocket<MeasuredAdapter<AdapterT>>& minnow_socket() { return socket_; }
+  Socket& socket() override { return socket_; }
+
+  void collect( uint64_t& retransmits, SampleSet& rtt_ms ) override
+  {
+    retransmits += socket_.stats().retransmits;
+    const lock_guard lock { counters_->lock };
+    for ( const double sample : counters_->rtt_ms ) {
+      rtt_ms.add( sample );
+    }
+    counters_->rtt_ms.clear();
+  }
+
+  void finish() override { socket_.wait_until_closed(); }
+
+private:
+  shared_ptr<TransportCounters> counters_ { make_shared<TransportCounters>() };
+  TCPMinnowSocket<MeasuredAdapter<AdapterT>> socket_;
+};
+
+// Kernel TCP reports its own retransmissions and (smoothed) round-trip time
+class KernelConnection : public Connection
+{
+public:
+  explicit KernelConnection( TCPSocket&& socket ) : socket_( std::move( socket ) ) {}
+
+  Socket& socket() override { return socket_; }
+
+  void collect( uint64_t& retransmits, SampleSet& rtt_ms ) override
+  {
+    tcp_info info {};
+    socklen_t len = sizeof( info );
+    CheckSystemCall( "getsockopt", getsockopt( socket_.fd_num(), IPPROTO_TCP, TCP_INFO, &info, &len ) );
+    retransmits += info.tcpi_total_retrans;
+    rtt_ms.add( static_cast<double>( info.tcpi_rtt ) / 1000 );
+  }
+
+private:
+  TCPSocket socket_;
+};
+
+// Buffered reads of lines and fixed-size messages from a blocking socket
+class Receiver
+{
+public:
+  explicit Receiver( Socket& socket ) : socket_( socket ) {}
+
+  // returns false at EOF
+  bool fill()
+  {
+    if ( not pending_.empty() ) {
+      return true;
+    }
+    buffer_.resize( 65536 );
+    socket_.read( buffer_ );
+    pending_ = buffer_;
+    return not pending_.empty();
+  }
+
+  string read_line()
+  {
+    string line;
+    while ( fill() ) {
+      const auto end = pending_.find( '\n' );
+      line += pending_.substr( 0, end );
+      if ( end != string_view::npos ) {
+        pending_.remove_prefix( end + 1 );
+        return line;
+      }
+      pending_ = {};
+    }
+    throw runtime_error( "connection closed before the test header arrived" );
+  }
+
+  // Read and discard `len` bytes; returns false at EOF
+  bool read_exact( size_t len )
+  {
+    while ( len > 0 ) {
+      if ( not fill() ) {
+        return false;
+      }
+      const size_t n = min( len, pending_.size() );
+      pending_.remove_prefix( n );
+      len -= n;
+    }
+    return true;
+  }
+
+  // Read and discard everything up to EOF, counting the bytes
+  void drain( atomic<uint64_t>& bytes )
+  {
+    while ( fill() ) {
+      bytes += pending_.size();
+      pending_ = {};
+    }
+  }
+
+private:
+  Socket& socket_;
+  string buffer_ {};
+  string_view pending_ {};
+};
+
+void write_all( Socket& socket, string_view data )
+{
+  while ( not data.empty() ) {
+    data.remove_prefix( socket.write( data ) );
+  }
+}
+
+// A connection and what has been measured on it
+struct Stream
+{
+  unique_ptr<Connection> connection {};
+  atomic<uint64_t> bytes {};        // payload bytes sent (client) or received (server) by the application
+  atomic<uint64_t> transactions {}; // request/response round trips completed
+  atomic<bool> done {};
+  mutex latency_lock {};
+  vector<double> latency_ms {}; // request/response round trips since they were last collected
+};
+
+// The first line on each connection tells the server what test the client is running
+string make_header( const Options& options )
+{
+  return "minnow_perf " + to_string( options.streams ) + " " + to_string( options.request_size.value_or( 0 ) )
+         + "\n";
+}
+
+void parse_header( const string& line, Options& options )
+{
+  istringstream in { line };
+  string magic;
+  size_t request_size = 0;
+  if ( not( in >> magic >> options.streams >> request_size ) or magic != "minnow_perf" or options.streams == 0 ) {
+    throw runtime_error( "unrecognized test header: " + line );
+  }
+  if ( request_size > 0 ) {
+    options.request_size = request_size;
+  }
+}
+
+void run_client( Stream& stream, const Options& options, const steady_clock::time_point deadline )
+{
+  Socket& socket = stream.connection->socket();
+  socket.set_blocking( true );
+  write_all( socket, make_header( options ) );
+
+  Receiver receiver { socket };
+  uint64_t remaining = options.bytes.value_or( UINT64_MAX );
+  const auto keep_going = [&] { return remaining > 0 and ( options.bytes or steady_clock::now() < deadline ); };
+
+  if ( options.request_size ) {
+    const string request( *options.request_size, 'q' );
+    while ( keep_going() ) {
+      const auto sent = steady_clock::now();
+      write_all( socket, request );
+      if ( not receiver.read_exact( request.size() ) ) {
+        throw runtime_error( "server closed the connection mid-test" );
+      }
+      const double latency = duration<double, milli>( steady_clock::now() - sent ).count();
+      {
+        const lock_guard lock { stream.latency_lock };
+        stream.latency_ms.push_back( latency );
+      }
+      stream.bytes += request.size();
+      stream.transactions++;
+      remaining -= min( remaining, uint64_t { request.size() } );
+    }
+  } else {
+    const string chunk( 65536, 'x' );
+    while ( keep_going() ) {
+      const size_t len = min( remaining, uint64_t { chunk.size() } );
+      const size_t written = socket.write( string_view { chunk }.substr( 0, len ) );
+      stream.bytes += written;
+      remaining -= written;
+    }
+  }
+
+  // wait for the server to see everything and hang up
+  socket.shutdown( SHUT_WR );
+  atomic<uint64_t> ignored {};
+  receiver.drain( ignored );
+  stream.done = true;
+}
+
+void run_server( Stream& stream, Receiver& receiver, const Options& options )
+{
+  Socket& socket = stream.connection->socket();
+  if ( options.request_size ) {
+    const string response( *options.request_size, 'r' );
+    while ( receiver.read_exact( response.size() ) ) {
+      write_all( socket, response );
+      stream.bytes += response.size();
+      stream.transactions++;
+    }
+  } else {
+    receiver.drain( stream.bytes );
+  }
+  socket.shutdown( SHUT_WR );
+  stream.done = true;
+}
+
+// Accept the server side of a connection and read its header
+void serve( Stream& stream, Options options )
+{
+  stream.connection->socket().set_blocking( true );
+  Receiver receiver { stream.connection->socket() };
+  parse_header( receiver.read_line(), options );
+  run_server( stream, receiver, options );
+}
+
+// Sums over all streams, for one interval or for the whole test
+struct Report
+{
+  double start {};
+  double end {};
+  uint64_t bytes {};
+  uint64_t retransmits {};
+  uint64_t transactions {};
+  SampleSet rtt_ms {};
+  SampleSet latency_ms {};
+
+  double gigabits_per_second() const
+  {
+    return end > start ? 8 * static_cast<double>( bytes ) / ( end - start ) / 1e9 : 0;
+  }
+
+  static string percentiles_json( const SampleSet& samples )
+  {
+    ostringstream out;
+    out << fixed << setprecision( 3 ) << "{\"count\":" << samples.count() << ",\"p50\":" << samples.percentile( 50 )
+        << ",\"p90\":" << samples.percentile( 90 ) << ",\"p99\":" << samples.percentile( 99 ) << "}";
+    return out.str();
+  }
+
+  string json( const bool request_response ) const
+  {
+    ostringstream out;
+    out << fixed << setprecision( 3 ) << "{\"start\":" << start << ",\"end\":" << end << ",\"bytes\":" << bytes
+        << ",\"bits_per_second\":" << setprecision( 0 ) << gigabits_per_second() * 1e9
+        << ",\"retransmits\":" << retransmits << ",\"rtt_ms\":" << percentiles_json( rtt_ms );
+    if ( request_response ) {
+      out << ",\"transactions\":" << transactions << ",\"latency_ms\":" << percentiles_json( latency_ms );
+    }
+    out << "}";
+    return out.str();
+  }
+
+  string text( const bool request_response ) const
+  {
+    ostringstream out;
+    out << fixed << setprecision( 1 ) << "[" << setw( 6 ) << start << "-" << setw( 6 ) << end << " s] "
+        << setw( 9 ) << static_cast<double>( bytes ) / 1e6 << " MB " << setprecision( 3 ) << setw( 8 )
+        << gigabits_per_second() << " Gbit/s  " << setw( 5 ) << retransmits << " retx  rtt p50/p90/p99 "
+        << setprecision( 2 ) << rtt_ms.percentile( 50 ) << "/" << rtt_ms.percentile( 90 ) << "/"
+        << rtt_ms.percentile( 99 ) << " ms";
+    if ( request_response ) {
+      out << "  " << setprecision( 0 ) << static_cast<double>( transactions ) / ( end - start )
+          << " trans/s  latency p50/p90/p99 " << setprecision( 3 ) << latency_ms.percentile( 50 ) << "/"
+          << latency_ms.percentile( 90 ) << "/" << latency_ms.percentile( 99 ) << " ms";
+    }
+    return out.str();
+  }
+};
+
+// Report on the streams every interval until they are all done, then summarize the whole test
+void report( vector<unique_ptr<Stream>>& streams, const Options& options, const string& role )
+{
+  const bool request_response = options.request_size.has_value();
+  const auto start = steady_clock::now();
+  const auto elapsed = [&] { return duration<double>( steady_clock::now() - start ).count(); };
+
+  Report total;
+  vector<string> intervals;
+  uint64_t last_bytes = 0;
+  uint64_t last_retransmits = 0;
+  uint64_t last_transactions = 0;
+
+  bool all_done = false;
+  while ( not all_done ) {
+    Report interval;
+    interval.start = elapsed();
+    while ( elapsed() < interval.start + options.interval ) {
+      all_done = all_of( streams.begin(), streams.end(), []( const auto& s ) { return s->done.load(); } );
+      if ( all_done ) {
+        break;
+      }
+      this_thread::sleep_for( milliseconds( 10 ) );
+    }
+    interval.end = elapsed();
+
+    uint64_t bytes = 0;
+    uint64_t retransmits = 0;
+    uint64_t transactions = 0;
+    for ( auto& stream : streams ) {
+      bytes += stream->bytes;
+      transactions += stream->transactions;
+      stream->connection->collect( retransmits, interval.rtt_ms );
+      const lock_guard lock { stream->latency_lock };
+      for ( const double sample : stream->latency_ms ) {
+        interval.latency_ms.add( sample );
+      }
+      stream->latency_ms.clear();
+    }
+    interval.bytes = bytes - last_bytes;
+    interval.retransmits = retransmits - last_retransmits;
+    interval.transactions = transactions - last_transactions;
+    last_bytes = bytes;
+    last_retransmits = retransmits;
+    last_transactions = transactions;
+
+    total.rtt_ms.add( interval.rtt_ms );
+    total.latency_ms.add( interval.latency_ms );
+    if ( options.json ) {
+      intervals.push_back( interval.json( request_response ) );
+    } else {
+      cout << interval.text( request_response ) << endl;
+    }
+  }
+
+  total.end = elapsed();
+  total.bytes = last_bytes;
+  total.retransmits = last_retransmits;
+  total.transactions = last_transactions;
+
+  if ( options.json ) {
+    cout << "{\"role\":\"" << role << "\",\"stack\":\"" << ( options.kernel ? "kernel" : "minnow" )
+         << "\",\"streams\":" << streams.size() << ",\"intervals\":[";
+    for ( size_t i = 0; i < intervals.size(); i++ ) {
+      cout << ( i ? "," : "" ) << intervals[i];
+    }
+    cout << "],\"end\":" << total.json( request_response ) << "}\n";
+  } else {
+    cout << "- - - - - - - - - - - - - - - - - - - - - - - - -\n" << total.text( request_response ) << "  (" << role
+         << ", " << ( options.kernel ? "kernel" : "minnow" ) << ", " << streams.size() << " stream"
+         << ( streams.size() == 1 ? "" : "s" ) << ")\n";
+  }
+}
+
+// Run the client side of every stream, reporting from this thread
+void run_clients( vector<unique_ptr<Stream>>& streams, const Options& options )
+{
+  const auto deadline
+    = steady_clock::now() + duration_cast<steady_clock::duration>( duration<double>( options.seconds ) );
+  vector<thread> workers;
+  for ( auto& stream : streams ) {
+    workers.emplace_back( [&stream, &options, deadline] { run_client( *stream, options, deadline ); } );
+  }
+  report( streams, options, "client" );
+  for ( auto& worker : workers ) {
+    worker.join();
+  }
+}
+
+// A minnow stream's adapter to the tun device
+TCPOverIPv4OverTunFdAdapter tun_adapter( const Options& options )
+{
+  TCPOverIPv4OverTunFdAdapter adapter { TunFD { options.tundev } };
+  adapter.set_capture( options.capture );
+  return adapter;
+}
+
+// Client mode: connect each stream to the server, over tun (minnow) or the kernel's TCP
+void client_main( const Options& options )
+{
+  vector<unique_ptr<Stream>> streams;
+  for ( size_t i = 0; i < options.streams; i++ ) {
+    auto& stream = *streams.emplace_back( make_unique<Stream>() );
+    if ( options.kernel ) {
+      TCPSocket socket;
+      socket.connect( Address { options.host, options.port } );
+      stream.connection = make_unique<KernelConnection>( std::move( socket ) );
+    } else {
+      FdAdapterConfig adapter_config;
+      adapter_config.source
+        = IPv4Endpoint { Address { options.source_address, static_cast<uint16_t>( random_device()() ) } };
+      adapter_config.destination = IPv4Endpoint { Address { options.host, options.port } };
+      auto connection = make_unique<MinnowConnection<TCPOverIPv4OverTunFdAdapter>>( tun_adapter( options ) );
+      connection->minnow_socket().connect( options.tcp, adapter_config );
+      stream.connection = std::move( connection );
+    }
+  }
+
+  run_clients( streams, options );
+  for ( auto& stream : streams ) {
+    stream->connection->finish();
+  }
+}
+
+// Server mode: accept the streams of one test (the first one's header says how many), then report on them
+void server_main( Options options )
+{
+  vector<unique_ptr<Stream>> streams;
+  vector<thread> workers;
+  optional<TCPSocket> listener;
+  if ( options.kernel ) {
+    listener.emplace();
+    listener->set_reuseaddr();
+    listener->bind( Address { options.host, options.port } );
+    listener->listen();
+  }
+
+  const auto accept_one = [&]() -> Stream& {
+    auto& stream = *streams.emplace_back( make_unique<Stream>() );
+    if ( options.kernel ) {
+      stream.connection = make_unique<KernelConnection>( listener->accept() );
+    } else {
+      FdAdapterConfig adapter_config;
+      adapter_config.source = IPv4Endpoint { Address { options.host, options.port } };
+      auto connection = make_unique<MinnowConnection<TCPOverIPv4OverTunFdAdapter>>( tun_adapter( options ) );
+      connection->minnow_socket().listen_and_accept( options.tcp, adapter_config );
+      stream.connection = std::move( connection );
+    }
+    return stream;
+  };
+
+  // the first stream's header says how many more to expect
+  Stream& first = accept_one();
+  first.connection->socket().set_blocking( true );
+  auto receiver = make_shared<Receiver>( first.connection->socket() );
+  parse_header( receiver->read_line(), options );
+  if ( not options.kernel and options.streams > 1 ) {
+    throw runtime_error( "a minnow server over tun accepts only one stream" );
+  }
+  workers.emplace_back( [&first, receiver, options] { run_server( first, *receiver, options ); } );
+
+  for ( size_t i = 1; i < options.streams; i++ ) {
+    Stream& stream = accept_one();
+    workers.emplace_back( [&stream, options] { serve( stream, options ); } );
+  }
+
+  report( streams, options, "server" );
+  for ( auto& worker : workers ) {
+    worker.join();
+  }
+  for ( auto& stream : streams ) {
+    stream->connection->finish();
+  }
+}
+
+// Loopback mode: both ends in this process, over an in-process link (minnow) or 127.0.0.1 (kernel)
+void loopback_main( const Options& options )
+{
+  vector<unique_ptr<Stream>> clients;
+  vector<unique_ptr<Stream>> servers;
+  vector<thread> workers;
+
+  optional<TCPSocket> listener;
+  if ( options.kernel ) {
+    listener.emplace();
+    listener->bind( Address { "127.0.0.1", 0 } );
+    listener->listen();
+  }
+
+  for ( size_t i = 0; i < options.streams; i++ ) {
+    auto& client = *clients.emplace_back( make_unique<Stream>() );
+    auto& server = *servers.emplace_back( make_unique<Stream>() );
+
+    if ( options.kernel ) {
+      TCPSocket socket;
+      socket.connect( listener->local_address() );
+      client.connection = make_unique<KernelConnection>( std::move( socket ) );
+      server.connection = make_unique<KernelConnection>( listener->accept() );
+      workers.emplace_back( [&server, options] { serve( server, options ); } );
+      continue;
+    }
+
+    using LoopbackConnection = MinnowConnection<TCPOverIPv4OverLoopbackFdAdapter>;
+    auto [client_end, server_end] = TCPOverIPv4OverLoopbackFdAdapter::make_pair();
+    client_end.set_capture( options.capture );
+    auto client_connection = make_unique<LoopbackConnection>( std::move( client_end ) );
+    auto server_connection = make_unique<LoopbackConnection>( std::move( server_end ) );
+
+    FdAdapterConfig client_config;
+    client_config.source = IPv4Endpoint { Address { "10.144.0.1", static_cast<uint16_t>( 40000 + i ) } };
+    client_config.destination = IPv4Endpoint { Address { "10.144.0.2", options.port } };
+    FdAdapterConfig server_config;
+    server_config.source = client_config.destination;
+
+    // listen_and_accept() blocks, so the server side accepts on its own thread
+    server.connection = std::move( server_connection );
+    auto* const server_socket = &dynamic_cast<LoopbackConnection&>( *server.connection ).minnow_socket();
+    workers.emplace_back( [&server, server_socket, server_config, options] {
+      server_socket->listen_and_accept( options.tcp, server_config );
+      serve( server, options );
+    } );
+    client_connection->minnow_socket().connect( options.tcp, client_config );
+    client.connection = std::move( client_connection );
+  }
+
+  run_clients( clients, options );
+  for ( auto& worker : workers ) {
+    worker.join();
+  }
+  for ( auto& stream : clients ) {
+    stream->connection->finish();
+  }
+  for ( auto& stream : servers ) {
+    stream->connection->finish();
+  }
+}
+
+void show_usage( const char* argv0, const char* msg )
+{
+  cout << "Usage: " << argv0 << " [options] -c <host> [<port>]   (client)\n"
+       << "       " << argv0 << " [options] -s <host> [<port>]   (server; <host>:<port> is the address to bind)\n"
+       << "       " << argv0 << " [options] -L                   (loopback: client and server in this process)\n\n"
+       << "   Option                                                          Default\n"
+       << "   --                                                              --\n\n"
+
+       << "   -k              Use the kernel's TCP instead of minnow          (minnow)\n"
+       << "   -P <n>          Run <n> parallel streams                        1\n"
+       << "   -n <bytes>      Send <bytes> per stream                         (see -t)\n"
+       << "   -t <secs>       Send for <secs>                                 10\n"
+       << "   -r <bytes>      Request/response mode, with <bytes> each way    (bulk transfer)\n"
+       << "   -i <secs>       Report every <secs>                             1\n"
+       << "   -J              Report as JSON                                  (text)\n\n"
+
+       << "   -a <addr>       Set source address (minnow client only)         " << LOCAL_ADDRESS_DFLT << "\n"
+       << "   -d <tundev>     Connect to tun <tundev> (minnow only)           " << TUN_DFLT << "\n"
+       << "   -w <winsz>      Use a window of <winsz> bytes (minnow only)     " << TCPConfig::DEFAULT_CAPACITY
+       << "\n"
+       << "   -T <tmout>      Set rt_timeout to tmout (minnow only)           100\n"
+       << "   -C <file>       Capture the datagrams to a pcap <file> (minnow  (no capture)\n"
+       << "                   only; replay it with pcap_replay)\n\n"
+
+       << "   -h              Show this message.\n\n"
+
+       << "   With MINNOW_TRACE=<file> in the environment, events are traced and dumped to <file> on exit,\n"
+       << "   on a crash or on SIGUSR1 (decode it with trace_dump).\n\n";
+
+  if ( msg != nullptr ) {
+    cout << msg;
+  }
+  cout << endl;
+}
+
+Options get_options( const span<char*>& args )
+{
+  Options options;
+  options.tcp.isn = Wrap32 { random_device()() };
+  options.tcp.rt_timeout = 100;
+
+  const auto fail = [&]( const string& msg ) {
+    show_usage( args.front(), msg.c_str() );
+    exit( 1 );
+  };
+
+  bool mode_given = false;
+  vector<string> positional;
+  for ( size_t curr = 1; curr < args.size(); curr++ ) {
+    const string_view arg = args[curr];
+    const auto value = [&] {
+      if ( curr + 1 >= args.size() ) {
+        fail( "ERROR: " + string( arg ) + " requires one argument." );
+      }
+      return args[++curr];
+    };
+
+    if ( arg == "-c" or arg == "-s" or arg == "-L" ) {
+      options.mode = arg == "-c" ? Mode::Client : arg == "-s" ? Mode::Server : Mode::Loopback;
+      mode_given = true;
+    } else if ( arg == "-k" ) {
+      options.kernel = true;
+    } else if ( arg == "-P" ) {
+      options.streams = strtoull( value(), nullptr, 0 );
+    } else if ( arg == "-n" ) {
+      options.bytes = strtoull( value(), nullptr, 0 );
+    } else if ( arg == "-t" ) {
+      options.seconds = strtod( value(), nullptr );
+    } else if ( arg == "-r" ) {
+      options.request_size = strtoull( value(), nullptr, 0 );
+    } else if ( arg == "-i" ) {
+      options.interval = strtod( value(), nullptr );
+    } else if ( arg == "-J" ) {
+      options.json = true;
+    } else if ( arg == "-a" ) {
+      options.source_address = value();
+    } else if ( arg == "-d" ) {
+      options.tundev = value();
+    } else if ( arg == "-w" ) {
+      options.tcp.recv_capacity = strtoull( value(), nullptr, 0 );
+    } else if ( arg == "-T" ) {
+      options.tcp.rt_timeout = strtoul( value(), nullptr, 0 );
+    } else if ( arg == "-C" ) {
+      // whole datagrams, so they can be replayed
+      options.capture = make_shared<PacketCapture>(
+        value(),
+        PacketCapture::LinkType::IPv4,
+        CaptureOptions { .snap_length = TCPOverIPv4Adapter::HEADROOM + TCPConfig::MAX_PAYLOAD_SIZE } );
+    } else if ( arg == "-h" ) {
+      show_usage( args.front(), nullptr );
+      exit( 0 );
+    } else if ( arg.starts_with( '-' ) ) {
+      fail( "ERROR: unrecognized option " + string( arg ) );
+    } else {
+      positional.emplace_back( arg );
+    }
+  }
+
+  if ( not mode_given ) {
+    fail( "ERROR: one of -c, -s and -L is required." );
+  }
+  if ( options.streams == 0 or options.interval <= 0 or options.request_size == size_t { 0 } ) {
+    fail( "ERROR: -P, -i and -r must be positive." );
+  }
+  if ( options.mode == Mode::Loopback ) {
+    if ( not positional.empty() ) {
+      fail( "ERROR: loopback mode takes no address." );
+    }
+  } else {
+    if ( positional.empty() or positional.size() > 2 ) {
+      fail( "ERROR: client and server modes take <host> [<port>]." );
+    }
+    options.host = positional.at( 0 );
+    if ( positional.size() == 2 ) {
+      options.port = positional.at( 1 );
+    }
+  }
+  if ( options.mode == Mode::Client and not options.kernel and options.streams > 1 ) {
+    fail( "ERROR: a minnow client over tun runs only one stream (the tun device can't be shared)." );
+  }
+
+  return options;
+}
+
+} // namespace
+
+int main( int argc, char** argv )
+{
+  try {
+    if ( argc <= 0 ) {
+      abort(); // For sticklers: don't try to access argv[0] if argc <= 0.
+    }
+
+    const Options options = get_options( span( argv, argc ) );
+    Trace::configure_from_environment();
+    switch ( options.mode ) {
+      case Mode::Client:
+        client_main( options );
+        break;
+      case Mode::Server:
+        server_main( options );
+        break;
+      case Mode::Loopback:
+        loopback_main( options );
+        break;
+    }
+
+    if ( options.capture ) {
+      const auto stats = options.capture->stats();
+      cerr << "Captured " << stats.captured << " datagrams (" << stats.dropped
+           << " more dropped because the capture fell behind).\n";
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
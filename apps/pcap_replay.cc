@@ -0,0 +1,449 @@
+#include "arp_message.hh"
+#include "ethernet_frame.hh"
+#include "ipv4_datagram.hh"
+#include "network_interface.hh"
+#include "packet_capture.hh"
+#include "parser.hh"
+#include "router.hh"
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+#include "tcp_segment.hh"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+// Allocations are counted while packets are being replayed
+namespace {
+bool counting_allocations = false;
+uint64_t allocations = 0;
+} // namespace
+
+void* operator new( const size_t size )
+{
+  allocations += counting_allocations;
+  if ( void* ptr = malloc( size ) ) { // NOLINT(*-no-malloc, *-owning-memory)
+    return ptr;
+  }
+  throw bad_alloc {};
+}
+
+void operator delete( void* ptr ) noexcept
+{
+  free( ptr ); // NOLINT(*-no-malloc, *-owning-memory)
+}
+
+void operator delete( void* ptr, const size_t size [[maybe_unused]] ) noexcept
+{
+  free( ptr ); // NOLINT(*-no-malloc, *-owning-memory)
+}
+
+namespace {
+
+enum class Mode
+{
+  Router,
+  TCP,
+};
+
+struct Options
+{
+  Mode mode = Mode::Router;
+  string pcap_path {};
+  string routes_path {};
+  bool original_timing = false;
+  size_t loops = 1;
+};
+
+void show_usage( const char* argv0, const char* msg )
+{
+  cout << "Usage: " << argv0 << " [options] <pcap>\n\n"
+       << "   Replays a capture (of Ethernet frames or IPv4 datagrams, e.g. from tcp_ipv4 -C) into minnow, and\n"
+       << "   reports how fast minnow processed it.\n\n"
+       << "   Option                                                          Default\n"
+       << "   --                                                              --\n\n"
+
+       << "   -m router       Feed the frames to a Router's first interface   router\n"
+       << "   -m tcp          Feed the TCP segments sent to one endpoint (the\n"
+       << "                   first SYN's destination) to a TCPPeer\n\n"
+
+       << "   -R <file>       Routes, one per line: <prefix>/<length>         0.0.0.0/0 via\n"
+       << "                   <next hop or \"direct\"> <interface (from 1)>     10.255.1.1 on 1\n\n"
+
+       << "   -T              Replay at the original timing                   (as fast as possible)\n"
+       << "   -l <loops>      Replay the capture <loops> times                1\n"
+       << "   -h              Show this message.\n\n";
+
+  if ( msg != nullptr ) {
+    cout << msg;
+  }
+  cout << endl;
+}
+
+Options get_options( const span<char*> args )
+{
+  Options options;
+  for ( size_t curr = 1; curr < args.size(); curr++ ) {
+    const string_view arg = args[curr];
+    const auto value = [&] {
+      if ( curr + 1 >= args.size() ) {
+        show_usage( args.front(), ( "ERROR: " + string( arg ) + " requires one argument." ).c_str() );
+        exit( 1 );
+      }
+      return string( args[++curr] );
+    };
+
+    if ( arg == "-m" ) {
+      const string mode = value();
+      if ( mode != "router" and mode != "tcp" ) {
+        show_usage( args.front(), "ERROR: -m must be router or tcp." );
+        exit( 1 );
+      }
+      options.mode = mode == "router" ? Mode::Router : Mode::TCP;
+    } else if ( arg == "-R" ) {
+      options.routes_path = value();
+    } else if ( arg == "-T" ) {
+      options.original_timing = true;
+    } else if ( arg == "-l" ) {
+      options.loops = stoul( value() );
+    } else if ( arg == "-h" ) {
+      show_usage( args.front(), nullptr );
+      exit( 0 );
+    } else if ( options.pcap_path.empty() and not arg.starts_with( '-' ) ) {
+      options.pcap_path = arg;
+    } else {
+      show_usage( args.front(), ( "ERROR: unrecognized option " + string( arg ) ).c_str() );
+      exit( 1 );
+    }
+  }
+
+  if ( options.pcap_path.empty() ) {
+    show_usage( args.front(), "ERROR: required arguments are missing." );
+    exit( 1 );
+  }
+  return options;
+}
+
+//! Replays timed packets, either back to back or spaced out as they were captured
+class Replayer
+{
+public:
+  Replayer( const Options& options, uint64_t first_ns ) : options_( options ), first_ns_( first_ns ) {}
+
+  //! Wait (at the original timing) until the packet captured at `time_ns` is due; returns the ms that passed
+  uint64_t wait_for( const uint64_t time_ns )
+  {
+    if ( not options_.original_timing ) {
+      return 0;
+    }
+    const auto due = start_ + nanoseconds { time_ns - first_ns_ };
+    this_thread::sleep_until( due );
+    const uint64_t now_ms = duration_cast<milliseconds>( due - start_ ).count();
+    return now_ms - exchange( elapsed_ms_, now_ms );
+  }
+
+  //! Time `process`, counting its allocations
+  template<typename Process>
+  void measure( Process&& process )
+  {
+    const auto begin = steady_clock::now();
+    counting_allocations = true;
+    process();
+    counting_allocations = false;
+    busy_ += steady_clock::now() - begin;
+  }
+
+  void restart()
+  {
+    start_ = steady_clock::now();
+    elapsed_ms_ = 0;
+  }
+
+  nanoseconds busy() const { return busy_; }
+
+private:
+  const Options& options_;
+  uint64_t first_ns_;
+  steady_clock::time_point start_ { steady_clock::now() };
+  uint64_t elapsed_ms_ {};
+  nanoseconds busy_ {};
+};
+
+struct Result
+{
+  uint64_t packets {};
+  nanoseconds busy {};
+  uint64_t allocations {};
+  string detail {};
+};
+
+// An output port that counts the frames sent through it
+class CountingPort : public NetworkInterface::OutputPort
+{
+public:
+  uint64_t frames {};
+  void transmit( const NetworkInterface& /* sender */, const EthernetFrame& /* frame */ ) override { frames++; }
+};
+
+constexpr EthernetAddress INBOUND_ETHERNET { 0x02, 0, 0, 0, 0, 1 };
+constexpr EthernetAddress NEIGHBOR_ETHERNET { 0x02, 0, 0, 0, 0xff, 0xff };
+
+struct Route
+{
+  uint32_t prefix;
+  uint8_t prefix_length;
+  optional<Address> next_hop;
+  size_t interface;
+};
+
+vector<Route> read_routes( const string& path )
+{
+  if ( path.empty() ) {
+    return { { 0, 0, Address { "10.255.1.1" }, 1 } };
+  }
+
+  ifstream file { path };
+  if ( not file ) {
+    throw runtime_error( "could not open " + path );
+  }
+  vector<Route> routes;
+  string line;
+  while ( getline( file, line ) ) {
+    if ( line.empty() or line.starts_with( '#' ) ) {
+      continue;
+    }
+    istringstream fields { line };
+    string prefix;
+    string next_hop;
+    size_t interface = 0;
+    const bool parsed = static_cast<bool>( fields >> prefix >> next_hop >> interface );
+    const size_t slash = prefix.find( '/' );
+    if ( not parsed or slash == string::npos or interface == 0 ) {
+      throw runtime_error( path + ": bad route \"" + line + "\"" );
+    }
+    routes.push_back( { Address { prefix.substr( 0, slash ) }.ipv4_numeric(),
+                        static_cast<uint8_t>( stoul( prefix.substr( slash + 1 ) ) ),
+                        next_hop == "direct" ? optional<Address> {} : Address { next_hop },
+                        interface } );
+  }
+  return routes;
+}
+
+// The frames of the capture, addressed to the router's first interface
+vector<pair<uint64_t, EthernetFrame>> frames_of( const PcapFile& pcap )
+{
+  vector<pair<uint64_t, EthernetFrame>> frames;
+  for ( const auto& packet : pcap.packets ) {
+    if ( packet.data.size() < packet.original_length ) {
+      continue; // cut to the snap length
+    }
+    EthernetFrame frame;
+    if ( pcap.link_type == static_cast<uint32_t>( PacketCapture::LinkType::Ethernet ) ) {
+      if ( not parse( frame, packet.data ) ) {
+        continue;
+      }
+      if ( frame.header.dst != ETHERNET_BROADCAST ) {
+        frame.header.dst = INBOUND_ETHERNET;
+      }
+    } else {
+      frame = { { INBOUND_ETHERNET, NEIGHBOR_ETHERNET, EthernetHeader::TYPE_IPv4 }, { packet.data } };
+    }
+    frames.emplace_back( packet.time_ns, std::move( frame ) );
+  }
+  return frames;
+}
+
+Result replay_router( const Options& options, const PcapFile& pcap )
+{
+  const auto frames = frames_of( pcap );
+  const auto routes = read_routes( options.routes_path );
+  if ( frames.empty() ) {
+    throw runtime_error( "no complete frames to replay" );
+  }
+
+  auto port = make_shared<CountingPort>();
+  Replayer replayer { options, frames.front().first };
+  uint64_t delivered = 0;
+  for ( size_t loop = 0; loop < options.loops; loop++ ) {
+    Router router;
+    vector<shared_ptr<NetworkInterface>> interfaces;
+    const auto add_interface = [&]( const EthernetAddress& ethernet, const string& ip ) {
+      interfaces.push_back(
+        make_shared<NetworkInterface>( "if" + to_string( interfaces.size() ), port, ethernet, Address { ip } ) );
+      router.add_interface( interfaces.back() );
+    };
+
+    add_interface( INBOUND_ETHERNET, "10.0.0.1" );
+    for ( const auto& route : routes ) {
+      while ( interfaces.size() <= route.interface ) {
+        const auto n = static_cast<uint8_t>( interfaces.size() );
+        add_interface( { 0x02, 0, 0, 0, n, 0 }, "10.255." + to_string( n ) + ".2" );
+      }
+      router.add_route( route.prefix, route.prefix_length, route.next_hop, route.interface );
+
+      // answer for the next hop up front, so datagrams to it need not wait for ARP
+      if ( route.next_hop.has_value() ) {
+        const uint8_t n = static_cast<uint8_t>( route.interface );
+        ARPMessage reply;
+        reply.opcode = ARPMessage::OPCODE_REPLY;
+        reply.sender_ethernet_address = NEIGHBOR_ETHERNET;
+        reply.sender_ip_address = route.next_hop->ipv4_numeric();
+        reply.target_ethernet_address = { 0x02, 0, 0, 0, n, 0 };
+        reply.target_ip_address = Address { "10.255." + to_string( n ) + ".2" }.ipv4_numeric();
+        interfaces.at( route.interface )
+          ->recv_frame( { { reply.target_ethernet_address, NEIGHBOR_ETHERNET, EthernetHeader::TYPE_ARP },
+                          serialize( reply ) } );
+      }
+    }
+
+    replayer.restart();
+    for ( const auto& [time_ns, frame] : frames ) {
+      if ( const uint64_t ms = replayer.wait_for( time_ns ) ) {
+        for ( const auto& interface : interfaces ) {
+          interface->tick( ms );
+        }
+      }
+      replayer.measure( [&] {
+        interfaces.front()->recv_frame( frame );
+        router.route();
+      } );
+    }
+
+    // datagrams addressed to the router itself are left in its interfaces' queues
+    for ( const auto& interface : interfaces ) {
+      delivered += interface->datagrams_received().size();
+    }
+  }
+
+  const uint64_t packets = frames.size() * options.loops;
+  return { packets,
+           replayer.busy(),
+           allocations,
+           "frames sent: " + to_string( port->frames ) + ", datagrams for the router itself: "
+             + to_string( delivered ) };
+}
+
+// The TCP segments sent to the first SYN's destination
+vector<pair<uint64_t, TCPMessage>> segments_of( const PcapFile& pcap, string& endpoint )
+{
+  optional<pair<uint32_t, uint16_t>> server;
+  vector<pair<uint64_t, TCPMessage>> segments;
+  for ( const auto& packet : pcap.packets ) {
+    string_view datagram = packet.data;
+    if ( pcap.link_type == static_cast<uint32_t>( PacketCapture::LinkType::Ethernet ) ) {
+      if ( datagram.size() < EthernetHeader::LENGTH
+           or datagram.substr( 12, 2 ) != string_view { "\x08\x00", 2 } ) {
+        continue;
+      }
+      datagram.remove_prefix( EthernetHeader::LENGTH );
+    }
+
+    Parser parser { datagram };
+    IPv4Header header;
+    header.parse( parser );
+    if ( parser.has_error() or header.proto != IPv4Header::PROTO_TCP ) {
+      continue;
+    }
+    TCPSegment segment;
+    segment.parse( parser, header.pseudo_checksum() );
+    if ( parser.has_error() ) {
+      continue;
+    }
+
+    if ( not server.has_value() and segment.message.sender.SYN and not segment.message.receiver.ackno ) {
+      server = { header.dst, segment.udinfo.dst_port };
+      endpoint = Address::from_ipv4_numeric( header.dst ).ip() + ":" + to_string( segment.udinfo.dst_port );
+    }
+    if ( server == pair { header.dst, segment.udinfo.dst_port } ) {
+      segments.emplace_back( packet.time_ns, std::move( segment.message ) );
+    }
+  }
+  return segments;
+}
+
+Result replay_tcp( const Options& options, const PcapFile& pcap )
+{
+  string endpoint;
+  const auto segments = segments_of( pcap, endpoint );
+  if ( segments.empty() ) {
+    throw runtime_error( "no TCP connection (starting with a SYN) to replay" );
+  }
+
+  Replayer replayer { options, segments.front().first };
+  uint64_t sent = 0;
+  uint64_t bytes_delivered = 0;
+  const auto transmit = [&]( const TCPMessage& msg [[maybe_unused]] ) { sent++; };
+  for ( size_t loop = 0; loop < options.loops; loop++ ) {
+    TCPConfig config;
+    config.recv_capacity = TCPConfig::DEFAULT_CAPACITY * 16;
+    TCPPeer peer { config };
+
+    replayer.restart();
+    for ( const auto& [time_ns, msg] : segments ) {
+      if ( const uint64_t ms = replayer.wait_for( time_ns ) ) {
+        peer.tick( ms, transmit );
+      }
+      replayer.measure( [&] {
+        peer.receive( msg, transmit );
+        Reader& inbound = peer.inbound_reader();
+        bytes_delivered += inbound.bytes_buffered();
+        inbound.pop( inbound.bytes_buffered() );
+      } );
+    }
+  }
+
+  const uint64_t packets = segments.size() * options.loops;
+  return { packets,
+           replayer.busy(),
+           allocations,
+           "segments to " + endpoint + ", bytes delivered: " + to_string( bytes_delivered )
+             + ", segments sent in reply: " + to_string( sent ) };
+}
+
+} // namespace
+
+int main( int argc, char** argv )
+{
+  try {
+    if ( argc <= 0 ) {
+      abort(); // For sticklers: don't try to access argv[0] if argc <= 0.
+    }
+
+    const Options options = get_options( span( argv, argc ) );
+    const PcapFile pcap = PcapFile::read( options.pcap_path );
+    if ( pcap.link_type != static_cast<uint32_t>( PacketCapture::LinkType::Ethernet )
+         and pcap.link_type != static_cast<uint32_t>( PacketCapture::LinkType::IPv4 )
+         and pcap.link_type != 101 ) { // LINKTYPE_RAW, which tcpdump writes for TUN devices
+      throw runtime_error( options.pcap_path + ": unsupported link type " + to_string( pcap.link_type ) );
+    }
+
+    const Result result
+      = options.mode == Mode::Router ? replay_router( options, pcap ) : replay_tcp( options, pcap );
+    const double seconds = duration<double>( result.busy ).count();
+    cout << fixed << setprecision( 2 ) << "replayed " << result.packets << " packets in " << setprecision( 3 )
+         << seconds << " s of processing: " << setprecision( 2 ) << result.packets / seconds / 1e6
+         << " Mpacket/s, " << static_cast<double>( result.busy.count() ) / result.packets << " ns/packet, "
+         << static_cast<double>( result.allocations ) / result.packets << " allocations/packet\n"
+         << result.detail << "\n";
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -1,15 +1,22 @@
 #include "bidirectional_stream_copy.hh"
+#include "packet_capture.hh"
 #include "tcp_config.hh"
 #include "tcp_minnow_socket.hh"
+#include "trace.hh"
 #include "tun.hh"
 
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <memory>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
 #include <random>
 #include <span>
 #include <string>
+#include <thread>
 #include <tuple>
 
 using namespace std;
@@ -35,12 +42,43 @@ void show_usage( const char* argv0, const char* msg )
 
        << "   -t <tmout>      Set rt_timeout to tmout                         " << TCPConfig::TIMEOUT_DFLT << "\n\n"
 
+       << "   -N <policy>     When to send small segments: nodelay, nagle     nodelay\n"
+       << "                   or cork (hold them for up to <ms>, see -Nc)\n"
+       << "   -Nc <ms>        Hold small segments for up to <ms> (cork)       " << TCPConfig {}.cork_ms << "\n\n"
+
+       << "   -A <ms>         Delay acknowledgments by up to <ms>             " << TCPConfig {}.ack_delay_ms
+       << "\n\n"
+
+       << "   -p <kbit/s>     Pace segments at <kbit/s> (0: at 1.25 times     (no pacing)\n"
+       << "                   the peer's window per round trip)\n\n"
+
        << "   -d <tundev>     Connect to tun <tundev>                         " << TUN_DFLT << "\n\n"
 
+       << "   -S <ms>         Print connection statistics to stderr every     (never)\n"
+       << "                   <ms> milliseconds (0: only when it closes)\n\n"
+
+       << "   -C <file>       Capture the datagrams sent and received to a    (no capture)\n"
+       << "                   pcap <file>\n"
+       << "   -Cs <bytes>     Capture the first <bytes> of each datagram      256\n"
+       << "   -Cn <n>         Capture one datagram in <n>                     1\n\n"
+
        << "   -Lu <loss>      Set uplink loss to <rate> (float in 0..1)       (no loss)\n"
        << "   -Ld <loss>      Set downlink loss to <rate> (float in 0..1)     (no loss)\n\n"
 
-       << "   -h              Show this message.\n\n";
+       << "   -D <ms>         Delay outgoing datagrams by <ms>                (no delay)\n"
+       << "   -J <ms>         Vary the delay by up to <ms> either way         (no jitter)\n"
+       << "   -R <kbit/s>     Limit the outgoing rate to <kbit/s>             (unlimited)\n"
+       << "   -Q <bytes>      Queue up to <bytes> behind the rate limit       65536\n"
+       << "   -Pr <prob>      Let outgoing datagrams overtake with <prob>     (no reordering)\n"
+       << "   -Pd <prob>      Duplicate outgoing datagrams with <prob>        (no duplicates)\n"
+       << "   -Gb <prob>      Bursty loss: enter the bad state with <prob>    (never)\n"
+       << "   -Gg <prob>      Bursty loss: leave the bad state with <prob>    1\n"
+       << "   -Gl <loss>      Bursty loss: loss rate in the bad state         1\n\n"
+
+       << "   -h              Show this message.\n\n"
+
+       << "   With MINNOW_TRACE=<file> in the environment, events are traced and dumped to <file> on exit,\n"
+       << "   on a crash or on SIGUSR1 (decode it with trace_dump).\n\n";
 
   if ( msg != nullptr ) {
     cout << msg;
@@ -56,16 +94,25 @@ void check_argc( const span<char*>& args, size_t curr, const char* err )
   }
 }
 
-tuple<TCPConfig, FdAdapterConfig, bool, const char*> get_config( const span<char*>& args )
+struct AppConfig
+{
+  bool listen = false;
+  const char* tundev = nullptr;
+  optional<uint64_t> stats_interval_ms {};
+  const char* capture_path = nullptr;
+  CaptureOptions capture {};
+};
+
+tuple<TCPConfig, FdAdapterConfig, EmulationConfig, AppConfig> get_config( const span<char*>& args )
 {
   TCPConfig c_fsm {};
   c_fsm.isn = Wrap32 { random_device()() };
 
   FdAdapterConfig c_filt {};
-  const char* tundev = nullptr;
+  EmulationConfig c_emu {};
+  AppConfig c_app {};
 
   size_t curr = 1;
-  bool listen = false;
   const size_t argc = args.size();
 
   string source_address = LOCAL_ADDRESS_DFLT;
@@ -73,7 +120,7 @@ tuple<TCPConfig, FdAdapterConfig, bool, const char*> get_config( const span<char
 
   while ( argc - curr > 2 ) {
     if ( strncmp( "-l", args[curr], 3 ) == 0 ) {
-      listen = true;
+      c_app.listen = true;
       curr += 1;
 
     } else if ( strncmp( "-a", args[curr], 3 ) == 0 ) {
@@ -96,9 +143,60 @@ tuple<TCPConfig, FdAdapterConfig, bool, const char*> get_config( const span<char
       c_fsm.rt_timeout = strtol( args[curr + 1], nullptr, 0 );
       curr += 2;
 
+    } else if ( strncmp( "-N", args[curr], 3 ) == 0 ) {
+      check_argc( args, curr, "ERROR: -N requires one argument." );
+      const string policy = args[curr + 1];
+      if ( policy == "nodelay" ) {
+        c_fsm.send_policy = TCPConfig::SendPolicy::NoDelay;
+      } else if ( policy == "nagle" ) {
+        c_fsm.send_policy = TCPConfig::SendPolicy::Nagle;
+      } else if ( policy == "cork" ) {
+        c_fsm.send_policy = TCPConfig::SendPolicy::AutoCork;
+      } else {
+        show_usage( args.front(), "ERROR: -N requires nodelay, nagle or cork." );
+        exit( 1 );
+      }
+      curr += 2;
+
+    } else if ( strncmp( "-Nc", args[curr], 4 ) == 0 ) {
+      check_argc( args, curr, "ERROR: -Nc requires one argument." );
+      c_fsm.cork_ms = strtol( args[curr + 1], nullptr, 0 );
+      curr += 2;
+
+    } else if ( strncmp( "-A", args[curr], 3 ) == 0 ) {
+      check_argc( args, curr, "ERROR: -A requires one argument." );
+      c_fsm.ack_delay_ms = strtol( args[curr + 1], nullptr, 0 );
+      curr += 2;
+
+    } else if ( strncmp( "-p", args[curr], 3 ) == 0 ) {
+      check_argc( args, curr, "ERROR: -p requires one argument." );
+      c_fsm.pacing = true;
+      c_fsm.pacing_rate = strtoull( args[curr + 1], nullptr, 0 ) * 1000 / 8;
+      curr += 2;
+
     } else if ( strncmp( "-d", args[curr], 3 ) == 0 ) {
       check_argc( args, curr, "ERROR: -t requires one argument." );
-      tundev = args[curr + 1];
+      c_app.tundev = args[curr + 1];
+      curr += 2;
+
+    } else if ( strncmp( "-S", args[curr], 3 ) == 0 ) {
+      check_argc( args, curr, "ERROR: -S requires one argument." );
+      c_app.stats_interval_ms = strtoull( args[curr + 1], nullptr, 0 );
+      curr += 2;
+
+    } else if ( strncmp( "-C", args[curr], 3 ) == 0 ) {
+      check_argc( args, curr, "ERROR: -C requires one argument." );
+      c_app.capture_path = args[curr + 1];
+      curr += 2;
+
+    } else if ( strncmp( "-Cs", args[curr], 4 ) == 0 ) {
+      check_argc( args, curr, "ERROR: -Cs requires one argument." );
+      c_app.capture.snap_length = strtoul( args[curr + 1], nullptr, 0 );
+      curr += 2;
+
+    } else if ( strncmp( "-Cn", args[curr], 4 ) == 0 ) {
+      check_argc( args, curr, "ERROR: -Cn requires one argument." );
+      c_app.capture.sample_every = strtoul( args[curr + 1], nullptr, 0 );
       curr += 2;
 
     } else if ( strncmp( "-Lu", args[curr], 3 ) == 0 ) {
@@ -117,6 +215,51 @@ tuple<TCPConfig, FdAdapterConfig, bool, const char*> get_config( const span<char
         = static_cast<LossRateDnT>( static_cast<float>( numeric_limits<LossRateDnT>::max() ) * lossrate );
       curr += 2;
 
+    } else if ( strncmp( "-D", args[curr], 3 ) == 0 ) {
+      check_argc( args, curr, "ERROR: -D requires one argument." );
+      c_emu.delay_ms = strtoull( args[curr + 1], nullptr, 0 );
+      curr += 2;
+
+    } else if ( strncmp( "-J", args[curr], 3 ) == 0 ) {
+      check_argc( args, curr, "ERROR: -J requires one argument." );
+      c_emu.jitter_ms = strtoull( args[curr + 1], nullptr, 0 );
+      curr += 2;
+
+    } else if ( strncmp( "-R", args[curr], 3 ) == 0 ) {
+      check_argc( args, curr, "ERROR: -R requires one argument." );
+      c_emu.rate_bytes_per_s = strtoull( args[curr + 1], nullptr, 0 ) * 1000 / 8;
+      curr += 2;
+
+    } else if ( strncmp( "-Q", args[curr], 3 ) == 0 ) {
+      check_argc( args, curr, "ERROR: -Q requires one argument." );
+      c_emu.queue_bytes = strtoull( args[curr + 1], nullptr, 0 );
+      curr += 2;
+
+    } else if ( strncmp( "-Pr", args[curr], 3 ) == 0 ) {
+      check_argc( args, curr, "ERROR: -Pr requires one argument." );
+      c_emu.reorder_probability = strtod( args[curr + 1], nullptr );
+      curr += 2;
+
+    } else if ( strncmp( "-Pd", args[curr], 3 ) == 0 ) {
+      check_argc( args, curr, "ERROR: -Pd requires one argument." );
+      c_emu.duplicate_probability = strtod( args[curr + 1], nullptr );
+      curr += 2;
+
+    } else if ( strncmp( "-Gb", args[curr], 3 ) == 0 ) {
+      check_argc( args, curr, "ERROR: -Gb requires one argument." );
+      c_emu.good_to_bad = strtod( args[curr + 1], nullptr );
+      curr += 2;
+
+    } else if ( strncmp( "-Gg", args[curr], 3 ) == 0 ) {
+      check_argc( args, curr, "ERROR: -Gg requires one argument." );
+      c_emu.bad_to_good = strtod( args[curr + 1], nullptr );
+      curr += 2;
+
+    } else if ( strncmp( "-Gl", args[curr], 3 ) == 0 ) {
+      check_argc( args, curr, "ERROR: -Gl requires one argument." );
+      c_emu.loss_bad = strtod( args[curr + 1], nullptr );
+      curr += 2;
+
     } else if ( strncmp( "-h", args[curr], 3 ) == 0 ) {
       show_usage( args[0], nullptr );
       exit( 0 );
@@ -128,19 +271,39 @@ tuple<TCPConfig, FdAdapterConfig, bool, const char*> get_config( const span<char
   }
 
   // parse positional command-line arguments
-  if ( listen ) {
-    c_filt.source = { "0", args[curr + 1] };
-    if ( c_filt.source.port() == 0 ) {
+  if ( c_app.listen ) {
+    c_filt.source = IPv4Endpoint { Address { "0", args[curr + 1] } };
+    if ( c_filt.source.port == 0 ) {
       show_usage( args[0], "ERROR: listen port cannot be zero in server mode." );
       exit( 1 );
     }
   } else {
-    c_filt.destination = { args[curr], args[curr + 1] };
-    c_filt.source = { source_address, source_port };
+    c_filt.destination = IPv4Endpoint { Address { args[curr], args[curr + 1] } };
+    c_filt.source = IPv4Endpoint { Address { source_address, source_port } };
   }
 
-  return make_tuple( c_fsm, c_filt, listen, tundev );
+  return make_tuple( c_fsm, c_filt, c_emu, c_app );
 }
+
+//! Prints a socket's statistics to stderr every `interval_ms` milliseconds, until destroyed
+template<class SocketT>
+class StatsPrinter
+{
+public:
+  StatsPrinter( const SocketT& socket, const uint64_t interval_ms )
+    : thread_( [&socket, interval_ms]( const stop_token& stop ) {
+      mutex lock;
+      condition_variable_any wakeup;
+      unique_lock guard { lock };
+      while ( not wakeup.wait_for( guard, stop, chrono::milliseconds( interval_ms ), [] { return false; } ) ) {
+        cerr << "DEBUG: minnow connection statistics:\n" << socket.stats();
+      }
+    } )
+  {}
+
+private:
+  jthread thread_;
+};
 } // namespace
 
 int main( int argc, char** argv )
@@ -151,24 +314,40 @@ int main( int argc, char** argv )
     }
 
     auto args = span( argv, argc );
+    Trace::configure_from_environment();
 
     if ( argc < 3 ) {
       show_usage( args.front(), "ERROR: required arguments are missing." );
       return EXIT_FAILURE;
     }
 
-    auto [c_fsm, c_filt, listen, tun_dev_name] = get_config( args );
-    LossyTCPOverIPv4MinnowSocket tcp_socket( LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>(
-      TCPOverIPv4OverTunFdAdapter( TunFD( tun_dev_name == nullptr ? TUN_DFLT : tun_dev_name ) ) ) );
+    auto [c_fsm, c_filt, c_emu, c_app] = get_config( args );
+    TCPOverIPv4OverTunFdAdapter tun_adapter { TunFD( c_app.tundev == nullptr ? TUN_DFLT : c_app.tundev ) };
+    if ( c_app.capture_path != nullptr ) {
+      tun_adapter.set_capture(
+        make_shared<PacketCapture>( c_app.capture_path, PacketCapture::LinkType::IPv4, c_app.capture ) );
+    }
+    EmulatedTCPOverIPv4MinnowSocket tcp_socket( EmulatedFdAdapter<LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>>(
+      LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>( std::move( tun_adapter ) ), c_emu ) );
 
-    if ( listen ) {
+    if ( c_app.listen ) {
       tcp_socket.listen_and_accept( c_fsm, c_filt );
     } else {
       tcp_socket.connect( c_fsm, c_filt );
     }
 
-    bidirectional_stream_copy( tcp_socket, tcp_socket.peer_address().to_string() );
-    tcp_socket.wait_until_closed();
+    {
+      optional<StatsPrinter<EmulatedTCPOverIPv4MinnowSocket>> printer;
+      if ( c_app.stats_interval_ms.value_or( 0 ) > 0 ) {
+        printer.emplace( tcp_socket, c_app.stats_interval_ms.value() );
+      }
+      bidirectional_stream_copy( tcp_socket, tcp_socket.peer_address().to_string() );
+      tcp_socket.wait_until_closed();
+    }
+
+    if ( c_app.stats_interval_ms.has_value() ) {
+      cerr << "DEBUG: minnow connection statistics at close:\n" << tcp_socket.stats();
+    }
   } catch ( const exception& e ) {
     cerr << "Exception: " << e.what() << endl;
     return EXIT_FAILURE;
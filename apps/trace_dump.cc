@@ -0,0 +1,81 @@
+#include "trace.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <span>
+#include <string>
+
+using namespace std;
+
+namespace {
+void show_usage( const char* argv0, const char* msg )
+{
+  cout << "Usage: " << argv0 << " [options] <dump>\n\n"
+       << "   Decodes a trace dumped by a minnow app run with MINNOW_TRACE=<dump>, printing every thread's\n"
+       << "   events in order of time (in ms since the first event shown).\n\n"
+       << "   Option                                                          Default\n"
+       << "   --                                                              --\n\n"
+
+       << "   -n <count>      Show only the last <count> events               (all)\n"
+       << "   -h              Show this message.\n\n";
+
+  if ( msg != nullptr ) {
+    cout << msg;
+  }
+  cout << endl;
+}
+} // namespace
+
+int main( int argc, char** argv )
+{
+  try {
+    if ( argc <= 0 ) {
+      abort(); // For sticklers: don't try to access argv[0] if argc <= 0.
+    }
+
+    auto args = span( argv, argc );
+    size_t last = 0;
+    const char* path = nullptr;
+    for ( size_t curr = 1; curr < args.size(); curr++ ) {
+      if ( strncmp( "-n", args[curr], 3 ) == 0 and curr + 1 < args.size() ) {
+        last = stoul( args[++curr] );
+      } else if ( strncmp( "-h", args[curr], 3 ) == 0 ) {
+        show_usage( args.front(), nullptr );
+        return EXIT_SUCCESS;
+      } else if ( path == nullptr and args[curr][0] != '-' ) {
+        path = args[curr];
+      } else {
+        show_usage( args.front(), ( "ERROR: unrecognized option " + string( args[curr] ) ).c_str() );
+        return EXIT_FAILURE;
+      }
+    }
+    if ( path == nullptr ) {
+      show_usage( args.front(), "ERROR: required arguments are missing." );
+      return EXIT_FAILURE;
+    }
+
+    const auto records = Trace::load( path );
+    const size_t first = last > 0 and last < records.size() ? records.size() - last : 0;
+    if ( first == records.size() ) {
+      cerr << path << ": no events\n";
+      return EXIT_SUCCESS;
+    }
+
+    const uint64_t start_ns = records[first].second.time_ns;
+    cout << fixed << setprecision( 3 );
+    for ( size_t i = first; i < records.size(); i++ ) {
+      const auto& [thread, record] = records[i];
+      cout << setw( 12 ) << static_cast<double>( record.time_ns - start_ns ) / 1e6 << "  [" << thread << "] "
+           << to_string( record ) << "\n";
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -1,6 +1,7 @@
 #include "socket.hh"
 
 #include "tcp_minnow_socket.hh"
+#include "trace.hh"
 
 #include <cstdlib>
 #include <iostream>
@@ -36,6 +37,7 @@ int main( int argc, char* argv[] )
     }
 
     auto args = span( argv, argc );
+    Trace::configure_from_environment();
 
     // The program takes two command-line arguments: the hostname and "path" part of the URL.
     // Print the usage message unless there are these two arguments (plus the program name
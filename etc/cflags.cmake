@@ -6,3 +6,9 @@ set(SANITIZING_FLAGS -fno-sanitize-recover=all -fsanitize=undefined -fsanitize=a
 # ask for more warnings from the compiler
 set (CMAKE_BASE_CXX_FLAGS "${CMAKE_CXX_FLAGS}")
 set (CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -Wall -Wpedantic -Wextra -Weffc++ -Werror -Wshadow -Wpointer-arith -Wcast-qual -Wformat=2 -Wno-unqualified-std-cast-call -Wno-non-virtual-dtor")
+
+# trace points (see util/trace.hh) cost one atomic load while tracing is off; turn this off to compile them out
+option (MINNOW_TRACE "Compile in the event trace points" ON)
+if (NOT MINNOW_TRACE)
+  add_compile_definitions (MINNOW_TRACE=0)
+endif ()
@@ -45,6 +45,11 @@ ttest(recv_reorder)
 ttest(recv_reorder_more)
 ttest(recv_close)
 ttest(recv_special)
+ttest(recv_delayed_ack)
+ttest(recv_piggyback_ack)
+ttest(recv_batch)
+ttest(recv_header_prediction)
+ttest(recv_window_update)
 
 ttest(send_connect)
 ttest(send_transmit)
@@ -53,8 +58,19 @@ ttest(send_window)
 ttest(send_ack)
 ttest(send_close)
 ttest(send_extra)
+ttest(send_stats)
+ttest(send_policy)
+ttest(send_rack_tlp)
+ttest(send_pacing)
+ttest(tcp_timestamps)
 
 ttest(net_interface)
+ttest(net_interface_pending)
+ttest(emulated_fd_adapter)
+ttest(loopback_adapter)
+ttest(packet_capture)
+ttest(packet_pool)
+ttest(trace)
 
 ttest(router)
 
@@ -76,6 +92,16 @@ add_custom_target (check6 COMMAND ${CMAKE_CTEST_COMMAND} --output-on-failure --s
 
 add_custom_target (speed COMMAND ${CMAKE_CTEST_COMMAND} --output-on-failure --timeout 12 -R '_speed_test')
 
+set(benchmark_baseline "${PROJECT_SOURCE_DIR}/etc/benchmark_baseline.txt")
+
+add_custom_target (check_benchmarks
+  COMMAND benchmark_speed_test -b "${benchmark_baseline}" -j "${CMAKE_BINARY_DIR}/benchmarks.json"
+  USES_TERMINAL)
+
+add_custom_target (update_benchmark_baseline
+  COMMAND benchmark_speed_test -w "${benchmark_baseline}"
+  USES_TERMINAL)
+
 set(compile_name_opt "compile with optimization")
 add_test(NAME ${compile_name_opt}
   COMMAND "${CMAKE_COMMAND}" --build "${CMAKE_BINARY_DIR}" -t speed_testing)
@@ -90,3 +116,7 @@ set_tests_properties(${compile_name_opt} PROPERTIES FIXTURES_SETUP compile_opt)
 
 stest(byte_stream_speed_test)
 stest(reassembler_speed_test)
+stest(recv_pipeline_speed_test)
+stest(send_pipeline_speed_test)
+stest(tcp_sim_speed_test)
+stest(benchmark_speed_test)
@@ -22,6 +22,7 @@ void Writer::push( string data )
   buffer_.emplace_back( move( data ) );
   pushed_ += len_to_push;
   buffered_ += len_to_push;
+  max_buffered_ = max( max_buffered_, buffered_ );
   return;
 }
 
@@ -31,6 +32,11 @@ void Writer::close()
   closed_ = true;
 }
 
+void Writer::flush()
+{
+  flushed_ = pushed_;
+}
+
 uint64_t Writer::available_capacity() const
 {
   // Your code here.
@@ -29,7 +29,9 @@ protected:
   bool closed_ {};
   std::deque<std::string> buffer_ {};
   uint64_t buffered_ {};
+  uint64_t max_buffered_ {};
   uint64_t pushed_ {};
+  uint64_t flushed_ {}; // bytes pushed when the writer last flushed
   uint64_t poped_ {};
   uint64_t prefix_poped_ {};
 };
@@ -39,6 +41,7 @@ class Writer : public ByteStream
 public:
   void push( std::string data ); // Push data to stream, but only as much as available capacity allows.
   void close();                  // Signal that the stream has reached its ending. Nothing more will be written.
+  void flush();                  // Ask for the bytes pushed so far to be sent without waiting for more.
 
   bool is_closed() const;              // Has the stream been closed?
   uint64_t available_capacity() const; // How many bytes can be pushed to the stream right now?
@@ -54,6 +57,9 @@ public:
   bool is_finished() const;        // Is the stream finished (closed and fully popped)?
   uint64_t bytes_buffered() const; // Number of bytes currently buffered (pushed and not popped)
   uint64_t bytes_popped() const;   // Total number of bytes cumulatively popped from stream
+
+  uint64_t max_bytes_buffered() const { return max_buffered_; } // High-water mark of bytes_buffered()
+  uint64_t bytes_flushed() const { return flushed_; }           // bytes_pushed() when the writer last flushed
 };
 
 /*
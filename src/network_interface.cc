@@ -1,5 +1,6 @@
+#include <array>
 #include <cstdint>
-#include <iostream>
+#include <string_view>
 
 #include "arp_message.hh"
 #include "ethernet_header.hh"
@@ -7,9 +8,21 @@
 #include "ipv4_datagram.hh"
 #include "network_interface.hh"
 #include "parser.hh"
+#include "trace.hh"
 
 using namespace std;
 
+namespace {
+uint64_t trace_ethernet( const EthernetAddress& address )
+{
+  uint64_t packed = 0;
+  for ( const uint8_t byte : address ) {
+    packed = packed << 8 | byte;
+  }
+  return packed;
+}
+} // namespace
+
 //! \param[in] ethernet_address Ethernet (what ARP calls "hardware") address of the interface
 //! \param[in] ip_address IP (what ARP calls "protocol") address of the interface
 NetworkInterface::NetworkInterface( string_view name,
@@ -21,8 +34,43 @@ NetworkInterface::NetworkInterface( string_view name,
   , ethernet_address_( ethernet_address )
   , ip_address_( ip_address )
 {
-  cerr << "DEBUG: Network interface has Ethernet address " << to_string( ethernet_address ) << " and IP address "
-       << ip_address.ip() << "\n";
+  Trace::record( TraceEvent::InterfaceCreated, ip_address.ipv4_numeric(), trace_ethernet( ethernet_address ) );
+}
+
+NetworkInterface::~NetworkInterface()
+{
+  // a moved-from interface has no budget, and nothing to return to it
+  if ( pending_budget_ ) {
+    release_pending( pending_datagrams_, pending_bytes_ );
+  }
+}
+
+NetworkInterface::CapturingPort::CapturingPort( shared_ptr<OutputPort> port, shared_ptr<PacketCapture> capture )
+  : port_( notnull( "OutputPort", move( port ) ) ), capture_( notnull( "PacketCapture", move( capture ) ) )
+{}
+
+void NetworkInterface::CapturingPort::transmit( const NetworkInterface& sender, const EthernetFrame& frame )
+{
+  array<char, EthernetHeader::LENGTH> header {};
+  ranges::copy( frame.header.dst, header.begin() );
+  ranges::copy( frame.header.src, header.begin() + frame.header.dst.size() );
+  header.at( 12 ) = static_cast<char>( frame.header.type >> 8 );
+  header.at( 13 ) = static_cast<char>( frame.header.type & 0xff );
+
+  // a frame's payload is a few buffers (e.g. an IPv4 header and its payload), so this rarely needs the vector
+  constexpr size_t max_pieces = 8;
+  if ( frame.payload.size() < max_pieces ) {
+    array<string_view, max_pieces> pieces {};
+    pieces[0] = { header.data(), header.size() };
+    ranges::copy( frame.payload, pieces.begin() + 1 );
+    capture_->capture( span { pieces.data(), frame.payload.size() + 1 } );
+  } else {
+    vector<string_view> pieces { { header.data(), header.size() } };
+    pieces.insert( pieces.end(), frame.payload.begin(), frame.payload.end() );
+    capture_->capture( pieces );
+  }
+
+  port_->transmit( sender, frame );
 }
 
 //! \param[in] dgram the IPv4 datagram to be sent
@@ -30,9 +78,15 @@ NetworkInterface::NetworkInterface( string_view name,
 //! may also be another host if directly connected to the same network as the destination) Note: the Address type
 //! can be converted to a uint32_t (raw 32-bit IP address) by using the Address::ipv4_numeric() method.
 void NetworkInterface::send_datagram( const InternetDatagram& dgram, const Address& next_hop )
+{
+  send_datagram( dgram, next_hop.ipv4_numeric() );
+}
+
+//! \param[in] dgram the IPv4 datagram to be sent
+//! \param[in] next_hop_numeric the raw 32-bit IP address of the next hop
+void NetworkInterface::send_datagram( const InternetDatagram& dgram, const IPAddrNumeric next_hop_numeric )
 {
   // Your code here.
-  IPAddrNumeric next_hop_numeric = next_hop.ipv4_numeric();
   if ( arp_cache_.contains( next_hop_numeric ) ) {
     transmit( { {
                   arp_cache_[next_hop_numeric].ethaddr,
@@ -43,10 +97,37 @@ void NetworkInterface::send_datagram( const InternetDatagram& dgram, const Addre
     return;
   }
 
-  wait_to_send_[next_hop_numeric].emplace_back( dgram );
+  auto& pending = wait_to_send_[next_hop_numeric];
+  const size_t bytes = footprint( dgram );
+
+  // a dead next hop may only hold its own share of the queue: make room by evicting its oldest datagrams, but only
+  // if the new datagram then also fits the interface-wide cap and the byte budget (else drop just the new one)
+  size_t evicted = 0;
+  size_t evicted_bytes = 0;
+  while ( evicted < pending.size() && pending.size() - evicted >= pending_limits_.max_datagrams_per_hop ) {
+    evicted_bytes += footprint( pending[evicted] );
+    evicted++;
+  }
+  if ( pending.size() - evicted >= pending_limits_.max_datagrams_per_hop
+       || pending_datagrams_ - evicted >= pending_limits_.max_datagrams
+       || pending_budget_->used_bytes - evicted_bytes + bytes > pending_budget_->max_bytes ) {
+    pending_counters_.dropped++;
+  } else {
+    pending.erase( pending.begin(), pending.begin() + static_cast<ptrdiff_t>( evicted ) );
+    release_pending( evicted, evicted_bytes );
+    pending_counters_.dropped += evicted;
+
+    pending.emplace_back( dgram );
+    pending_counters_.queued++;
+    pending_datagrams_++;
+    pending_bytes_ += bytes;
+    pending_budget_->used_bytes += bytes;
+  }
+
   if ( wait_retrans_timeout_.contains( next_hop_numeric ) )
     return;
   wait_retrans_timeout_.emplace( next_hop_numeric, Timer {} );
+  Trace::record( TraceEvent::ArpRequestSent, next_hop_numeric );
   transmit( { { ETHERNET_BROADCAST, ethernet_address_, EthernetHeader::TYPE_ARP },
               serialize( build_arp( ARPMessage::OPCODE_REQUEST, {}, next_hop_numeric ) ) } );
 }
@@ -65,15 +146,22 @@ void NetworkInterface::recv_frame( const EthernetFrame& frame )
     auto sender_ip = dgram.sender_ip_address;
     auto sender_eth = dgram.sender_ethernet_address;
     arp_cache_[sender_ip] = { sender_eth, Timer {} };
+    Trace::record( TraceEvent::ArpLearned, sender_ip, trace_ethernet( sender_eth ) );
     if ( dgram.opcode == ARPMessage::OPCODE_REQUEST && dgram.target_ip_address == ip_address_.ipv4_numeric() ) {
+      Trace::record( TraceEvent::ArpReplySent, sender_ip );
       transmit( { { sender_eth, ethernet_address_, EthernetHeader::TYPE_ARP },
                   serialize( build_arp( ARPMessage::OPCODE_REPLY, sender_eth, sender_ip ) ) } );
     }
 
     if ( wait_to_send_.contains( sender_ip ) ) {
-      for ( auto& dgram_to_send : wait_to_send_[sender_ip] ) {
+      auto& pending = wait_to_send_[sender_ip];
+      size_t bytes = 0;
+      for ( auto& dgram_to_send : pending ) {
+        bytes += footprint( dgram_to_send );
         transmit( { { sender_eth, ethernet_address_, EthernetHeader::TYPE_IPv4 }, serialize( dgram_to_send ) } );
       }
+      pending_counters_.flushed += pending.size();
+      release_pending( pending.size(), bytes );
       wait_to_send_.erase( sender_ip );
       wait_retrans_timeout_.erase( sender_ip );
     }
@@ -97,8 +185,11 @@ void NetworkInterface::tick( const size_t ms_since_last_tick )
     if ( v.tick( ms_since_last_tick ).is_expired( ARP_RETRANS_TO ) )
       tmp.push_back( k );
   }
-  for ( auto& k : tmp )
+  // resolution failed: the datagrams waiting on this next hop will never be sent
+  for ( auto& k : tmp ) {
     wait_retrans_timeout_.erase( k );
+    drop_pending( k );
+  }
 
   tmp.clear();
 
@@ -109,3 +200,43 @@ void NetworkInterface::tick( const size_t ms_since_last_tick )
   for ( auto& k : tmp )
     arp_cache_.erase( k );
 }
+
+void NetworkInterface::set_pending_budget( shared_ptr<PendingBudget> budget )
+{
+  budget = notnull( "PendingBudget", move( budget ) );
+  pending_budget_->used_bytes -= pending_bytes_;
+  budget->used_bytes += pending_bytes_;
+  pending_budget_ = move( budget );
+}
+
+size_t NetworkInterface::footprint( const InternetDatagram& dgram )
+{
+  size_t bytes = IPv4Header::LENGTH;
+  for ( const auto& buf : dgram.payload ) {
+    bytes += buf.size();
+  }
+  return bytes;
+}
+
+void NetworkInterface::release_pending( const size_t datagrams, const size_t bytes )
+{
+  pending_datagrams_ -= datagrams;
+  pending_bytes_ -= bytes;
+  pending_budget_->used_bytes -= bytes;
+}
+
+void NetworkInterface::drop_pending( const IPAddrNumeric next_hop )
+{
+  auto it = wait_to_send_.find( next_hop );
+  if ( it == wait_to_send_.end() )
+    return;
+
+  size_t bytes = 0;
+  for ( const auto& dgram : it->second ) {
+    bytes += footprint( dgram );
+  }
+  Trace::record( TraceEvent::ArpFailed, next_hop, it->second.size() );
+  pending_counters_.dropped += it->second.size();
+  release_pending( it->second.size(), bytes );
+  wait_to_send_.erase( it );
+}
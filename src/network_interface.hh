@@ -2,6 +2,8 @@
 
 #include <asm-generic/errno-base.h>
 #include <cstdint>
+#include <deque>
+#include <memory>
 #include <queue>
 
 #include <unordered_map>
@@ -11,21 +13,9 @@
 #include "ethernet_frame.hh"
 #include "ethernet_header.hh"
 #include "ipv4_datagram.hh"
+#include "packet_capture.hh"
 #include "parser.hh"
 
-struct Timer
-{
-  Timer& tick( uint64_t ms_since_last_tick )
-  {
-    time_ += ms_since_last_tick;
-    return *this;
-  }
-  bool is_expired( uint64_t TO ) { return time_ >= TO; }
-
-private:
-  uint64_t time_ {};
-};
-
 // A "network interface" that connects IP (the internet layer, or network layer)
 // with Ethernet (the network access layer, or link layer).
 
@@ -58,6 +48,19 @@ public:
     virtual ~OutputPort() = default;
   };
 
+  // An output port that records each frame in a capture (of link type PacketCapture::LinkType::Ethernet) and
+  // then passes it on to another port
+  class CapturingPort : public OutputPort
+  {
+  public:
+    CapturingPort( std::shared_ptr<OutputPort> port, std::shared_ptr<PacketCapture> capture );
+    void transmit( const NetworkInterface& sender, const EthernetFrame& frame ) override;
+
+  private:
+    std::shared_ptr<OutputPort> port_;
+    std::shared_ptr<PacketCapture> capture_;
+  };
+
   // Construct a network interface with given Ethernet (network-access-layer) and IP (internet-layer)
   // addresses
   NetworkInterface( std::string_view name,
@@ -65,11 +68,23 @@ public:
                     const EthernetAddress& ethernet_address,
                     const Address& ip_address );
 
+  // Returns the bytes of any datagrams still waiting for ARP resolution to the (possibly shared) budget
+  ~NetworkInterface();
+
+  // Not copyable, since the datagrams waiting for ARP resolution are charged to the budget once
+  NetworkInterface( const NetworkInterface& other ) = delete;
+  NetworkInterface& operator=( const NetworkInterface& other ) = delete;
+  NetworkInterface( NetworkInterface&& other ) = default;
+  NetworkInterface& operator=( NetworkInterface&& other ) = delete;
+
   // Sends an Internet datagram, encapsulated in an Ethernet frame (if it knows the Ethernet destination
   // address). Will need to use [ARP](\ref rfc::rfc826) to look up the Ethernet destination address for the next
   // hop. Sending is accomplished by calling `transmit()` (a member variable) on the frame.
   void send_datagram( const InternetDatagram& dgram, const Address& next_hop );
 
+  // Same as above, with the next hop given as a numeric IPv4 address (in host byte order)
+  void send_datagram( const InternetDatagram& dgram, uint32_t next_hop );
+
   // Receives an Ethernet frame and responds appropriately.
   // If type is IPv4, pushes the datagram to the datagrams_in queue.
   // If type is ARP request, learn a mapping from the "sender" fields, and send an ARP reply.
@@ -79,6 +94,34 @@ public:
   // Called periodically when time elapses
   void tick( size_t ms_since_last_tick );
 
+  // Caps on the datagrams held while their next hop is being resolved with ARP
+  struct PendingLimits
+  {
+    size_t max_datagrams_per_hop = 64; // per unresolved next hop (oldest is evicted first)
+    size_t max_datagrams = 1024;       // across all unresolved next hops of this interface
+  };
+
+  // A pending-bytes budget, which may be shared by several interfaces (e.g. all interfaces of a router)
+  struct PendingBudget
+  {
+    size_t max_bytes = 4UL << 20;
+    size_t used_bytes {};
+  };
+
+  // Counters of datagrams that had to wait for ARP resolution
+  struct PendingCounters
+  {
+    uint64_t queued {};  // datagrams queued for an unresolved next hop
+    uint64_t flushed {}; // queued datagrams sent once their next hop was resolved
+    uint64_t dropped {}; // datagrams discarded because a limit was reached or resolution failed
+  };
+
+  void set_pending_limits( const PendingLimits& limits ) { pending_limits_ = limits; }
+  void set_pending_budget( std::shared_ptr<PendingBudget> budget );
+  const PendingCounters& pending_counters() const { return pending_counters_; }
+  size_t pending_datagrams() const { return pending_datagrams_; }
+  size_t pending_bytes() const { return pending_bytes_; }
+
   // Accessors
   const std::string& name() const { return name_; }
   const OutputPort& output() const { return *port_; }
@@ -102,10 +145,35 @@ private:
   // Datagrams that have been received
   std::queue<InternetDatagram> datagrams_received_ {};
 
+  // Time elapsed since an ARP request was sent or a mapping was learned (nested, so it doesn't clash with
+  // the sender's retransmission timer when both are in one program)
+  struct Timer
+  {
+    Timer& tick( uint64_t ms_since_last_tick )
+    {
+      time_ += ms_since_last_tick;
+      return *this;
+    }
+    bool is_expired( uint64_t TO ) { return time_ >= TO; }
+
+  private:
+    uint64_t time_ {};
+  };
+
   using IPAddrNumeric = uint32_t;
   const uint64_t ARP_RETRANS_TO = 5000;
   std::unordered_map<IPAddrNumeric, Timer> wait_retrans_timeout_ {};
-  std::unordered_map<IPAddrNumeric, std::vector<InternetDatagram>> wait_to_send_ {};
+  std::unordered_map<IPAddrNumeric, std::deque<InternetDatagram>> wait_to_send_ {};
+
+  PendingLimits pending_limits_ {};
+  std::shared_ptr<PendingBudget> pending_budget_ { std::make_shared<PendingBudget>() };
+  PendingCounters pending_counters_ {};
+  size_t pending_datagrams_ {};
+  size_t pending_bytes_ {};
+
+  static size_t footprint( const InternetDatagram& dgram );
+  void release_pending( size_t datagrams, size_t bytes );
+  void drop_pending( IPAddrNumeric next_hop );
 
   struct ARP_Entry
   {
@@ -11,6 +11,14 @@ void Reassembler::insert( uint64_t first_index, string data, bool is_last_substr
   if ( writer().is_closed() || writer().available_capacity() == 0 )
     return;
 
+  // the next bytes in order, with nothing buffered ahead of them, go straight to the stream
+  if ( first_index == nextIndex && buffer_.empty() && !is_last_substring
+       && data.size() <= writer().available_capacity() ) {
+    output_.writer().push( std::move( data ) );
+    nextIndex = writer().bytes_pushed();
+    return;
+  }
+
   // [discard_index, ..)
   const uint64_t discard_index = nextIndex + writer().available_capacity();
   // don't forget starts from zero
@@ -1,49 +1,14 @@
 #include "router.hh"
 #include "ipv4_datagram.hh"
+#include "trace.hh"
 
 #include <cstdint>
 #include <exception>
-#include <iostream>
 #include <limits>
 #include <optional>
 
 using namespace std;
 
-void Router::TrieRouterTable::insert(RouterTableEntry entry) {
-  size_t layer = 0;
-  auto cur_node = root;
-  while (layer < 4) {
-    uint32_t mask_steps = (8*(0-layer));
-    uint8_t ip_byte = static_cast<uint8_t>((entry.route_prefix >> mask_steps) & 0b1111);
-    if (!nodes_[cur_node].edge.contains(ip_byte)) {
-      nodes_.push_back({{}, nullopt});
-      nodes_[cur_node].edge[ip_byte] = nodes_.size() - 1;
-    }
-    cur_node = nodes_[cur_node].edge[ip_byte];
-    layer++;
-  }
-  nodes_[cur_node].entry.emplace(entry);
-}
-
-std::optional<Router::RouterTableEntry> Router::TrieRouterTable::query(const InternetDatagram& dgram) {
-  size_t layer = 0;
-  auto cur_node = root;
-  std::optional<RouterTableEntry> matched{nullopt};
-
-  while (layer < 4) {
-    uint32_t mask_steps = (8*(0-layer));
-    uint8_t ip_byte = static_cast<uint8_t>((dgram.header.dst >> mask_steps) & 0b1111);
-    if (!nodes_[cur_node].edge.contains(ip_byte)) {
-      break;
-    }
-    if (nodes_[cur_node].entry.has_value()) {
-      matched.emplace(nodes_[cur_node].entry.value());
-    }
-    cur_node = nodes_[cur_node].edge[ip_byte];
-    layer++;
-  }
-  return matched;
-}
 // route_prefix: The "up-to-32-bit" IPv4 address prefix to match the datagram's destination address against
 // prefix_length: For this route to be applicable, how many high-order (most-significant) bits of
 //    the route_prefix will need to match the corresponding bits of the datagram's destination address?
@@ -55,13 +20,17 @@ void Router::add_route( const uint32_t route_prefix,
                         const optional<Address> next_hop,
                         const size_t interface_num )
 {
-  cerr << "DEBUG: adding route " << Address::from_ipv4_numeric( route_prefix ).ip() << "/"
-       << static_cast<int>( prefix_length ) << " => " << ( next_hop.has_value() ? next_hop->ip() : "(direct)" )
-       << " on interface " << interface_num << "\n";
-
   // Your code here.
-  _vector_router_table.emplace_back(  route_prefix, prefix_length, next_hop, interface_num  );
-  _trie_router_table.insert({ route_prefix, prefix_length, next_hop, interface_num }); 
+  optional<uint32_t> next_hop_numeric;
+  if ( next_hop.has_value() ) {
+    next_hop_numeric = next_hop->ipv4_numeric();
+  }
+  Trace::record( TraceEvent::RouteAdded,
+                 route_prefix,
+                 static_cast<uint64_t>( next_hop_numeric.value_or( 0 ) ) << 32 | prefix_length,
+                 interface_num,
+                 next_hop_numeric.has_value() );
+  _vector_router_table.emplace_back( route_prefix, prefix_length, next_hop_numeric, interface_num );
 }
 
 // Go through all the interfaces, and route every incoming datagram to its proper outgoing interface.
@@ -73,15 +42,21 @@ void Router::route()
     while ( !dgram_queue.empty() ) {
       auto dgram { std::move( dgram_queue.front() ) };
       dgram_queue.pop();
-      if ( dgram.header.ttl <= 1 )
+      if ( dgram.header.ttl <= 1 ) {
+        Trace::record( TraceEvent::RouteDropped, dgram.header.dst, 0, 0, TRACE_TTL_EXPIRED );
         continue;
+      }
       dgram.header.ttl--;
+      dgram.header.compute_checksum();
       auto matched { plain_match( dgram ) };
-      if ( !matched.has_value() )
+      if ( !matched.has_value() ) {
+        Trace::record( TraceEvent::RouteDropped, dgram.header.dst, 0, 0, TRACE_NO_ROUTE );
         continue;
+      }
 
-      _interfaces[matched.value().interface_idx]->send_datagram(
-        dgram, matched.value().next_hop.value_or( Address::from_ipv4_numeric( dgram.header.dst ) ) );
+      const uint32_t next_hop = matched.value().next_hop.value_or( dgram.header.dst );
+      Trace::record( TraceEvent::RouteForwarded, dgram.header.dst, next_hop, matched.value().interface_idx );
+      _interfaces[matched.value().interface_idx]->send_datagram( dgram, next_hop );
     }
   }
 }
@@ -18,9 +18,13 @@ public:
   size_t add_interface( std::shared_ptr<NetworkInterface> interface )
   {
     _interfaces.push_back( notnull( "add_interface", std::move( interface ) ) );
+    _interfaces.back()->set_pending_budget( _pending_budget );
     return _interfaces.size() - 1;
   }
 
+  // Bound the bytes of datagrams waiting for ARP resolution, summed over all of the router's interfaces
+  void set_pending_byte_budget( size_t max_bytes ) { _pending_budget->max_bytes = max_bytes; }
+
   // Access an interface by index
   std::shared_ptr<NetworkInterface> interface( const size_t N ) { return _interfaces.at( N ); }
 
@@ -37,28 +41,18 @@ private:
   // The router's collection of network interfaces
   std::vector<std::shared_ptr<NetworkInterface>> _interfaces {};
 
+  // Pending-bytes budget shared by the router's interfaces
+  std::shared_ptr<NetworkInterface::PendingBudget> _pending_budget {
+    std::make_shared<NetworkInterface::PendingBudget>() };
+
   struct RouterTableEntry
   {
     const uint32_t route_prefix;
     const uint8_t prefix_length;
-    const std::optional<Address> next_hop;
+    const std::optional<uint32_t> next_hop; // numeric, so routing a datagram never builds an Address
     const size_t interface_idx;
   };
   std::vector<RouterTableEntry> _vector_router_table {};
 
   std::optional<Router::RouterTableEntry> plain_match( const InternetDatagram& );
-
-
-  struct TrieNode {
-    std::unordered_map<uint8_t, size_t> edge;
-    std::optional<RouterTableEntry> entry;
-  };
-  struct TrieRouterTable {
-    std::vector<TrieNode> nodes_{{{},std::nullopt}};
-    size_t root{0};
-
-    void insert(RouterTableEntry);
-    std::optional<RouterTableEntry> query(const InternetDatagram&);
-  };
-  TrieRouterTable _trie_router_table{};
 };
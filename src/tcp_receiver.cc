@@ -12,9 +12,16 @@ void TCPReceiver::receive( TCPSenderMessage message )
     reader().set_error();
     return;
   }
+  if ( predicts( message ) ) {
+    receive_predicted( std::move( message ) );
+    return;
+  }
   if ( !message.SYN && !isn_.has_value() )
     return;
 
+  if ( !message.SYN && stale( message ) )
+    return;
+
   if ( message.SYN && !isn_.has_value() )
     isn_.emplace( message.seqno );
 
@@ -27,9 +34,36 @@ void TCPReceiver::receive( TCPSenderMessage message )
   else
     stream_index = abs_seqno;
 
+  // remember the timestamp to echo if the segment starts no later than the next byte expected
+  if ( message.TSval.has_value() && abs_seqno <= checkpoint )
+    ts_recent_ = message.TSval;
+
   reassembler_.insert( stream_index, std::move( message.payload ), message.FIN );
 }
 
+bool TCPReceiver::stale( const TCPSenderMessage& message ) const
+{
+  return message.TSval.has_value() && ts_recent_.has_value()
+         && static_cast<int32_t>( message.TSval.value() - ts_recent_.value() ) < 0;
+}
+
+bool TCPReceiver::predicts( const TCPSenderMessage& message ) const
+{
+  // the expected seqno is compared in wrapped form, so no unwrap is needed
+  return isn_.has_value() && !message.SYN && !message.FIN && !message.RST && !writer().has_error()
+         && !writer().is_closed() && reassembler_.bytes_pending() == 0
+         && message.payload.size() <= writer().available_capacity()
+         && message.seqno == isn_.value() + writer().bytes_pushed() + 1 && !stale( message );
+}
+
+void TCPReceiver::receive_predicted( TCPSenderMessage message )
+{
+  if ( message.TSval.has_value() )
+    ts_recent_ = message.TSval;
+  if ( !message.payload.empty() )
+    reassembler_.insert( writer().bytes_pushed(), std::move( message.payload ), false );
+}
+
 TCPReceiverMessage TCPReceiver::send() const
 {
   // Your code here.
@@ -43,5 +77,5 @@ TCPReceiverMessage TCPReceiver::send() const
   uint16_t window_size
     = static_cast<uint16_t>( min( writer().available_capacity(), static_cast<uint64_t>( UINT16_MAX ) ) );
 
-  return { ackno, window_size, writer().has_error() };
+  return { ackno, window_size, writer().has_error(), ts_recent_ };
 }
@@ -19,9 +19,19 @@ public:
    */
   void receive( TCPSenderMessage message );
 
+  /*
+   * Header prediction: is the message the next segment in order, with no flags, and does its payload fit in
+   * the window? Such a segment can be given to receive_predicted() instead, skipping the general checks.
+   */
+  bool predicts( const TCPSenderMessage& message ) const;
+  void receive_predicted( TCPSenderMessage message );
+
   // The TCPReceiver sends TCPReceiverMessages to the peer's TCPSender.
   TCPReceiverMessage send() const;
 
+  // PAWS (RFC 7323, section 5): a segment stamped earlier than the latest in-order one is an old duplicate
+  bool stale( const TCPSenderMessage& message ) const;
+
   // Access the output (only Reader is accessible non-const)
   const Reassembler& reassembler() const { return reassembler_; }
   Reader& reader() { return reassembler_.reader(); }
@@ -31,4 +41,5 @@ public:
 private:
   Reassembler reassembler_;
   std::optional<Wrap32> isn_ {};
+  std::optional<uint32_t> ts_recent_ {}; // TSval of the latest in-order segment, echoed back as TSecr
 };
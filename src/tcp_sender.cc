@@ -2,8 +2,12 @@
 #include "byte_stream.hh"
 #include "tcp_config.hh"
 #include "tcp_sender_message.hh"
+#include "trace.hh"
 #include "wrapping_integers.hh"
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
+#include <iterator>
 #include <sys/types.h>
 
 using namespace std;
@@ -21,12 +25,50 @@ uint64_t TCPSender::consecutive_retransmissions() const
 }
 
 void TCPSender::push( const TransmitFunction& transmit )
+{
+  push( transmit, false );
+}
+
+// Should a segment with `payload_size` bytes of data wait for more?
+bool TCPSender::should_hold( const uint64_t payload_size ) const
+{
+  if ( send_policy_ == TCPConfig::SendPolicy::NoDelay or payload_size == 0
+       or payload_size >= TCPConfig::MAX_PAYLOAD_SIZE ) {
+    return false;
+  }
+
+  // the application closed the stream or flushed, so no more data is coming soon
+  if ( writer().is_closed() or reader().bytes_flushed() > reader().bytes_popped() ) {
+    return false;
+  }
+
+  // the acknowledgment of what is in flight will clock out the data once more has been buffered
+  return numbers_in_flight_ > 0;
+}
+
+void TCPSender::push( const TransmitFunction& transmit, const bool cork_expired )
 {
   // Your code here.
+  bool sent = false;
+  if ( rack_tlp_ ) {
+    for ( auto& segment : outstanding_ ) {
+      if ( segment.lost ) {
+        retransmit( segment, transmit );
+        sent = true;
+      }
+    }
+  }
+
+  const auto pacing_rate = pacing_bytes_per_ms();
+  paced_ = false;
   uint64_t norm_window_size = window_size_ == 0 ? 1 : window_size_;
   while ( norm_window_size > numbers_in_flight_ ) {
     if ( state_ == AFTER_FIN )
       break;
+    if ( pacing_rate.has_value() && pace_ms_ >= static_cast<double>( now_ms_ + 1 ) ) {
+      paced_ = reader().bytes_buffered() > 0 || reader().is_finished();
+      break;
+    }
     auto msg = make_empty_message();
     if ( state_ == STATE::BEFORE_SYN ) {
       msg.SYN = true;
@@ -36,6 +78,12 @@ void TCPSender::push( const TransmitFunction& transmit )
     auto available_msg_len
       = min( TCPConfig::MAX_PAYLOAD_SIZE, norm_window_size - numbers_in_flight_ - msg.sequence_length() );
 
+    if ( not msg.SYN and not cork_expired and should_hold( min( available_msg_len, reader().bytes_buffered() ) ) ) {
+      held_since_ms_ = held_since_ms_.value_or( now_ms_ );
+      break;
+    }
+    held_since_ms_.reset();
+
     string& payload { msg.payload };
     while ( reader().bytes_buffered() > 0 && payload.size() < available_msg_len ) {
       string_view v { reader().peek() };
@@ -55,20 +103,32 @@ void TCPSender::push( const TransmitFunction& transmit )
     next_abs_seqno_ += msg.sequence_length();
     numbers_in_flight_ += msg.sequence_length();
 
+    if ( not rtt_probe_.has_value() )
+      rtt_probe_ = RTTProbe { next_abs_seqno_, now_ms_ };
+
+    if ( pacing_rate.has_value() )
+      pace_ms_ = max( pace_ms_, static_cast<double>( now_ms_ ) )
+                 + static_cast<double>( msg.sequence_length() ) / pacing_rate.value();
+
     transmit( msg );
-    outstanding_.emplace_back( std::move( msg ) );
+    outstanding_.push_back( { std::move( msg ), next_abs_seqno_, now_ms_ } );
+    sent = true;
     if ( !timer_.is_alive() )
       timer_.start();
   }
+
+  if ( sent )
+    arm_probe_timer();
 }
 
 TCPSenderMessage TCPSender::make_empty_message() const
 {
   // Your code here.
-  return TCPSenderMessage { Wrap32::wrap( next_abs_seqno_, isn_ ), false, {}, false, input_.has_error() };
+  return TCPSenderMessage {
+    Wrap32::wrap( next_abs_seqno_, isn_ ), false, {}, false, input_.has_error(), timestamp() };
 }
 
-void TCPSender::receive( const TCPReceiverMessage& msg )
+void TCPSender::receive( const TCPReceiverMessage& msg, const bool carries_data )
 {
   // Your code here.
   if ( input_.has_error() )
@@ -78,6 +138,7 @@ void TCPSender::receive( const TCPReceiverMessage& msg )
     return;
   }
 
+  const uint64_t previous_window = window_size_;
   window_size_ = msg.window_size;
   if ( !msg.ackno.has_value() )
     return;
@@ -87,35 +148,99 @@ void TCPSender::receive( const TCPReceiverMessage& msg )
   if ( peer_ackno > next_abs_seqno_ )
     return;
 
+  // an ack that neither acknowledges data nor updates the window hints that a segment went missing (RFC 5681)
+  if ( peer_ackno == acked_abs_seqno_ && !outstanding_.empty() && window_size_ == previous_window
+       && !carries_data ) {
+    duplicate_acks_++;
+    if ( rack_tlp_ ) {
+      auto delivered = find_if(
+        next( outstanding_.begin() ), outstanding_.end(), []( const Outstanding& s ) { return !s.delivered; } );
+      if ( delivered != outstanding_.end() ) {
+        delivered->delivered = true;
+        rack_deliver( *delivered );
+      }
+    }
+  }
+
+  if ( timestamps_ && msg.TSecr.has_value() ) {
+    // RFC 7323, section 4: every ack of new data gives a sample, even of a segment that was retransmitted
+    if ( peer_ackno > acked_abs_seqno_ )
+      sample_RTT( static_cast<uint32_t>( now_ms_ ) - msg.TSecr.value() );
+    rtt_probe_.reset();
+  } else if ( rtt_probe_.has_value() && peer_ackno >= rtt_probe_->end_abs_seqno ) {
+    sample_RTT( now_ms_ - rtt_probe_->sent_ms );
+    rtt_probe_.reset();
+  }
+
+  if ( undo_.has_value() )
+    detect_spurious_timeout( msg, peer_ackno );
+
+  const uint64_t previously_acked = acked_abs_seqno_;
   bool has_ack_msg = false;
   while ( !outstanding_.empty() ) {
     auto& front { outstanding_.front() };
     // this segment is not fully acked
-    if ( acked_abs_seqno_ + front.sequence_length() > peer_ackno )
+    if ( front.end_abs_seqno > peer_ackno )
       break;
 
     has_ack_msg = true;
-    acked_abs_seqno_ += front.sequence_length();
-    numbers_in_flight_ -= front.sequence_length();
+    if ( rack_tlp_ && !front.delivered )
+      rack_deliver( front );
+    acked_abs_seqno_ = front.end_abs_seqno;
+    numbers_in_flight_ -= front.msg.sequence_length();
     outstanding_.pop_front();
   }
 
   if ( has_ack_msg ) {
-    timer_.set( initial_RTO_ms_ );
+    Trace::record(
+      TraceEvent::Ack, 0, acked_abs_seqno_, window_size_ << 32 | ( acked_abs_seqno_ - previously_acked ) );
+    timer_.set( RTO_ms_ );
     consec_retransmission_ = 0;
     outstanding_.empty() ? timer_.stop() : timer_.start();
+    probe_sent_ = false;
+  }
+
+  if ( rack_tlp_ ) {
+    rack_detect_loss();
+    arm_probe_timer();
   }
 }
 
 void TCPSender::tick( uint64_t ms_since_last_tick, const TransmitFunction& transmit )
 {
   // Your code here.
+  now_ms_ += ms_since_last_tick;
+  if ( window_size_ == 0 )
+    zero_window_ms_ += ms_since_last_tick;
+
+  if ( send_policy_ == TCPConfig::SendPolicy::AutoCork and held_since_ms_.has_value()
+       and now_ms_ - held_since_ms_.value() >= cork_ms_ )
+    push( transmit, true );
+
+  if ( paced_ && pace_ms_ < static_cast<double>( now_ms_ + 1 ) )
+    push( transmit, false );
+
+  if ( rack_deadline_ms_.has_value() && now_ms_ >= rack_deadline_ms_.value() ) {
+    rack_detect_loss();
+    push( transmit, false );
+  }
+  if ( probe_deadline_ms_.has_value() && now_ms_ >= probe_deadline_ms_.value() )
+    send_probe( transmit );
+
   if ( !timer_.is_alive() )
     return;
   if ( timer_.tick( ms_since_last_tick ).is_expired() ) {
     if ( outstanding_.empty() )
       return;
-    transmit( outstanding_.front() );
+    // (a zero window makes this a probe, not a guess that the segment was lost)
+    if ( window_size_ > 0 && !undo_.has_value() )
+      undo_ = TimeoutUndo {
+        timer_.RTO(), consec_retransmission_, next_abs_seqno_, static_cast<uint32_t>( now_ms_ ), 0 };
+    retransmit( outstanding_.front(), transmit );
+    if ( undo_.has_value() )
+      undo_->retransmissions = retransmissions_;
+    timeouts_++;
+    probe_deadline_ms_.reset();
 
     if ( window_size_ > 0 ) {
       consec_retransmission_++;
@@ -125,3 +250,169 @@ void TCPSender::tick( uint64_t ms_since_last_tick, const TransmitFunction& trans
     timer_.reset();
   }
 }
+
+void TCPSender::retransmit( Outstanding& segment, const TransmitFunction& transmit )
+{
+  const uint64_t length = segment.msg.sequence_length();
+  Trace::record( TraceEvent::Retransmit, 0, segment.end_abs_seqno - length, timer_.RTO() << 32 | length );
+  segment.msg.TSval = timestamp();
+  segment.sent_ms = now_ms_;
+  segment.retransmitted = true;
+  segment.lost = false;
+  transmit( segment.msg );
+  retransmissions_++;
+  rtt_probe_.reset();
+}
+
+optional<uint64_t> TCPSender::pacing_delay_ms() const
+{
+  if ( !paced_ )
+    return {};
+  // the schedule lets the next segment go in the millisecond that it reaches
+  return static_cast<uint64_t>( max( floor( pace_ms_ ) - static_cast<double>( now_ms_ ), 0.0 ) );
+}
+
+optional<double> TCPSender::pacing_bytes_per_ms() const
+{
+  if ( !pacing_rate_.has_value() )
+    return {};
+  if ( pacing_rate_.value() > 0 )
+    return static_cast<double>( pacing_rate_.value() ) / 1000;
+
+  // a window per round trip (a little faster, so that the pacing does not hold back what the window allows)
+  if ( !srtt_ms_.has_value() || window_size_ == 0 )
+    return {};
+  return PACING_GAIN * static_cast<double>( window_size_ ) / max( srtt_ms_.value(), 1.0 );
+}
+
+optional<uint32_t> TCPSender::timestamp() const
+{
+  if ( !timestamps_ )
+    return {};
+  return static_cast<uint32_t>( now_ms_ );
+}
+
+// RFC 6298, section 2: the first sample sets SRTT and RTTVAR, later ones move them an eighth and a quarter of the
+// way, and the RTO is SRTT plus four RTTVARs. The configured initial RTO is also its floor (as RFC 6298's one
+// second is both), so that a short round trip does not make the timer fire on a delayed acknowledgment.
+void TCPSender::sample_RTT( uint64_t rtt_ms )
+{
+  const auto sample = static_cast<double>( rtt_ms );
+  if ( srtt_ms_.has_value() ) {
+    rttvar_ms_ = rttvar_ms_.value() * 3 / 4 + abs( srtt_ms_.value() - sample ) / 4;
+    srtt_ms_ = srtt_ms_.value() + ( sample - srtt_ms_.value() ) / 8;
+  } else {
+    srtt_ms_ = sample;
+    rttvar_ms_ = sample / 2;
+  }
+  if ( !adaptive_RTO_ )
+    return;
+  const auto RTO = static_cast<uint64_t>( ceil( srtt_ms_.value() + max( 4 * rttvar_ms_.value(), 1.0 ) ) );
+  RTO_ms_ = clamp( RTO, initial_RTO_ms_, max( initial_RTO_ms_, MAX_RTO_MS ) );
+}
+
+// RFC 8985, section 6.2: the delivered segment sent last gives the RTT that the segments sent before it are held to
+void TCPSender::rack_deliver( const Outstanding& segment )
+{
+  const uint64_t rtt = now_ms_ - segment.sent_ms;
+  // an ack sooner than any round trip could take was for the segment's first transmission, not this one
+  if ( segment.retransmitted && rtt < min_rtt_ms_.value_or( 0 ) )
+    return;
+  if ( !segment.retransmitted )
+    min_rtt_ms_ = min( min_rtt_ms_.value_or( rtt ), rtt );
+
+  if ( !rack_xmit_ms_.has_value() || segment.sent_ms > rack_xmit_ms_.value()
+       || ( segment.sent_ms == rack_xmit_ms_.value() && segment.end_abs_seqno > rack_end_abs_seqno_ ) ) {
+    rack_xmit_ms_ = segment.sent_ms;
+    rack_end_abs_seqno_ = segment.end_abs_seqno;
+    rack_rtt_ms_ = rtt;
+  }
+}
+
+// RFC 8985, section 6.2: a segment sent before a delivered one is lost once it has been outstanding for that
+// segment's RTT plus a reordering window; until then, the RACK timer waits for the earliest such deadline
+void TCPSender::rack_detect_loss()
+{
+  rack_deadline_ms_.reset();
+  if ( !rack_xmit_ms_.has_value() )
+    return;
+
+  const uint64_t reordering_window = min_rtt_ms_.value_or( 0 ) / 4;
+  for ( auto& segment : outstanding_ ) {
+    const bool sent_before = segment.sent_ms < rack_xmit_ms_.value()
+                             || ( segment.sent_ms == rack_xmit_ms_.value()
+                                  && segment.end_abs_seqno < rack_end_abs_seqno_ );
+    if ( segment.delivered || segment.lost || !sent_before )
+      continue;
+
+    const uint64_t deadline = segment.sent_ms + rack_rtt_ms_ + reordering_window;
+    if ( deadline <= now_ms_ )
+      segment.lost = true;
+    else
+      rack_deadline_ms_ = min( rack_deadline_ms_.value_or( deadline ), deadline );
+  }
+}
+
+// RFC 8985, section 7.2: probe about two round trips after the last transmission, unless the retransmission
+// timer (or the RACK timer) would act first
+void TCPSender::arm_probe_timer()
+{
+  probe_deadline_ms_.reset();
+  if ( !rack_tlp_ || probe_sent_ || outstanding_.empty() || window_size_ == 0 || rack_deadline_ms_.has_value()
+       || !srtt_ms_.has_value() )
+    return;
+
+  uint64_t pto = max( static_cast<uint64_t>( ceil( 2 * srtt_ms_.value() ) ), TLP_MIN_PTO_MS );
+  // a lone segment's acknowledgment may be delayed
+  if ( outstanding_.size() == 1 )
+    pto += TLP_ACK_DELAY_MS;
+  if ( pto < timer_.remaining() )
+    probe_deadline_ms_ = now_ms_ + pto;
+}
+
+// RFC 8985, section 7.3: send new data if there is any (and the window allows), or else the last segment again,
+// so that its acknowledgment (or a duplicate ack) reveals a lost tail
+void TCPSender::send_probe( const TransmitFunction& transmit )
+{
+  probe_deadline_ms_.reset();
+  if ( outstanding_.empty() )
+    return;
+
+  probe_sent_ = true;
+  loss_probes_++;
+  const uint64_t previous_next_abs_seqno = next_abs_seqno_;
+  push( transmit, true );
+  if ( next_abs_seqno_ == previous_next_abs_seqno )
+    retransmit( outstanding_.back(), transmit );
+  timer_.start();
+}
+
+// Did the ack of the segment retransmitted on a timeout show that its original transmission had arrived after all?
+void TCPSender::detect_spurious_timeout( const TCPReceiverMessage& msg, const uint64_t peer_ackno )
+{
+  const bool acks_new_data = peer_ackno > acked_abs_seqno_;
+  bool spurious = false;
+  if ( timestamps_ && msg.TSecr.has_value() ) {
+    // Eifel: the ack echoes a timestamp from before the retransmission
+    if ( !acks_new_data )
+      return;
+    spurious = static_cast<int32_t>( msg.TSecr.value() - undo_->retransmit_tsval ) < 0;
+  } else if ( retransmissions_ == undo_->retransmissions && !undo_->acked_new_data ) {
+    // F-RTO, step 2: an ack of new data that stops short of everything sent before the timeout, so that what the
+    // sender sends next can tell a lost segment (duplicate acks) from a delayed flight (more new data acked)
+    if ( acks_new_data && peer_ackno < undo_->recover_abs_seqno ) {
+      undo_->acked_new_data = true;
+      return;
+    }
+  } else if ( retransmissions_ == undo_->retransmissions ) {
+    // F-RTO, step 3: a second ack of new data
+    spurious = acks_new_data;
+  }
+
+  if ( spurious ) {
+    timer_.set( undo_->RTO_ms );
+    consec_retransmission_ = undo_->consec_retransmissions;
+    spurious_timeouts_++;
+  }
+  undo_.reset();
+}
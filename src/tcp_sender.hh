@@ -1,6 +1,7 @@
 #pragma once
 
 #include "byte_stream.hh"
+#include "tcp_config.hh"
 #include "tcp_receiver_message.hh"
 #include "tcp_sender_message.hh"
 
@@ -35,6 +36,8 @@ struct Timer
   }
   void reset() { time_ = 0; }
   void exp_backoff() { RTO_ <<= 1; }
+  uint64_t RTO() const { return RTO_; }
+  uint64_t remaining() const { return time_ >= RTO_ ? 0 : RTO_ - time_; }
   Timer& tick( uint64_t time_passed )
   {
     time_ += time_passed;
@@ -50,16 +53,28 @@ private:
 class TCPSender
 {
 public:
-  /* Construct TCP sender with given default Retransmission Timeout and possible ISN */
-  TCPSender( ByteStream&& input, Wrap32 isn, uint64_t initial_RTO_ms )
-    : input_( std::move( input ) ), isn_( isn ), initial_RTO_ms_( initial_RTO_ms ), timer_( initial_RTO_ms )
+  /* Construct TCP sender with the initial sequence number, retransmission timeout and sending options in `config`
+     (its capacities and receive-side settings are not used) */
+  TCPSender( ByteStream&& input, const TCPConfig& config )
+    : input_( std::move( input ) )
+    , isn_( config.isn )
+    , initial_RTO_ms_( config.rt_timeout )
+    , send_policy_( config.send_policy )
+    , cork_ms_( config.cork_ms )
+    , timestamps_( config.timestamps )
+    , adaptive_RTO_( config.adaptive_rto )
+    , rack_tlp_( config.rack_tlp )
+    , pacing_rate_( config.pacing ? std::optional { config.pacing_rate } : std::nullopt )
+    , timer_( config.rt_timeout )
+    , RTO_ms_( config.rt_timeout )
   {}
 
   /* Generate an empty TCPSenderMessage */
   TCPSenderMessage make_empty_message() const;
 
-  /* Receive and process a TCPReceiverMessage from the peer's receiver */
-  void receive( const TCPReceiverMessage& msg );
+  /* Receive and process a TCPReceiverMessage from the peer's receiver (`carries_data`: it came on a segment that
+     also carried data, so it is not a duplicate ack) */
+  void receive( const TCPReceiverMessage& msg, bool carries_data = false );
 
   /* Type of the `transmit` function that the push and tick methods can use to send messages */
   using TransmitFunction = std::function<void( const TCPSenderMessage& )>;
@@ -70,6 +85,9 @@ public:
   /* Time has passed by the given # of milliseconds since the last time the tick() method was called */
   void tick( uint64_t ms_since_last_tick, const TransmitFunction& transmit );
 
+  /* How long until pacing lets out a segment it is holding back (none held: nullopt) */
+  std::optional<uint64_t> pacing_delay_ms() const;
+
   // Accessors
   uint64_t sequence_numbers_in_flight() const;  // How many sequence numbers are outstanding?
   uint64_t consecutive_retransmissions() const; // How many consecutive *re*transmissions have happened?
@@ -79,17 +97,44 @@ public:
   // Access input stream reader, but const-only (can't read from outside)
   const Reader& reader() const { return input_.reader(); }
 
+  // Statistics
+  uint64_t retransmissions() const { return retransmissions_; }      // Segments sent again
+  uint64_t timeouts() const { return timeouts_; }                    // Expirations of the retransmission timer
+  uint64_t spurious_timeouts() const { return spurious_timeouts_; }  // Timeouts found to have been unnecessary
+  uint64_t duplicate_acks() const { return duplicate_acks_; }        // Acks that acknowledged nothing new
+  uint64_t loss_probes() const { return loss_probes_; }              // Tail loss probes sent
+  uint64_t current_RTO_ms() const { return timer_.RTO(); }           // Current retransmission timeout
+  std::optional<double> smoothed_RTT_ms() const { return srtt_ms_; } // Once an RTT has been sampled
+  uint64_t peer_window() const { return window_size_; }              // Latest window advertised by the peer
+  uint64_t zero_window_ms() const { return zero_window_ms_; }        // Time spent with a zero window
+
 private:
   // Variables initialized in constructor
   ByteStream input_;
   Wrap32 isn_;
   uint64_t initial_RTO_ms_;
+  TCPConfig::SendPolicy send_policy_;
+  uint64_t cork_ms_;
+  bool timestamps_;                     // stamp each segment with a TSval (RFC 7323)
+  bool adaptive_RTO_;                   // derive the RTO from SRTT and RTTVAR (else keep the initial one)
+  bool rack_tlp_;                       // detect losses by time and probe for lost tails (RFC 8985)
+  std::optional<uint64_t> pacing_rate_; // bytes per second (0: from the window and SRTT; nullopt: no pacing)
 
   Timer timer_;
   uint64_t numbers_in_flight_ {};
   uint64_t consec_retransmission_ {};
 
-  std::deque<TCPSenderMessage> outstanding_ {};
+  // A segment sent and not yet acknowledged
+  struct Outstanding
+  {
+    TCPSenderMessage msg;
+    uint64_t end_abs_seqno;
+    uint64_t sent_ms; // when it was last (re)transmitted
+    bool retransmitted {};
+    bool delivered {}; // credited with a duplicate ack (see rack_deliver)
+    bool lost {};      // marked lost by RACK, to be retransmitted by the next push
+  };
+  std::deque<Outstanding> outstanding_ {};
   uint64_t window_size_ { 1 };
   uint64_t next_abs_seqno_ {};
   uint64_t acked_abs_seqno_ {}; // syn is [0], so init with 0 is ok
@@ -101,4 +146,70 @@ private:
     AFTER_FIN,
   };
   STATE state_ { BEFORE_SYN };
+
+  // Data held back by the send policy (since when, to know when AutoCork has held it long enough)
+  std::optional<uint64_t> held_since_ms_ {};
+  bool should_hold( uint64_t payload_size ) const;
+  void push( const TransmitFunction& transmit, bool cork_expired );
+
+  // Pacing releases new segments on a schedule: each one moves the schedule on by its length at the pacing rate,
+  // and a segment may go once the schedule has fallen within the current millisecond (the clock's resolution)
+  static constexpr double PACING_GAIN = 1.25; // how much faster than a window per SRTT to pace, if derived
+  double pace_ms_ {};                         // the schedule has released segments up to this time
+  bool paced_ {};                             // a segment is being held back by the schedule
+  std::optional<double> pacing_bytes_per_ms() const;
+
+  // Statistics
+  uint64_t now_ms_ {}; // time since the sender was constructed, as told by tick()
+  uint64_t retransmissions_ {};
+  uint64_t timeouts_ {};
+  uint64_t duplicate_acks_ {};
+  uint64_t zero_window_ms_ {};
+
+  // One segment at a time is timed (and none that has been retransmitted, per Karn's algorithm)
+  struct RTTProbe
+  {
+    uint64_t end_abs_seqno; // acknowledging this completes the sample
+    uint64_t sent_ms;
+  };
+  std::optional<RTTProbe> rtt_probe_ {};
+  std::optional<double> srtt_ms_ {};
+  std::optional<double> rttvar_ms_ {};
+  uint64_t RTO_ms_;                             // from SRTT and RTTVAR, before any backoff (RFC 6298)
+  static constexpr uint64_t MAX_RTO_MS = 60000; // RFC 6298, section 2.5
+  void sample_RTT( uint64_t rtt_ms );
+  std::optional<uint32_t> timestamp() const; // the TSval for a segment sent now
+  void retransmit( Outstanding& segment, const TransmitFunction& transmit );
+
+  // RACK-TLP (RFC 8985). Without SACK, each duplicate ack is credited to the first outstanding segment after the
+  // one it is waiting for, as if that segment had been selectively acknowledged (as Linux does for Reno).
+  static constexpr uint64_t TLP_ACK_DELAY_MS = 200; // how long a lone segment's acknowledgment may be delayed
+  static constexpr uint64_t TLP_MIN_PTO_MS = 10;    // time is told in whole ms, so a shorter PTO can fire at once
+  std::optional<uint64_t> rack_xmit_ms_ {};         // when the last-sent of the delivered segments was sent
+  uint64_t rack_end_abs_seqno_ {};                  // and where it ended, to order segments sent in the same ms
+  uint64_t rack_rtt_ms_ {};                         // and its round-trip time
+  std::optional<uint64_t> min_rtt_ms_ {};
+  std::optional<uint64_t> rack_deadline_ms_ {};  // when a suspect segment's reordering window runs out
+  std::optional<uint64_t> probe_deadline_ms_ {}; // when to send a tail loss probe
+  bool probe_sent_ {};                           // one probe per tail, until new data is acknowledged
+  uint64_t loss_probes_ {};
+  void rack_deliver( const Outstanding& segment );
+  void rack_detect_loss();
+  void arm_probe_timer();
+  void send_probe( const TransmitFunction& transmit );
+
+  // Spurious timeout detection: Eifel (RFC 3522) when acks echo timestamps, F-RTO (RFC 5682) when they do not.
+  // What the first timeout of an episode changed, to be put back if the segment it retransmitted was not lost.
+  struct TimeoutUndo
+  {
+    uint64_t RTO_ms;                 // before the backoff
+    uint64_t consec_retransmissions; // before the timeout
+    uint64_t recover_abs_seqno;      // everything sent before the timeout
+    uint32_t retransmit_tsval;       // stamped on the retransmission (Eifel)
+    uint64_t retransmissions;        // retransmissions_ just after the latest timeout (F-RTO)
+    bool acked_new_data {};          // the first ack since acknowledged new data (F-RTO, step 2)
+  };
+  std::optional<TimeoutUndo> undo_ {};
+  uint64_t spurious_timeouts_ {};
+  void detect_spurious_timeout( const TCPReceiverMessage& msg, uint64_t peer_ackno );
 };
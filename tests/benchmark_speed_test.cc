@@ -0,0 +1,608 @@
+#include "arp_message.hh"
+#include "checksum.hh"
+#include "eventloop.hh"
+#include "exception.hh"
+#include "network_interface.hh"
+#include "reassembler.hh"
+#include "router.hh"
+#include "tcp_over_ip.hh"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <optional>
+#include <queue>
+#include <random>
+#include <span>
+#include <sstream>
+#include <sys/socket.h>
+#include <tuple>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+// Runs every microbenchmark several times, reports the median and spread of each, and compares the medians with
+// a stored baseline. Every benchmark reports a rate (higher is better), so a regression is a median that falls
+// more than the tolerance below the baseline's.
+//
+// The baseline is a text file with one benchmark per line: its name, its median, and optionally a tolerance in
+// percent (overriding -t). Lines beginning with '#' are comments. -w writes one from the current results.
+
+namespace {
+
+struct Benchmark
+{
+  string name;
+  string unit;
+  function<function<double()>()> prepare; // builds the inputs, then returns one timed trial
+};
+
+struct Summary
+{
+  string name;
+  string unit;
+  vector<double> samples;
+  double median, min, max;
+  double spread_percent; // interquartile range, relative to the median
+
+  optional<double> baseline {};
+  double tolerance_percent {};
+  string status { "new" }; // "ok", "regression", "improvement", or "new" (not in the baseline)
+};
+
+struct Options
+{
+  size_t runs = 9;
+  double tolerance_percent = 10;
+  string filter {};
+  string baseline_path {};
+  string json_path {};
+  string write_baseline_path {};
+};
+
+string random_data( const size_t len, const size_t seed )
+{
+  default_random_engine rd { seed };
+  uniform_int_distribution<char> ud;
+  string ret;
+  ret.reserve( len );
+  for ( size_t i = 0; i < len; ++i ) {
+    ret += ud( rd );
+  }
+  return ret;
+}
+
+double gigabits_per_second( const size_t bytes, const steady_clock::duration elapsed )
+{
+  return 8 * static_cast<double>( bytes ) / duration_cast<duration<double>>( elapsed ).count() / 1e9;
+}
+
+double millions_per_second( const size_t count, const steady_clock::duration elapsed )
+{
+  return static_cast<double>( count ) / duration_cast<duration<double>>( elapsed ).count() / 1e6;
+}
+
+// Keep the optimizer from discarding a computation whose result is otherwise unused
+template<class T>
+void keep( const T& value )
+{
+  asm volatile( "" : : "g"( &value ) : "memory" );
+}
+
+// The workload of byte_stream_speed_test
+Benchmark byte_stream()
+{
+  return { "byte_stream", "Gbit/s", [] {
+            constexpr size_t write_size = 1500, read_size = 128, capacity = 32768;
+            auto data = make_shared<const string>( random_data( 1e7, 789 ) );
+            return [data] {
+              queue<string> split_data;
+              for ( size_t i = 0; i < data->size(); i += write_size ) {
+                split_data.emplace( data->substr( i, write_size ) );
+              }
+              ByteStream bs { capacity };
+              string output_data;
+              output_data.reserve( data->size() );
+
+              const auto start_time = steady_clock::now();
+              while ( not bs.reader().is_finished() ) {
+                if ( split_data.empty() ) {
+                  if ( not bs.writer().is_closed() ) {
+                    bs.writer().close();
+                  }
+                } else if ( split_data.front().size() <= bs.writer().available_capacity() ) {
+                  bs.writer().push( std::move( split_data.front() ) );
+                  split_data.pop();
+                }
+                if ( bs.reader().bytes_buffered() ) {
+                  const auto peeked = bs.reader().peek().substr( 0, read_size );
+                  output_data += peeked;
+                  bs.reader().pop( peeked.size() );
+                }
+              }
+              const auto elapsed = steady_clock::now() - start_time;
+
+              if ( output_data != *data ) {
+                throw runtime_error( "byte_stream: mismatch between data written and read" );
+              }
+              return gigabits_per_second( data->size(), elapsed );
+            };
+          } };
+}
+
+// The workload of reassembler_speed_test: overlapping substrings, arriving out of order
+Benchmark reassembler()
+{
+  return { "reassembler", "Gbit/s", [] {
+            constexpr size_t capacity = 1500;
+            auto data = make_shared<const string>( random_data( 10000 * capacity, 1370 ) );
+            return [data] {
+              queue<tuple<uint64_t, string, bool>> split_data;
+              for ( size_t i = 0; i < data->size(); i += capacity ) {
+                for ( const size_t offset : { 2, 0, 1 } ) {
+                  const size_t first = i + offset;
+                  split_data.emplace(
+                    first, data->substr( first, capacity * 2 ), first + capacity * 2 >= data->size() );
+                }
+              }
+              Reassembler reassembler { ByteStream { capacity } };
+              string output_data;
+              output_data.reserve( data->size() );
+
+              const auto start_time = steady_clock::now();
+              while ( not split_data.empty() ) {
+                auto& next = split_data.front();
+                reassembler.insert( get<uint64_t>( next ), std::move( get<string>( next ) ), get<bool>( next ) );
+                split_data.pop();
+                while ( reassembler.reader().bytes_buffered() ) {
+                  output_data += reassembler.reader().peek();
+                  reassembler.reader().pop( output_data.size() - reassembler.reader().bytes_popped() );
+                }
+              }
+              const auto elapsed = steady_clock::now() - start_time;
+
+              if ( not reassembler.reader().is_finished() or output_data != *data ) {
+                throw runtime_error( "reassembler: mismatch between data written and read" );
+              }
+              return gigabits_per_second( data->size(), elapsed );
+            };
+          } };
+}
+
+// The Internet checksum over MTU-sized buffers, optionally copying them at the same time
+Benchmark checksum( const bool copy )
+{
+  return { copy ? "checksum_copy" : "checksum", "Gbit/s", [copy] {
+            constexpr size_t buffer_size = 1500, repetitions = 200000;
+            auto data = make_shared<const string>( random_data( buffer_size, 2468 ) );
+            return [data, copy] {
+              string destination( data->size(), 0 );
+              uint64_t total = 0;
+
+              const auto start_time = steady_clock::now();
+              for ( size_t i = 0; i < repetitions; i++ ) {
+                InternetChecksum sum;
+                if ( copy ) {
+                  sum.add_and_copy( *data, destination.data() );
+                  keep( destination );
+                } else {
+                  sum.add( *data );
+                }
+                total += sum.value();
+              }
+              const auto elapsed = steady_clock::now() - start_time;
+
+              InternetChecksum expected;
+              expected.add( *data );
+              if ( total != repetitions * expected.value() ) {
+                throw runtime_error( "checksum: inconsistent results" );
+              }
+              return gigabits_per_second( repetitions * data->size(), elapsed );
+            };
+          } };
+}
+
+vector<TCPMessage> segments( const string& data )
+{
+  vector<TCPMessage> messages;
+  for ( size_t i = 0; i < data.size(); i += TCPConfig::MAX_PAYLOAD_SIZE ) {
+    TCPMessage& msg = messages.emplace_back();
+    msg.sender.seqno = Wrap32 { 13579 } + i;
+    msg.sender.payload = data.substr( i, TCPConfig::MAX_PAYLOAD_SIZE );
+    msg.receiver.ackno = Wrap32 { 24680 };
+    msg.receiver.window_size = 65000;
+  }
+  return messages;
+}
+
+TCPOverIPv4Adapter adapter()
+{
+  TCPOverIPv4Adapter ret;
+  ret.config_mut().source = IPv4Endpoint { Address { "10.0.0.1", 1234 } };
+  ret.config_mut().destination = IPv4Endpoint { Address { "10.0.0.2", 80 } };
+  return ret;
+}
+
+// Parsing TCP-in-IPv4 datagrams (as read from the tun device) into TCPMessages
+Benchmark tcp_parse()
+{
+  return { "tcp_parse", "Gbit/s", [] {
+            auto datagrams = make_shared<vector<string>>();
+            TCPOverIPv4Adapter sender = adapter();
+            for ( const auto& msg : segments( random_data( 1e7, 1357 ) ) ) {
+              const auto buffers = serialize( sender.wrap_tcp_in_ip( msg ) );
+              datagrams->push_back( accumulate( buffers.begin(), buffers.end(), string {} ) );
+            }
+            return [datagrams] {
+              TCPOverIPv4Adapter receiver = adapter();
+              swap( receiver.config_mut().source, receiver.config_mut().destination );
+              size_t bytes = 0;
+              size_t payload_bytes = 0;
+
+              const auto start_time = steady_clock::now();
+              for ( const auto& datagram : *datagrams ) {
+                const auto msg = receiver.unwrap_tcp_in_ip( string_view { datagram } );
+                payload_bytes += msg ? msg->sender.payload.size() : 0;
+                bytes += datagram.size();
+              }
+              const auto elapsed = steady_clock::now() - start_time;
+
+              if ( payload_bytes != 1e7 ) {
+                throw runtime_error( "tcp_parse: datagrams failed to parse" );
+              }
+              return gigabits_per_second( bytes, elapsed );
+            };
+          } };
+}
+
+// Building TCP-in-IPv4 datagrams in one buffer, checksumming the payload as it is copied
+Benchmark tcp_serialize()
+{
+  return { "tcp_serialize", "Gbit/s", [] {
+            auto messages = make_shared<const vector<TCPMessage>>( segments( random_data( 1e7, 4321 ) ) );
+            return [messages] {
+              TCPOverIPv4Adapter sender = adapter();
+              string storage( TCPOverIPv4Adapter::HEADROOM + TCPConfig::MAX_PAYLOAD_SIZE, 0 );
+              size_t bytes = 0;
+
+              const auto start_time = steady_clock::now();
+              for ( const auto& msg : *messages ) {
+                PacketBuffer packet { storage, TCPOverIPv4Adapter::HEADROOM };
+                sender.wrap_tcp_in_ip( msg, packet );
+                bytes += packet.size();
+                keep( storage );
+              }
+              const auto elapsed = steady_clock::now() - start_time;
+
+              return gigabits_per_second( bytes, elapsed );
+            };
+          } };
+}
+
+// An output port that discards every frame
+class DiscardPort : public NetworkInterface::OutputPort
+{
+public:
+  void transmit( const NetworkInterface& sender [[maybe_unused]], const EthernetFrame& frame ) override
+  {
+    keep( frame );
+  }
+};
+
+// Forwarding small datagrams to random destinations through a router with a few hundred routes
+Benchmark router_forward()
+{
+  return { "router_forward", "Mdgram/s", [] {
+            constexpr size_t route_count = 256, datagram_count = 100000;
+            auto router = make_shared<Router>();
+            auto port = make_shared<DiscardPort>();
+            const EthernetAddress gateway_ethernet { 0x02, 0, 0, 0, 0, 1 };
+            const uint32_t gateway = Address { "10.255.0.1" }.ipv4_numeric();
+
+            router->add_interface( make_shared<NetworkInterface>(
+              "in", port, EthernetAddress { 0x02, 0, 0, 0, 1, 0 }, Address { "10.0.0.1" } ) );
+            const size_t out = router->add_interface( make_shared<NetworkInterface>(
+              "out", port, EthernetAddress { 0x02, 0, 0, 0, 2, 0 }, Address { "10.255.0.2" } ) );
+
+            // learn the gateway's Ethernet address from its ARP request
+            ARPMessage arp;
+            arp.opcode = ARPMessage::OPCODE_REQUEST;
+            arp.sender_ethernet_address = gateway_ethernet;
+            arp.sender_ip_address = gateway;
+            arp.target_ip_address = Address { "10.255.0.2" }.ipv4_numeric();
+            router->interface( out )->recv_frame(
+              { { ETHERNET_BROADCAST, gateway_ethernet, EthernetHeader::TYPE_ARP }, serialize( arp ) } );
+
+            default_random_engine rd { 9753 };
+            for ( size_t i = 0; i < route_count; i++ ) {
+              const auto prefix_length = static_cast<uint8_t>( uniform_int_distribution { 8, 24 }( rd ) );
+              const uint32_t prefix = static_cast<uint32_t>( rd() ) & ~( UINT32_MAX >> prefix_length );
+              router->add_route( prefix, prefix_length, Address::from_ipv4_numeric( gateway ), out );
+            }
+
+            auto datagrams = make_shared<vector<InternetDatagram>>();
+            for ( size_t i = 0; i < datagram_count; i++ ) {
+              InternetDatagram& dgram = datagrams->emplace_back();
+              dgram.header.src = Address { "10.0.0.2" }.ipv4_numeric();
+              dgram.header.dst = static_cast<uint32_t>( rd() );
+              dgram.payload.emplace_back( 64, 'x' );
+              dgram.header.len = dgram.header.hlen * 4 + dgram.payload.front().size();
+              dgram.header.compute_checksum();
+            }
+
+            return [router, datagrams] {
+              auto& inbound = router->interface( 0 )->datagrams_received();
+              for ( const auto& dgram : *datagrams ) {
+                inbound.push( dgram );
+              }
+
+              const auto start_time = steady_clock::now();
+              router->route();
+              const auto elapsed = steady_clock::now() - start_time;
+
+              return millions_per_second( datagrams->size(), elapsed );
+            };
+          } };
+}
+
+// Events dispatched by the EventLoop: two rules bounce one byte back and forth over a socket pair
+Benchmark eventloop()
+{
+  return { "eventloop", "Mevent/s", [] {
+            return [] {
+              constexpr size_t event_count = 50000;
+              array<int, 2> fds {};
+              CheckSystemCall( "socketpair", socketpair( AF_UNIX, SOCK_STREAM, 0, fds.data() ) );
+              FileDescriptor a { fds[0] };
+              FileDescriptor b { fds[1] };
+
+              EventLoop loop;
+              size_t events = 0;
+              array<char, 1> byte { 'x' };
+              for ( auto* fd : { &a, &b } ) {
+                loop.add_rule(
+                  "bounce",
+                  *fd,
+                  Direction::In,
+                  [&, fd] {
+                    fd->read( byte );
+                    fd->write( { byte.data(), byte.size() } );
+                    events++;
+                  },
+                  [&] { return events < event_count; } );
+              }
+              b.write( { byte.data(), byte.size() } );
+
+              const auto start_time = steady_clock::now();
+              while ( loop.wait_next_event( -1 ) != EventLoop::Result::Exit ) {}
+              const auto elapsed = steady_clock::now() - start_time;
+
+              return millions_per_second( events, elapsed );
+            };
+          } };
+}
+
+Summary summarize( const string& name, const string& unit, vector<double> samples )
+{
+  Summary ret { name, unit, samples, 0, 0, 0, 0 };
+  sort( samples.begin(), samples.end() );
+  const size_t n = samples.size();
+  ret.median = n % 2 ? samples[n / 2] : ( samples[n / 2 - 1] + samples[n / 2] ) / 2;
+  ret.min = samples.front();
+  ret.max = samples.back();
+  const double iqr = samples[n * 3 / 4] - samples[n / 4];
+  ret.spread_percent = ret.median > 0 ? 100 * iqr / ret.median : 0;
+  return ret;
+}
+
+// Reads a baseline: benchmark name => (median, tolerance in percent)
+map<string, pair<double, double>> read_baseline( const string& path, const double default_tolerance )
+{
+  ifstream file { path };
+  if ( not file ) {
+    throw runtime_error( "could not open baseline " + path );
+  }
+  map<string, pair<double, double>> ret;
+  string line;
+  while ( getline( file, line ) ) {
+    if ( line.empty() or line.front() == '#' ) {
+      continue;
+    }
+    istringstream fields { line };
+    string name;
+    double median {};
+    double tolerance = default_tolerance;
+    if ( not( fields >> name >> median ) ) {
+      throw runtime_error( "malformed baseline line: " + line );
+    }
+    fields >> tolerance;
+    ret[name] = { median, tolerance };
+  }
+  return ret;
+}
+
+void compare( Summary& summary, const map<string, pair<double, double>>& baseline )
+{
+  const auto it = baseline.find( summary.name );
+  if ( it == baseline.end() ) {
+    return;
+  }
+  const auto [median, tolerance] = it->second;
+  summary.baseline = median;
+  summary.tolerance_percent = tolerance;
+  if ( summary.median < median * ( 1 - tolerance / 100 ) ) {
+    summary.status = "regression";
+  } else if ( summary.median > median * ( 1 + tolerance / 100 ) ) {
+    summary.status = "improvement";
+  } else {
+    summary.status = "ok";
+  }
+}
+
+void write_json( ostream& out, const vector<Summary>& summaries, const Options& options )
+{
+  out << fixed << setprecision( 4 ) << "{\n  \"runs\": " << options.runs << ",\n  \"benchmarks\": [";
+  for ( size_t i = 0; i < summaries.size(); i++ ) {
+    const Summary& s = summaries[i];
+    out << ( i ? "," : "" ) << "\n    {\"name\": \"" << s.name << "\", \"unit\": \"" << s.unit
+        << "\", \"median\": " << s.median << ", \"min\": " << s.min << ", \"max\": " << s.max
+        << ", \"spread_percent\": " << s.spread_percent << ", \"samples\": [";
+    for ( size_t j = 0; j < s.samples.size(); j++ ) {
+      out << ( j ? ", " : "" ) << s.samples[j];
+    }
+    out << "]";
+    if ( s.baseline ) {
+      out << ", \"baseline\": " << *s.baseline << ", \"tolerance_percent\": " << s.tolerance_percent;
+    }
+    out << ", \"status\": \"" << s.status << "\"}";
+  }
+  out << "\n  ]\n}\n";
+}
+
+void write_baseline( const string& path, const vector<Summary>& summaries )
+{
+  ofstream file { path };
+  if ( not file ) {
+    throw runtime_error( "could not write baseline " + path );
+  }
+  file << "# benchmark_speed_test baseline: name, median, and (optionally) tolerance in percent\n";
+  file << "# The medians are specific to the machine that produced them; regenerate with -w\n"
+       << "# (or the update_benchmark_baseline target).\n";
+  for ( const auto& s : summaries ) {
+    file << s.name << " " << fixed << setprecision( 4 ) << s.median << "\n";
+  }
+}
+
+void usage( const char* argv0 )
+{
+  cerr << "Usage: " << argv0 << " [options]\n\n"
+       << "   -n RUNS              Run each benchmark RUNS times (default 9)\n"
+       << "   -f SUBSTRING         Only run benchmarks whose names contain SUBSTRING\n"
+       << "   -b BASELINE          Compare the medians against BASELINE, failing on a regression\n"
+       << "   -t PERCENT           Tolerance for benchmarks whose baseline gives none (default 10)\n"
+       << "   -j FILE              Write the results as JSON to FILE (\"-\" for standard output)\n"
+       << "   -w FILE              Write the medians to FILE as a new baseline\n\n"
+       << "   -h                   Show this usage message\n";
+}
+
+Options parse_options( const int argc, char* argv[] )
+{
+  Options options;
+  const auto args = span( argv, argc ).subspan( 1 );
+  for ( size_t i = 0; i < args.size(); i++ ) {
+    const string_view flag { args[i] };
+    if ( flag == "-h" ) {
+      usage( argv[0] );
+      exit( EXIT_SUCCESS );
+    }
+    if ( i + 1 >= args.size() ) {
+      usage( argv[0] );
+      throw runtime_error( "missing argument for " + string( flag ) );
+    }
+    const string value { args[++i] };
+    if ( flag == "-n" ) {
+      options.runs = stoul( value );
+    } else if ( flag == "-f" ) {
+      options.filter = value;
+    } else if ( flag == "-b" ) {
+      options.baseline_path = value;
+    } else if ( flag == "-t" ) {
+      options.tolerance_percent = stod( value );
+    } else if ( flag == "-j" ) {
+      options.json_path = value;
+    } else if ( flag == "-w" ) {
+      options.write_baseline_path = value;
+    } else {
+      usage( argv[0] );
+      throw runtime_error( "unknown option " + string( flag ) );
+    }
+  }
+  if ( options.runs == 0 ) {
+    throw runtime_error( "need at least one run" );
+  }
+  return options;
+}
+
+int program_body( const Options& options )
+{
+  const vector<Benchmark> benchmarks { byte_stream(),   reassembler(),    checksum( false ), checksum( true ),
+                                       tcp_parse(),     tcp_serialize(), router_forward(),   eventloop() };
+
+  const auto baseline = options.baseline_path.empty()
+                          ? map<string, pair<double, double>> {}
+                          : read_baseline( options.baseline_path, options.tolerance_percent );
+
+  vector<Summary> summaries;
+  for ( const auto& benchmark : benchmarks ) {
+    if ( benchmark.name.find( options.filter ) == string::npos ) {
+      continue;
+    }
+    const auto trial = benchmark.prepare();
+    trial(); // warm up caches and allocators
+    vector<double> samples;
+    for ( size_t i = 0; i < options.runs; i++ ) {
+      samples.push_back( trial() );
+    }
+
+    Summary& s = summaries.emplace_back( summarize( benchmark.name, benchmark.unit, samples ) );
+    compare( s, baseline );
+
+    cout << left << setw( 16 ) << s.name << right << fixed << setprecision( 2 ) << setw( 9 ) << s.median << " "
+         << left << setw( 9 ) << s.unit << right << "(min " << s.min << ", max " << s.max << ", spread "
+         << setprecision( 1 ) << s.spread_percent << "%)";
+    if ( s.baseline ) {
+      cout << " baseline " << setprecision( 2 ) << *s.baseline << ": " << s.status;
+      if ( s.spread_percent > s.tolerance_percent ) {
+        cout << " (spread exceeds the " << setprecision( 0 ) << s.tolerance_percent << "% tolerance)";
+      }
+    }
+    cout << endl;
+  }
+
+  if ( not options.json_path.empty() ) {
+    if ( options.json_path == "-" ) {
+      write_json( cout, summaries, options );
+    } else {
+      ofstream json { options.json_path };
+      write_json( json, summaries, options );
+    }
+  }
+  if ( not options.write_baseline_path.empty() ) {
+    write_baseline( options.write_baseline_path, summaries );
+  }
+
+  const auto regressions = count_if(
+    summaries.begin(), summaries.end(), []( const Summary& s ) { return s.status == "regression"; } );
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+  debug_output << "          Benchmarks: " << summaries.size() << " run, " << regressions << " regressed\n";
+
+  if ( regressions > 0 ) {
+    cerr << regressions << " benchmark(s) regressed from the baseline.\n";
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+} // namespace
+
+int main( int argc, char* argv[] )
+{
+  try {
+    return program_body( parse_options( argc, argv ) );
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+}
@@ -0,0 +1,267 @@
+#include "common.hh"
+#include "emulated_fd_adapter.hh"
+#include "fd_adapter.hh"
+
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+// An adapter that records what is written to it
+class RecordingAdapter : public FdAdapterBase
+{
+  shared_ptr<vector<TCPMessage>> written_ { make_shared<vector<TCPMessage>>() };
+
+public:
+  void write( const TCPMessage& seg ) { written_->push_back( seg ); }
+  optional<TCPMessage> read() { return {}; }
+  const vector<TCPMessage>& written() const { return *written_; }
+};
+
+using EmulatedLink = EmulatedFdAdapter<RecordingAdapter>;
+
+class EmulatedLinkTestHarness : public TestHarness<EmulatedLink>
+{
+public:
+  EmulatedLinkTestHarness( std::string test_name, const EmulationConfig& config )
+    : TestHarness( std::move( test_name ), "emulated link", EmulatedLink { RecordingAdapter {}, config } )
+  {}
+};
+
+uint32_t seqno_of( const TCPMessage& msg )
+{
+  return msg.sender.seqno.unwrap( Wrap32 { 0 }, 0 );
+}
+
+// A datagram identified by its sequence number, with `payload_size` bytes of payload
+TCPMessage datagram( const uint32_t seqno, const size_t payload_size = 0 )
+{
+  TCPMessage msg;
+  msg.sender.seqno = Wrap32 { seqno };
+  msg.sender.payload = string( payload_size, 'x' );
+  return msg;
+}
+
+struct Write : public Action<EmulatedLink>
+{
+  TCPMessage msg_;
+  explicit Write( TCPMessage msg ) : msg_( std::move( msg ) ) {}
+  std::string description() const override
+  {
+    return "write datagram #" + to_string( seqno_of( msg_ ) ) + " (" + to_string( msg_.sender.payload.size() )
+           + " payload bytes)";
+  }
+  void execute( EmulatedLink& link ) const override { link.write( msg_ ); }
+};
+
+struct Tick : public Action<EmulatedLink>
+{
+  size_t ms_;
+  explicit Tick( const size_t ms ) : ms_( ms ) {}
+  std::string description() const override { return to_string( ms_ ) + " ms pass"; }
+  void execute( EmulatedLink& link ) const override { link.tick( ms_ ); }
+};
+
+// The sequence numbers of the datagrams written to the underlying adapter so far, in order
+struct ExpectDelivered : public Expectation<EmulatedLink>
+{
+  vector<uint32_t> seqnos_;
+  explicit ExpectDelivered( vector<uint32_t> seqnos ) : seqnos_( std::move( seqnos ) ) {}
+  static string to_str( const vector<uint32_t>& seqnos )
+  {
+    string ret = "[";
+    for ( const auto s : seqnos ) {
+      ret += " " + to_string( s );
+    }
+    return ret + " ]";
+  }
+  std::string description() const override { return "datagrams delivered: " + to_str( seqnos_ ); }
+  void execute( EmulatedLink& link ) const override
+  {
+    vector<uint32_t> actual;
+    for ( const auto& msg : link.adapter().written() ) {
+      actual.push_back( seqno_of( msg ) );
+    }
+    if ( actual != seqnos_ ) {
+      throw ExpectationViolation { "The datagrams delivered should have been " + to_str( seqnos_ )
+                                   + ", but instead they were " + to_str( actual ) + "." };
+    }
+  }
+};
+
+struct ExpectBytesInFlight : public ExpectNumber<EmulatedLink, size_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "bytes_in_flight"; }
+  size_t value( EmulatedLink& link ) const override { return link.bytes_in_flight(); }
+};
+
+struct ExpectStats : public Expectation<EmulatedLink>
+{
+  EmulatedLink::Stats stats_;
+  explicit ExpectStats( const EmulatedLink::Stats& stats ) : stats_( stats ) {}
+  static string to_str( const EmulatedLink::Stats& s )
+  {
+    return "sent=" + to_string( s.sent ) + " lost=" + to_string( s.lost ) + " queue_drops="
+           + to_string( s.queue_drops ) + " reordered=" + to_string( s.reordered )
+           + " duplicated=" + to_string( s.duplicated );
+  }
+  std::string description() const override { return "emulation stats: " + to_str( stats_ ); }
+  void execute( EmulatedLink& link ) const override
+  {
+    const auto& s = link.emulation_stats();
+    if ( s.sent != stats_.sent or s.lost != stats_.lost or s.queue_drops != stats_.queue_drops
+         or s.reordered != stats_.reordered or s.duplicated != stats_.duplicated ) {
+      throw ExpectationViolation { "The emulation stats should have been " + to_str( stats_ )
+                                   + ", but instead they were " + to_str( s ) + "." };
+    }
+  }
+};
+
+// The share of datagrams lost lies in [low, high]
+struct ExpectLossRate : public Expectation<EmulatedLink>
+{
+  double low_, high_;
+  ExpectLossRate( const double low, const double high ) : low_( low ), high_( high ) {}
+  std::string description() const override
+  {
+    return "loss rate between " + to_string( low_ ) + " and " + to_string( high_ );
+  }
+  void execute( EmulatedLink& link ) const override
+  {
+    const auto& s = link.emulation_stats();
+    const double rate = static_cast<double>( s.lost ) / static_cast<double>( s.lost + s.sent );
+    if ( rate < low_ or rate > high_ ) {
+      throw ExpectationViolation { "The loss rate should have been between " + to_string( low_ ) + " and "
+                                   + to_string( high_ ) + ", but instead it was " + to_string( rate ) + "." };
+    }
+  }
+};
+
+int main()
+{
+  try {
+    // Each datagram below with a payload carries 60 bytes of it, for 100 bytes on the wire.
+    constexpr size_t payload = 60;
+
+    {
+      EmulatedLinkTestHarness test { "no emulation passes datagrams straight through", EmulationConfig {} };
+      test.execute( Write { datagram( 1 ) } );
+      test.execute( Write { datagram( 2 ) } );
+      test.execute( ExpectDelivered { { 1, 2 } } );
+      test.execute( ExpectBytesInFlight { 0 } );
+    }
+
+    {
+      EmulationConfig config;
+      config.delay_ms = 50;
+      EmulatedLinkTestHarness test { "fixed delay", config };
+      test.execute( Write { datagram( 1, payload ) } );
+      test.execute( Tick { 20 } );
+      test.execute( Write { datagram( 2, payload ) } );
+      test.execute( ExpectBytesInFlight { 200 } );
+      test.execute( Tick { 29 } );
+      test.execute( ExpectDelivered { {} } );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectDelivered { { 1 } } );
+      test.execute( Tick { 19 } );
+      test.execute( ExpectDelivered { { 1 } } );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectDelivered { { 1, 2 } } );
+      test.execute( ExpectBytesInFlight { 0 } );
+    }
+
+    {
+      EmulationConfig config;
+      config.delay_ms = 50;
+      EmulatedLinkTestHarness test { "TCP options count toward the size on the wire", config };
+      TCPMessage stamped = datagram( 1, payload - TCPSegment::TIMESTAMPS_LENGTH );
+      stamped.sender.TSval = 1;
+      test.execute( Write { stamped } );
+      test.execute( ExpectBytesInFlight { 100 } );
+    }
+
+    {
+      EmulationConfig config;
+      config.delay_ms = 100;
+      config.jitter_ms = 40;
+      config.seed = 1;
+      EmulatedLinkTestHarness test { "jitter alone never reorders", config };
+      for ( uint32_t i = 1; i <= 20; i++ ) {
+        test.execute( Write { datagram( i ) } );
+        test.execute( Tick { 1 } );
+      }
+      test.execute( Tick { 39 } );
+      test.execute( ExpectDelivered { {} } );
+      test.execute( Tick { 100 } );
+      test.execute( ExpectDelivered { { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20 } } );
+    }
+
+    {
+      // 10,000 bytes/s is one datagram every 10 ms
+      EmulationConfig config;
+      config.rate_bytes_per_s = 10'000;
+      config.bucket_bytes = 100;
+      config.queue_bytes = 300;
+      EmulatedLinkTestHarness test { "token bucket and finite queue", config };
+      for ( uint32_t i = 1; i <= 5; i++ ) {
+        test.execute( Write { datagram( i, payload ) } );
+      }
+      // the first empties the bucket, the next three wait in the queue, and the fifth finds the queue full
+      test.execute( ExpectDelivered { { 1 } } );
+      test.execute( ExpectBytesInFlight { 300 } );
+      test.execute( ExpectStats { { .sent = 1, .lost = 0, .queue_drops = 1, .reordered = 0, .duplicated = 0 } } );
+      test.execute( Tick { 9 } );
+      test.execute( ExpectDelivered { { 1 } } );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectDelivered { { 1, 2 } } );
+
+      // a coarse tick still lets each datagram go at its own time
+      test.execute( Tick { 25 } );
+      test.execute( ExpectDelivered { { 1, 2, 3, 4 } } );
+      test.execute( ExpectBytesInFlight { 0 } );
+    }
+
+    {
+      EmulationConfig config;
+      config.delay_ms = 30;
+      config.reorder_probability = 1;
+      config.duplicate_probability = 1;
+      EmulatedLinkTestHarness test { "reordering and duplication", config };
+      test.execute( Write { datagram( 1 ) } );
+      test.execute( ExpectDelivered { { 1, 1 } } );
+      test.execute( ExpectStats { { .sent = 2, .lost = 0, .queue_drops = 0, .reordered = 1, .duplicated = 1 } } );
+    }
+
+    {
+      EmulationConfig config;
+      config.good_to_bad = 1;
+      config.bad_to_good = 0;
+      EmulatedLinkTestHarness test { "Gilbert-Elliott loss in the bad state", config };
+      test.execute( Write { datagram( 1 ) } );
+      test.execute( Write { datagram( 2 ) } );
+      test.execute( ExpectDelivered { {} } );
+      test.execute( ExpectStats { { .sent = 0, .lost = 2, .queue_drops = 0, .reordered = 0, .duplicated = 0 } } );
+    }
+
+    {
+      // the chain spends 0.05 / (0.05 + 0.25) = 1/6 of its steps in the bad state, losing everything there
+      EmulationConfig config;
+      config.good_to_bad = 0.05;
+      config.bad_to_good = 0.25;
+      config.seed = 7;
+      EmulatedLinkTestHarness test { "Gilbert-Elliott loss rate", config };
+      for ( uint32_t i = 0; i < 20'000; i++ ) {
+        test.execute( Write { datagram( i ) } );
+      }
+      test.execute( ExpectLossRate { 0.14, 0.19 } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,115 @@
+#include "loopback_adapter.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <poll.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+void expect( const bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( "Expectation failed: " + what );
+  }
+}
+
+// Is the adapter's file descriptor readable, i.e. would the event loop wake it up?
+bool readable( TCPOverIPv4OverLoopbackFdAdapter& adapter )
+{
+  pollfd pfd { adapter.fd().fd_num(), POLLIN, 0 };
+  return poll( &pfd, 1, 0 ) == 1 and ( pfd.revents & POLLIN );
+}
+
+TCPMessage segment( const uint32_t seqno, const string& payload )
+{
+  TCPMessage msg;
+  msg.sender.seqno = Wrap32 { seqno };
+  msg.sender.payload = payload;
+  return msg;
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    const IPv4Endpoint client_end { 0x0a000001, 1234 };
+    const IPv4Endpoint server_end { 0x0a000002, 80 };
+    auto [client, server] = TCPOverIPv4OverLoopbackFdAdapter::make_pair();
+    client.config_mut().source = client_end;
+    client.config_mut().destination = server_end;
+    server.config_mut().source = server_end;
+    server.config_mut().destination = client_end;
+
+    {
+      // nothing written: nothing to read, and nothing to wake the reader
+      expect( not readable( server ), "idle end not readable" );
+      vector<TCPMessage> segments;
+      server.read_batch( segments, 8 );
+      expect( segments.empty(), "empty batch" );
+      expect( not server.read().has_value(), "nothing read" );
+    }
+
+    {
+      // a batch takes up to its limit, in order, and leaves the rest signalled for the next wakeup
+      for ( uint32_t i = 0; i < 5; i++ ) {
+        client.write( segment( 100 * i, "segment " + to_string( i ) ) );
+      }
+      expect( readable( server ), "written end readable" );
+
+      vector<TCPMessage> segments;
+      server.read_batch( segments, 3 );
+      expect( segments.size() == 3, "batch stops at its limit" );
+      expect( readable( server ), "still readable with datagrams left behind" );
+      server.read_batch( segments, 8 );
+      expect( segments.size() == 5, "rest read by the next batch" );
+      expect( not readable( server ), "not readable once drained" );
+      for ( uint32_t i = 0; i < 5; i++ ) {
+        expect( segments[i].sender.seqno == Wrap32 { 100 * i }, "segments in order" );
+        expect( segments[i].sender.payload == "segment " + to_string( i ), "payload intact" );
+      }
+    }
+
+    {
+      // datagrams for another connection count against the batch, but are not returned
+      auto [stranger, listener] = TCPOverIPv4OverLoopbackFdAdapter::make_pair();
+      stranger.config_mut().source = { 0x0a000003, 4321 };
+      stranger.config_mut().destination = server_end;
+      listener.config_mut().source = server_end;
+      listener.config_mut().destination = client_end;
+      stranger.write( segment( 1, "not for us" ) );
+      stranger.config_mut().source = client_end;
+      stranger.write( segment( 2, "for us" ) );
+
+      vector<TCPMessage> segments;
+      listener.read_batch( segments, 1 );
+      expect( segments.empty(), "unrelated datagram filtered" );
+      listener.read_batch( segments, 1 );
+      expect( segments.size() == 1 and segments.front().sender.payload == "for us", "related datagram read" );
+    }
+
+    {
+      // a single read takes one datagram, and the two directions are independent
+      server.write( segment( 7, "reply" ) );
+      client.write( segment( 8, "request" ) );
+      const auto reply = client.read();
+      expect( reply.has_value() and reply->sender.payload == "reply", "reply read" );
+      expect( not client.read().has_value(), "client drained" );
+      const auto request = server.read();
+      expect( request.has_value() and request->sender.payload == "request", "request read" );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
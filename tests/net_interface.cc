@@ -5,61 +5,9 @@
 
 #include <cstdlib>
 #include <iostream>
-#include <random>
 
 using namespace std;
 
-EthernetAddress random_private_ethernet_address()
-{
-  EthernetAddress addr;
-  for ( auto& byte : addr ) {
-    byte = random_device()(); // use a random local Ethernet address
-  }
-  addr.at( 0 ) |= 0x02; // "10" in last two binary digits marks a private Ethernet address
-  addr.at( 0 ) &= 0xfe;
-
-  return addr;
-}
-
-InternetDatagram make_datagram( const string& src_ip, const string& dst_ip ) // NOLINT(*-swappable-*)
-{
-  InternetDatagram dgram;
-  dgram.header.src = Address( src_ip, 0 ).ipv4_numeric();
-  dgram.header.dst = Address( dst_ip, 0 ).ipv4_numeric();
-  dgram.payload.emplace_back( "hello" );
-  dgram.header.len = static_cast<uint64_t>( dgram.header.hlen ) * 4 + dgram.payload.front().size();
-  dgram.header.compute_checksum();
-  return dgram;
-}
-
-ARPMessage make_arp( const uint16_t opcode,
-                     const EthernetAddress sender_ethernet_address,
-                     const string& sender_ip_address,
-                     const EthernetAddress target_ethernet_address,
-                     const string& target_ip_address )
-{
-  ARPMessage arp;
-  arp.opcode = opcode;
-  arp.sender_ethernet_address = sender_ethernet_address;
-  arp.sender_ip_address = Address( sender_ip_address, 0 ).ipv4_numeric();
-  arp.target_ethernet_address = target_ethernet_address;
-  arp.target_ip_address = Address( target_ip_address, 0 ).ipv4_numeric();
-  return arp;
-}
-
-EthernetFrame make_frame( const EthernetAddress& src,
-                          const EthernetAddress& dst,
-                          const uint16_t type,
-                          vector<string> payload )
-{
-  EthernetFrame frame;
-  frame.header.src = src;
-  frame.header.dst = dst;
-  frame.header.type = type;
-  frame.payload = std::move( payload );
-  return frame;
-}
-
 int main()
 {
   try {
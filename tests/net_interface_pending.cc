@@ -0,0 +1,226 @@
+#include "arp_message.hh"
+#include "ethernet_header.hh"
+#include "ipv4_datagram.hh"
+#include "network_interface_test_harness.hh"
+
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+
+using namespace std;
+
+EthernetFrame arp_request( const EthernetAddress& local_eth, const string& local_ip, const string& target_ip )
+{
+  return make_frame( local_eth,
+                     ETHERNET_BROADCAST,
+                     EthernetHeader::TYPE_ARP,
+                     serialize( make_arp( ARPMessage::OPCODE_REQUEST, local_eth, local_ip, {}, target_ip ) ) );
+}
+
+EthernetFrame arp_reply( const EthernetAddress& remote_eth,
+                         const string& remote_ip,
+                         const EthernetAddress& local_eth,
+                         const string& local_ip )
+{
+  const ARPMessage reply = make_arp( ARPMessage::OPCODE_REPLY, remote_eth, remote_ip, local_eth, local_ip );
+  return make_frame( remote_eth, local_eth, EthernetHeader::TYPE_ARP, serialize( reply ) );
+}
+
+int main()
+{
+  try {
+    // Each datagram below occupies a 20-byte header and a 5-byte payload.
+    constexpr size_t dgram_bytes = IPv4Header::LENGTH + 5;
+
+    {
+      const EthernetAddress local_eth = random_private_ethernet_address();
+      NetworkInterfaceTestHarness test { "per-hop limit evicts oldest", local_eth, Address( "4.3.2.1", 0 ) };
+      test.execute( SetPendingLimits { { .max_datagrams_per_hop = 2, .max_datagrams = 1024 } } );
+
+      const auto datagram1 = make_datagram( "5.6.7.8", "13.12.11.10" );
+      const auto datagram2 = make_datagram( "5.6.7.8", "13.12.11.11" );
+      const auto datagram3 = make_datagram( "5.6.7.8", "13.12.11.12" );
+
+      test.execute( SendDatagram { datagram1, Address( "192.168.0.1", 0 ) } );
+      test.execute( ExpectFrame { arp_request( local_eth, "4.3.2.1", "192.168.0.1" ) } );
+      test.execute( SendDatagram { datagram2, Address( "192.168.0.1", 0 ) } );
+      test.execute( SendDatagram { datagram3, Address( "192.168.0.1", 0 ) } );
+      test.execute( ExpectNoFrame {} );
+      test.execute( ExpectPendingDatagrams { 2 } );
+      test.execute( ExpectPendingBytes { 2 * dgram_bytes } );
+      test.execute( ExpectPendingCounters { { .queued = 3, .flushed = 0, .dropped = 1 } } );
+
+      // only the two most recent datagrams are still queued
+      const EthernetAddress target_eth = random_private_ethernet_address();
+      test.execute( ReceiveFrame { arp_reply( target_eth, "192.168.0.1", local_eth, "4.3.2.1" ), {} } );
+      test.execute(
+        ExpectFrame { make_frame( local_eth, target_eth, EthernetHeader::TYPE_IPv4, serialize( datagram2 ) ) } );
+      test.execute(
+        ExpectFrame { make_frame( local_eth, target_eth, EthernetHeader::TYPE_IPv4, serialize( datagram3 ) ) } );
+      test.execute( ExpectNoFrame {} );
+      test.execute( ExpectPendingDatagrams { 0 } );
+      test.execute( ExpectPendingBytes { 0 } );
+      test.execute( ExpectPendingCounters { { .queued = 3, .flushed = 2, .dropped = 1 } } );
+    }
+
+    {
+      const EthernetAddress local_eth = random_private_ethernet_address();
+      NetworkInterfaceTestHarness test { "failed resolution drops queue", local_eth, Address( "1.2.3.4", 0 ) };
+
+      test.execute( SendDatagram { make_datagram( "5.6.7.8", "13.12.11.10" ), Address( "10.0.0.1", 0 ) } );
+      test.execute( ExpectFrame { arp_request( local_eth, "1.2.3.4", "10.0.0.1" ) } );
+      test.execute( SendDatagram { make_datagram( "17.17.17.17", "18.18.18.18" ), Address( "10.0.0.1", 0 ) } );
+      test.execute( ExpectPendingDatagrams { 2 } );
+      test.execute( Tick { 4990 } );
+      test.execute( ExpectPendingDatagrams { 2 } );
+      test.execute( Tick { 20 } );
+      test.execute( ExpectPendingDatagrams { 0 } );
+      test.execute( ExpectPendingBytes { 0 } );
+      test.execute( ExpectPendingCounters { { .queued = 2, .flushed = 0, .dropped = 2 } } );
+
+      // a late reply must not resurrect the dropped datagrams
+      const EthernetAddress target_eth = random_private_ethernet_address();
+      test.execute( ReceiveFrame { arp_reply( target_eth, "10.0.0.1", local_eth, "1.2.3.4" ), {} } );
+      test.execute( ExpectNoFrame {} );
+    }
+
+    {
+      const EthernetAddress local_eth = random_private_ethernet_address();
+      NetworkInterfaceTestHarness test { "interface-wide limit", local_eth, Address( "10.0.0.1", 0 ) };
+      test.execute( SetPendingLimits { { .max_datagrams_per_hop = 64, .max_datagrams = 3 } } );
+
+      test.execute( SendDatagram { make_datagram( "5.6.7.8", "13.12.11.10" ), Address( "10.0.0.5", 0 ) } );
+      test.execute( ExpectFrame { arp_request( local_eth, "10.0.0.1", "10.0.0.5" ) } );
+      test.execute( SendDatagram { make_datagram( "5.6.7.8", "13.12.11.11" ), Address( "10.0.0.5", 0 ) } );
+      test.execute( SendDatagram { make_datagram( "5.6.7.8", "13.12.11.12" ), Address( "10.0.0.6", 0 ) } );
+      test.execute( ExpectFrame { arp_request( local_eth, "10.0.0.1", "10.0.0.6" ) } );
+      test.execute( SendDatagram { make_datagram( "5.6.7.8", "13.12.11.13" ), Address( "10.0.0.6", 0 ) } );
+      test.execute( ExpectNoFrame {} );
+      test.execute( ExpectPendingDatagrams { 3 } );
+      test.execute( ExpectPendingCounters { { .queued = 3, .flushed = 0, .dropped = 1 } } );
+    }
+
+    {
+      const EthernetAddress local_eth = random_private_ethernet_address();
+      NetworkInterfaceTestHarness test { "pending-bytes budget", local_eth, Address( "10.0.0.1", 0 ) };
+      test.execute( SetPendingByteBudget { 2 * dgram_bytes } );
+
+      const auto datagram1 = make_datagram( "5.6.7.8", "13.12.11.10" );
+      const auto datagram2 = make_datagram( "5.6.7.8", "13.12.11.11" );
+
+      test.execute( SendDatagram { datagram1, Address( "10.0.0.5", 0 ) } );
+      test.execute( ExpectFrame { arp_request( local_eth, "10.0.0.1", "10.0.0.5" ) } );
+      test.execute( SendDatagram { datagram2, Address( "10.0.0.7", 0 ) } );
+      test.execute( ExpectFrame { arp_request( local_eth, "10.0.0.1", "10.0.0.7" ) } );
+      test.execute( SendDatagram { make_datagram( "5.6.7.8", "13.12.11.12" ), Address( "10.0.0.5", 0 ) } );
+      test.execute( ExpectNoFrame {} );
+      test.execute( ExpectPendingBytes { 2 * dgram_bytes } );
+      test.execute( ExpectPendingCounters { { .queued = 2, .flushed = 0, .dropped = 1 } } );
+
+      // resolving one next hop frees its share of the budget
+      const EthernetAddress target_eth = random_private_ethernet_address();
+      test.execute( ReceiveFrame { arp_reply( target_eth, "10.0.0.5", local_eth, "10.0.0.1" ), {} } );
+      test.execute(
+        ExpectFrame { make_frame( local_eth, target_eth, EthernetHeader::TYPE_IPv4, serialize( datagram1 ) ) } );
+      test.execute( ExpectNoFrame {} );
+      test.execute( ExpectPendingBytes { dgram_bytes } );
+      test.execute( SendDatagram { make_datagram( "5.6.7.8", "13.12.11.13" ), Address( "10.0.0.9", 0 ) } );
+      test.execute( ExpectFrame { arp_request( local_eth, "10.0.0.1", "10.0.0.9" ) } );
+      test.execute( ExpectPendingCounters { { .queued = 3, .flushed = 1, .dropped = 1 } } );
+    }
+
+    {
+      const EthernetAddress local_eth = random_private_ethernet_address();
+      NetworkInterfaceTestHarness test { "full interface, full hop", local_eth, Address( "10.0.0.1", 0 ) };
+      test.execute( SetPendingLimits { { .max_datagrams_per_hop = 2, .max_datagrams = 4 } } );
+
+      const auto datagram1 = make_datagram( "5.6.7.8", "13.12.11.10" );
+      const auto datagram2 = make_datagram( "5.6.7.8", "13.12.11.11" );
+
+      test.execute( SendDatagram { datagram1, Address( "10.0.0.5", 0 ) } );
+      test.execute( ExpectFrame { arp_request( local_eth, "10.0.0.1", "10.0.0.5" ) } );
+      test.execute( SendDatagram { datagram2, Address( "10.0.0.5", 0 ) } );
+      test.execute( SendDatagram { make_datagram( "5.6.7.8", "13.12.11.12" ), Address( "10.0.0.6", 0 ) } );
+      test.execute( ExpectFrame { arp_request( local_eth, "10.0.0.1", "10.0.0.6" ) } );
+      test.execute( SendDatagram { make_datagram( "5.6.7.8", "13.12.11.13" ), Address( "10.0.0.6", 0 ) } );
+      test.execute( SetPendingLimits { { .max_datagrams_per_hop = 2, .max_datagrams = 3 } } );
+
+      // evicting 10.0.0.5's oldest datagram would make room in its own queue, but the interface would still be
+      // full, so only the new datagram is dropped
+      test.execute( SendDatagram { make_datagram( "5.6.7.8", "13.12.11.14" ), Address( "10.0.0.5", 0 ) } );
+      test.execute( ExpectNoFrame {} );
+      test.execute( ExpectPendingDatagrams { 4 } );
+      test.execute( ExpectPendingCounters { { .queued = 4, .flushed = 0, .dropped = 1 } } );
+
+      const EthernetAddress target_eth = random_private_ethernet_address();
+      test.execute( ReceiveFrame { arp_reply( target_eth, "10.0.0.5", local_eth, "10.0.0.1" ), {} } );
+      test.execute(
+        ExpectFrame { make_frame( local_eth, target_eth, EthernetHeader::TYPE_IPv4, serialize( datagram1 ) ) } );
+      test.execute(
+        ExpectFrame { make_frame( local_eth, target_eth, EthernetHeader::TYPE_IPv4, serialize( datagram2 ) ) } );
+      test.execute( ExpectNoFrame {} );
+    }
+
+    {
+      const EthernetAddress local_eth = random_private_ethernet_address();
+      NetworkInterfaceTestHarness test { "exhausted budget, full hop", local_eth, Address( "10.0.0.1", 0 ) };
+      test.execute( SetPendingLimits { { .max_datagrams_per_hop = 1, .max_datagrams = 1024 } } );
+      test.execute( SetPendingByteBudget { 2 * dgram_bytes } );
+
+      const auto datagram1 = make_datagram( "5.6.7.8", "13.12.11.10" );
+
+      test.execute( SendDatagram { datagram1, Address( "10.0.0.5", 0 ) } );
+      test.execute( ExpectFrame { arp_request( local_eth, "10.0.0.1", "10.0.0.5" ) } );
+      test.execute( SendDatagram { make_datagram( "5.6.7.8", "13.12.11.11" ), Address( "10.0.0.6", 0 ) } );
+      test.execute( ExpectFrame { arp_request( local_eth, "10.0.0.1", "10.0.0.6" ) } );
+
+      // a larger datagram would not fit even with 10.0.0.5's queued datagram evicted
+      InternetDatagram large = make_datagram( "5.6.7.8", "13.12.11.12" );
+      large.payload.emplace_back( "more bytes than the budget has room for" );
+      test.execute( SendDatagram { large, Address( "10.0.0.5", 0 ) } );
+      test.execute( ExpectNoFrame {} );
+      test.execute( ExpectPendingBytes { 2 * dgram_bytes } );
+      test.execute( ExpectPendingCounters { { .queued = 2, .flushed = 0, .dropped = 1 } } );
+
+      // one that fits once the oldest is evicted replaces it
+      const auto datagram3 = make_datagram( "5.6.7.8", "13.12.11.13" );
+      test.execute( SendDatagram { datagram3, Address( "10.0.0.5", 0 ) } );
+      test.execute( ExpectPendingBytes { 2 * dgram_bytes } );
+      test.execute( ExpectPendingCounters { { .queued = 3, .flushed = 0, .dropped = 2 } } );
+
+      const EthernetAddress target_eth = random_private_ethernet_address();
+      test.execute( ReceiveFrame { arp_reply( target_eth, "10.0.0.5", local_eth, "10.0.0.1" ), {} } );
+      test.execute(
+        ExpectFrame { make_frame( local_eth, target_eth, EthernetHeader::TYPE_IPv4, serialize( datagram3 ) ) } );
+      test.execute( ExpectNoFrame {} );
+    }
+
+    {
+      // an interface destroyed with datagrams still queued returns their bytes to the shared budget
+      const auto budget = make_shared<NetworkInterface::PendingBudget>();
+      const auto output = make_shared<FramesOut>();
+      NetworkInterface kept { "kept", output, random_private_ethernet_address(), Address( "10.0.0.1", 0 ) };
+      kept.set_pending_budget( budget );
+      kept.send_datagram( make_datagram( "5.6.7.8", "13.12.11.10" ), Address( "10.0.0.5", 0 ) );
+      {
+        const EthernetAddress destroyed_eth = random_private_ethernet_address();
+        NetworkInterface destroyed { "destroyed", output, destroyed_eth, Address( "10.0.1.1", 0 ) };
+        destroyed.set_pending_budget( budget );
+        destroyed.send_datagram( make_datagram( "5.6.7.8", "13.12.11.11" ), Address( "10.0.1.5", 0 ) );
+        destroyed.send_datagram( make_datagram( "5.6.7.8", "13.12.11.12" ), Address( "10.0.1.5", 0 ) );
+        if ( budget->used_bytes != 3 * dgram_bytes ) {
+          throw runtime_error( "both interfaces' datagrams should be charged to the shared budget" );
+        }
+      }
+      if ( budget->used_bytes != dgram_bytes ) {
+        throw runtime_error( "a destroyed interface should return its pending bytes to the shared budget" );
+      }
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -2,7 +2,10 @@
 
 #include <compare>
 #include <optional>
+#include <random>
+#include <string>
 #include <utility>
+#include <vector>
 
 #include "arp_message.hh"
 #include "common.hh"
@@ -26,8 +29,7 @@ public:
                                const Address& ip_address )
     : TestHarness( move( test_name ), "eth=" + to_string( ethernet_address ) + ", ip=" + ip_address.ip(), [&] {
       const Output output { std::make_shared<FramesOut>() };
-      const NetworkInterface iface { "test", output, ethernet_address, ip_address };
-      return InterfaceAndOutput { iface, output };
+      return InterfaceAndOutput { NetworkInterface { "test", output, ethernet_address, ip_address }, output };
     }() )
   {}
 };
@@ -147,6 +149,73 @@ struct Tick : public Action<InterfaceAndOutput>
   explicit Tick( const size_t ms ) : _ms( ms ) {}
 };
 
+struct SetPendingLimits : public Action<InterfaceAndOutput>
+{
+  NetworkInterface::PendingLimits limits;
+
+  std::string description() const override
+  {
+    return "limit pending datagrams to " + std::to_string( limits.max_datagrams_per_hop ) + " per next hop and "
+           + std::to_string( limits.max_datagrams ) + " in total";
+  }
+  void execute( InterfaceAndOutput& interface ) const override { interface.first.set_pending_limits( limits ); }
+
+  explicit SetPendingLimits( const NetworkInterface::PendingLimits& l ) : limits( l ) {}
+};
+
+struct SetPendingByteBudget : public Action<InterfaceAndOutput>
+{
+  size_t max_bytes;
+
+  std::string description() const override { return "limit pending bytes to " + std::to_string( max_bytes ); }
+  void execute( InterfaceAndOutput& interface ) const override
+  {
+    interface.first.set_pending_budget( std::make_shared<NetworkInterface::PendingBudget>( max_bytes ) );
+  }
+
+  explicit SetPendingByteBudget( const size_t b ) : max_bytes( b ) {}
+};
+
+struct ExpectPendingDatagrams : public ExpectNumber<InterfaceAndOutput, size_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "pending_datagrams"; }
+  size_t value( InterfaceAndOutput& interface ) const override { return interface.first.pending_datagrams(); }
+};
+
+struct ExpectPendingBytes : public ExpectNumber<InterfaceAndOutput, size_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "pending_bytes"; }
+  size_t value( InterfaceAndOutput& interface ) const override { return interface.first.pending_bytes(); }
+};
+
+struct ExpectPendingCounters : public Expectation<InterfaceAndOutput>
+{
+  NetworkInterface::PendingCounters expected;
+
+  std::string description() const override
+  {
+    return "pending counters are queued=" + std::to_string( expected.queued ) + ", flushed="
+           + std::to_string( expected.flushed ) + ", dropped=" + std::to_string( expected.dropped );
+  }
+  void execute( InterfaceAndOutput& interface ) const override
+  {
+    const auto& actual = interface.first.pending_counters();
+    if ( actual.queued != expected.queued ) {
+      throw ExpectationViolation { "pending_counters().queued", expected.queued, actual.queued };
+    }
+    if ( actual.flushed != expected.flushed ) {
+      throw ExpectationViolation { "pending_counters().flushed", expected.flushed, actual.flushed };
+    }
+    if ( actual.dropped != expected.dropped ) {
+      throw ExpectationViolation { "pending_counters().dropped", expected.dropped, actual.dropped };
+    }
+  }
+
+  explicit ExpectPendingCounters( const NetworkInterface::PendingCounters& e ) : expected( e ) {}
+};
+
 inline std::string summary( const EthernetFrame& frame )
 {
   std::string out = frame.header.to_string() + " payload: ";
@@ -174,3 +243,57 @@ inline std::string summary( const EthernetFrame& frame )
   }
   return out;
 }
+
+// Frames and messages for the network interface tests to send and expect
+
+inline EthernetAddress random_private_ethernet_address()
+{
+  EthernetAddress addr;
+  for ( auto& byte : addr ) {
+    byte = std::random_device()(); // use a random local Ethernet address
+  }
+  addr.at( 0 ) |= 0x02; // "10" in last two binary digits marks a private Ethernet address
+  addr.at( 0 ) &= 0xfe;
+
+  return addr;
+}
+
+// NOLINTNEXTLINE(*-swappable-*)
+inline InternetDatagram make_datagram( const std::string& src_ip, const std::string& dst_ip )
+{
+  InternetDatagram dgram;
+  dgram.header.src = Address( src_ip, 0 ).ipv4_numeric();
+  dgram.header.dst = Address( dst_ip, 0 ).ipv4_numeric();
+  dgram.payload.emplace_back( "hello" );
+  dgram.header.len = static_cast<uint64_t>( dgram.header.hlen ) * 4 + dgram.payload.front().size();
+  dgram.header.compute_checksum();
+  return dgram;
+}
+
+inline ARPMessage make_arp( const uint16_t opcode,
+                            const EthernetAddress sender_ethernet_address,
+                            const std::string& sender_ip_address,
+                            const EthernetAddress target_ethernet_address,
+                            const std::string& target_ip_address )
+{
+  ARPMessage arp;
+  arp.opcode = opcode;
+  arp.sender_ethernet_address = sender_ethernet_address;
+  arp.sender_ip_address = Address( sender_ip_address, 0 ).ipv4_numeric();
+  arp.target_ethernet_address = target_ethernet_address;
+  arp.target_ip_address = Address( target_ip_address, 0 ).ipv4_numeric();
+  return arp;
+}
+
+inline EthernetFrame make_frame( const EthernetAddress& src,
+                                 const EthernetAddress& dst,
+                                 const uint16_t type,
+                                 std::vector<std::string> payload )
+{
+  EthernetFrame frame;
+  frame.header.src = src;
+  frame.header.dst = dst;
+  frame.header.type = type;
+  frame.payload = std::move( payload );
+  return frame;
+}
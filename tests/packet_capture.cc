@@ -0,0 +1,115 @@
+#include "ethernet_frame.hh"
+#include "network_interface.hh"
+#include "packet_capture.hh"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+void expect( const bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( "Expectation failed: " + what );
+  }
+}
+
+class DiscardPort : public NetworkInterface::OutputPort
+{
+public:
+  size_t frames {};
+  void transmit( const NetworkInterface&, const EthernetFrame& ) override { frames++; }
+};
+
+} // namespace
+
+int main()
+{
+  try {
+    const auto path = filesystem::temp_directory_path() / ( "minnow_capture_" + to_string( getpid() ) + ".pcap" );
+
+    {
+      // packets are truncated to the snap length, and the original length is kept
+      {
+        PacketCapture capture { path, PacketCapture::LinkType::IPv4, { .snap_length = 8 } };
+        capture.capture( "short" );
+        capture.capture( "a packet longer than the snap length" );
+        const vector<string_view> pieces { "in ", "three ", "pieces" };
+        capture.capture( pieces );
+        expect( capture.stats().captured == 3, "three packets captured" );
+      }
+
+      const auto file = PcapFile::read( path );
+      expect( file.snap_length == 8, "snap length in the file header" );
+      expect( file.link_type == 228, "link type IPv4" );
+      expect( file.packets.size() == 3, "three packets in the file" );
+      expect( file.packets[0].data == "short" and file.packets[0].original_length == 5, "short packet whole" );
+      expect( file.packets[1].data == "a packet" and file.packets[1].original_length == 36, "long packet cut" );
+      expect( file.packets[2].data == "in three" and file.packets[2].original_length == 15, "pieces joined" );
+
+      const auto now = chrono::system_clock::now().time_since_epoch();
+      const auto now_ns = static_cast<uint64_t>( chrono::duration_cast<chrono::nanoseconds>( now ).count() );
+      expect( file.packets[0].time_ns <= now_ns and file.packets[0].time_ns + 60'000'000'000 > now_ns,
+              "timestamp in nanoseconds" );
+    }
+
+    {
+      // sampling keeps one packet in N, and a full ring drops packets instead of waiting for the writer
+      {
+        const CaptureOptions options { .sample_every = 3, .ring_slots = 4, .flush_interval_ms = 60'000 };
+        PacketCapture capture { path, PacketCapture::LinkType::IPv4, options };
+        for ( int i = 0; i < 30; i++ ) {
+          capture.capture( to_string( i ) );
+        }
+        const auto stats = capture.stats();
+        expect( stats.sampled_out == 20, "two in three packets sampled out" );
+        expect( stats.captured == 4 and stats.dropped == 6, "ring of four slots fills up" );
+      }
+
+      const auto file = PcapFile::read( path );
+      expect( file.packets.size() == 4, "four packets in the file" );
+      expect( file.packets[0].data == "0" and file.packets[3].data == "9", "every third packet, in order" );
+    }
+
+    {
+      // a capturing port records each Ethernet frame, and passes it on
+      auto port = make_shared<DiscardPort>();
+      {
+        auto capture = make_shared<PacketCapture>( path, PacketCapture::LinkType::Ethernet );
+        NetworkInterface interface { "eth0",
+                                     make_shared<NetworkInterface::CapturingPort>( port, capture ),
+                                     { 0x02, 0, 0, 0, 0, 1 },
+                                     Address { "10.0.0.1" } };
+        InternetDatagram dgram;
+        dgram.header.dst = Address { "10.0.0.2" }.ipv4_numeric();
+        interface.send_datagram( dgram, Address { "10.0.0.2" } ); // sends an ARP request
+      }
+
+      const auto file = PcapFile::read( path );
+      expect( port->frames == 1, "frame passed on" );
+      expect( file.link_type == 1, "link type Ethernet" );
+      expect( file.packets.size() == 1, "one frame captured" );
+      expect( file.packets[0].original_length == EthernetHeader::LENGTH + ARPMessage::LENGTH, "ARP frame length" );
+      expect( file.packets[0].data.substr( 0, 6 ) == string( 6, '\xff' ), "broadcast destination" );
+      expect( file.packets[0].data.substr( 12, 2 ) == "\x08\x06", "ARP type" );
+    }
+
+    filesystem::remove( path );
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
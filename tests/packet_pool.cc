@@ -0,0 +1,153 @@
+#include "packet_pool.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+void expect( const bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( "Expectation failed: " + what );
+  }
+}
+
+constexpr size_t BUFFERS_PER_SLAB = PacketPool::SLAB_SIZE / PacketPool::BUFFER_SIZE;
+
+uintptr_t address( PacketPool::Handle& handle )
+{
+  return reinterpret_cast<uintptr_t>( handle.buffer().data() ); // NOLINT(*-reinterpret-cast)
+}
+
+// Acquire `count` buffers at once, and check that no buffer is handed out twice
+vector<PacketPool::Handle> acquire_distinct( const size_t count )
+{
+  vector<PacketPool::Handle> handles;
+  set<uintptr_t> addresses;
+  for ( size_t i = 0; i < count; i++ ) {
+    handles.push_back( PacketPool::global().acquire() );
+    expect( addresses.insert( address( handles.back() ) ).second, "each buffer handed out once" );
+  }
+  return handles;
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    auto& pool = PacketPool::global();
+
+    {
+      // a handle owns a whole buffer, and its size stays within it
+      auto handle = pool.acquire();
+      expect( static_cast<bool>( handle ), "acquired handle holds a buffer" );
+      expect( handle.buffer().size() == PacketPool::BUFFER_SIZE, "whole buffer available" );
+      expect( handle.size() == 0, "nothing in use yet" );
+      memcpy( handle.buffer().data(), "hello", 5 );
+      handle.resize( 5 );
+      expect( handle.view() == "hello", "bytes in use" );
+      handle.resize( PacketPool::BUFFER_SIZE );
+
+      bool threw = false;
+      try {
+        handle.resize( PacketPool::BUFFER_SIZE + 1 );
+      } catch ( const runtime_error& ) {
+        threw = true;
+      }
+      expect( threw, "resize beyond the buffer throws" );
+      expect( handle.size() == PacketPool::BUFFER_SIZE, "failed resize leaves the size alone" );
+
+      PacketPool::Handle moved { std::move( handle ) };
+      expect( not handle and moved, "move transfers the buffer" ); // NOLINT(*-use-after-move)
+      expect( handle.buffer().empty() and handle.size() == 0, "moved-from handle is empty" );
+
+      PacketPool::Handle empty;
+      empty.resize( 0 );
+      threw = false;
+      try {
+        empty.resize( 1 );
+      } catch ( const runtime_error& ) {
+        threw = true;
+      }
+      expect( threw, "an empty handle has no room" );
+    }
+
+    {
+      // taking out several caches' worth refills the thread cache from the shared list, and giving them back
+      // drains it; once warmed up, the same traffic needs no new slabs
+      auto first = acquire_distinct( 3 * BUFFERS_PER_SLAB / 2 );
+      first.clear();
+      const size_t slabs = pool.slab_count();
+      expect( slabs >= 2, "pool grew to hold the buffers" );
+      for ( int round = 0; round < 100; round++ ) {
+        auto handles = acquire_distinct( 3 * BUFFERS_PER_SLAB / 2 );
+      }
+      for ( int round = 0; round < 10000; round++ ) {
+        auto handle = pool.acquire();
+      }
+      expect( pool.slab_count() == slabs, "no new slabs in steady state" );
+    }
+
+    {
+      // slabs are 2 MiB-aligned (so they can be backed by a hugepage), and every buffer in the pool can be held
+      // at once before it grows
+      const size_t slabs = pool.slab_count();
+      auto all = acquire_distinct( slabs * BUFFERS_PER_SLAB );
+      expect( pool.slab_count() == slabs, "every free buffer handed out before growing" );
+      map<uintptr_t, size_t> per_slab;
+      for ( auto& handle : all ) {
+        per_slab[address( handle ) & ~( PacketPool::SLAB_SIZE - 1 )]++;
+      }
+      expect( per_slab.size() == slabs, "buffers fall in one aligned 2 MiB range per slab" );
+      expect( ranges::all_of( per_slab, []( const auto& slab ) { return slab.second == BUFFERS_PER_SLAB; } ),
+              "each aligned range holds a whole slab" );
+
+      auto one_more = pool.acquire();
+      expect( pool.slab_count() == slabs + 1, "pool grows by a slab when every buffer is in use" );
+    }
+
+    {
+      // buffers released on other threads, including after a thread's cache is gone, come back to the pool
+      vector<thread> threads;
+      for ( int t = 0; t < 4; t++ ) {
+        threads.emplace_back( [] {
+          // constructed before the thread's cache, so destroyed after it: these go straight to the shared list
+          thread_local vector<PacketPool::Handle> released_late;
+          for ( int round = 0; round < 1000; round++ ) {
+            auto handles = acquire_distinct( 40 );
+          }
+          released_late = acquire_distinct( 40 );
+        } );
+      }
+
+      // handles acquired here and released on another thread
+      auto handed_over = acquire_distinct( 100 );
+      threads.emplace_back( [handles = std::move( handed_over )] {} );
+      for ( auto& thread : threads ) {
+        thread.join();
+      }
+
+      const size_t slabs = pool.slab_count();
+      auto all = acquire_distinct( slabs * BUFFERS_PER_SLAB );
+      expect( pool.slab_count() == slabs, "no buffer lost across threads" );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,63 @@
+#include "tcp_peer_test_harness.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+int main()
+{
+  try {
+    {
+      // segments received together get one acknowledgment between them
+      Connection c { Connection::eager() };
+      c.send( string( 3 * TCPConfig::MAX_PAYLOAD_SIZE, 'x' ) );
+      vector<TCPMessage> batch { c.to_server.begin(), c.to_server.end() };
+      c.to_server.clear();
+      expect( batch.size() == 3, "three segments sent" );
+      c.server.receive_batch( batch, c.to_client_fn() );
+      expect( c.server.inbound_reader().bytes_buffered() == 3 * TCPConfig::MAX_PAYLOAD_SIZE, "all received" );
+      expect( c.to_client.size() == 1, "one acknowledgment" );
+      expect( c.to_client.front().receiver.ackno == c.server.receiver().send().ackno, "of all three" );
+    }
+
+    {
+      // a segment that ends the connection does not cost the segments before it their acknowledgment
+      Connection c { Connection::eager() };
+      c.client.outbound_writer().close();
+      c.client.push( c.to_server_fn() );
+      c.to_server.clear(); // the client's FIN is lost, and then retransmitted more than once, so the server (its
+                           // stream finished first) does not linger once its own FIN is acknowledged
+      c.client.tick( Connection::eager().rt_timeout, c.to_server_fn() );
+      const TCPMessage client_fin = c.to_server.back();
+      while ( not c.to_server.empty() ) {
+        c.deliver_to_server();
+      }
+      while ( not c.to_client.empty() ) {
+        c.deliver_to_client();
+      }
+
+      c.server.outbound_writer().close();
+      c.server.push( c.to_client_fn() );
+      c.deliver_to_client();
+      expect( c.to_server.size() == 1, "client acknowledges the server's FIN" );
+
+      // the client's FIN arrives again (its acknowledgment was lost), and then the acknowledgment of the server's
+      // FIN, which ends the connection, and then one more copy
+      vector<TCPMessage> batch { client_fin, c.to_server.front(), client_fin };
+      c.to_server.clear();
+      c.server.receive_batch( batch, c.to_client_fn() );
+      expect( not c.server.active(), "connection ended" );
+      expect( c.to_client.size() == 1 and c.to_client.front().sender.sequence_length() == 0,
+              "the repeated FIN acknowledged" );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,114 @@
+#include "tcp_peer_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    {
+      // every second full-sized segment is acknowledged
+      Connection c { Connection::delayed() };
+      const uint64_t handshake_segments = c.server.stats().segments_sent;
+      c.send( string( 4 * TCPConfig::MAX_PAYLOAD_SIZE, 'x' ) );
+      expect( c.to_server.size() == 4, "four segments sent" );
+      c.deliver_to_server();
+      expect( c.to_client.empty(), "first segment not acknowledged yet" );
+      c.deliver_to_server();
+      expect( c.to_client.size() == 1, "second segment acknowledged" );
+      c.deliver_to_server();
+      c.deliver_to_server();
+      expect( c.to_client.size() == 2, "fourth segment acknowledged" );
+      expect( c.server.stats().segments_sent == handshake_segments + 2, "two acknowledgments for four segments" );
+    }
+
+    {
+      // a lone small segment is acknowledged when the timer expires
+      Connection c { Connection::delayed() };
+      c.send( "hello" );
+      c.deliver_to_server();
+      expect( c.to_client.empty(), "small segment not acknowledged yet" );
+      c.server.tick( Connection::delayed().ack_delay_ms - 1, c.to_client_fn() );
+      expect( c.to_client.empty(), "not acknowledged before the delay" );
+      c.server.tick( 1, c.to_client_fn() );
+      expect( c.to_client.size() == 1, "acknowledged after the delay" );
+      c.server.tick( Connection::delayed().ack_delay_ms, c.to_client_fn() );
+      expect( c.to_client.size() == 1, "acknowledged once" );
+    }
+
+    {
+      // out-of-order data, and the data that fills the gap, are acknowledged at once
+      Connection c { Connection::delayed() };
+      c.send( "abc" );
+      c.send( "def" );
+      const TCPMessage first = c.to_server.front();
+      c.to_server.pop_front();
+      c.deliver_to_server();
+      expect( c.to_client.size() == 1, "out-of-order segment acknowledged at once" );
+      c.server.receive( first, c.to_client_fn() );
+      expect( c.to_client.size() == 2, "segment that fills the gap acknowledged at once" );
+      expect( c.server.inbound_reader().bytes_buffered() == 6, "data reassembled" );
+    }
+
+    {
+      // a FIN is acknowledged at once
+      Connection c { Connection::delayed() };
+      c.client.outbound_writer().push( "bye" );
+      c.client.outbound_writer().close();
+      c.client.push( c.to_server_fn() );
+      c.deliver_to_server();
+      expect( c.to_client.size() == 1, "FIN acknowledged at once" );
+    }
+
+    {
+      // half the receive buffer is acknowledged at once, even if that is less than two segments
+      TCPConfig small = Connection::delayed();
+      small.recv_capacity = TCPConfig::MAX_PAYLOAD_SIZE + TCPConfig::MAX_PAYLOAD_SIZE / 2;
+      Connection c { small };
+      c.send( "x" );
+      c.deliver_to_server();
+      expect( c.to_client.empty(), "small segment delayed" );
+      c.send( string( TCPConfig::MAX_PAYLOAD_SIZE, 'y' ) );
+      c.deliver_to_server();
+      expect( c.to_client.size() == 1, "half the receive buffer acknowledged at once" );
+    }
+
+    {
+      // a delayed acknowledgment goes out at once when the application opens the window by two segments
+      TCPConfig small = Connection::delayed();
+      small.recv_capacity = 5 * TCPConfig::MAX_PAYLOAD_SIZE;
+      Connection c { small };
+      c.send( string( 3 * TCPConfig::MAX_PAYLOAD_SIZE, 'x' ) );
+      c.deliver_to_server();
+      c.deliver_to_server();
+      expect( c.to_client.size() == 1, "second segment acknowledged" );
+      c.deliver_to_server();
+      expect( c.to_client.size() == 1, "third segment delayed" );
+      c.server.inbound_reader().pop( TCPConfig::MAX_PAYLOAD_SIZE );
+      c.server.tick( 1, c.to_client_fn() );
+      expect( c.to_client.size() == 1, "still delayed" );
+      c.server.inbound_reader().pop( 2 * TCPConfig::MAX_PAYLOAD_SIZE );
+      c.server.tick( 1, c.to_client_fn() );
+      expect( c.to_client.size() == 2, "acknowledged when the window opens" );
+      expect( c.to_client.back().receiver.window_size == 5 * TCPConfig::MAX_PAYLOAD_SIZE, "window fully open" );
+    }
+
+    {
+      // with no delay, every segment is acknowledged
+      Connection c { Connection::eager() };
+      c.send( "a" );
+      c.deliver_to_server();
+      expect( c.to_client.size() == 1, "acknowledged at once" );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
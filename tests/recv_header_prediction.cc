@@ -0,0 +1,41 @@
+#include "tcp_peer_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    {
+      // in-order data and bare acknowledgments take the header-prediction fast path, and reordered data does not
+      Connection c { Connection::delayed() };
+      const uint64_t handshake_data = c.server.stats().predicted_data;
+      const uint64_t handshake_acks = c.client.stats().predicted_acks;
+      c.send( string( 2 * TCPConfig::MAX_PAYLOAD_SIZE, 'x' ) );
+      c.deliver_to_server();
+      c.deliver_to_server();
+      expect( c.server.stats().predicted_data == handshake_data + 2, "in-order segments predicted" );
+      c.deliver_to_client();
+      expect( c.client.stats().predicted_acks == handshake_acks + 1, "bare acknowledgment predicted" );
+
+      c.send( "abc" );
+      c.send( "def" );
+      const TCPMessage first = c.to_server.front();
+      c.to_server.pop_front();
+      c.deliver_to_server();
+      c.server.receive( first, c.to_client_fn() );
+      expect( c.server.stats().predicted_data == handshake_data + 2, "reordered segments not predicted" );
+      expect( c.server.inbound_reader().bytes_buffered() == 2 * TCPConfig::MAX_PAYLOAD_SIZE + 6, "all received" );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,75 @@
+#include "tcp_peer_test_harness.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    {
+      // an acknowledgment rides on the reply, if there is one to send
+      Connection c { Connection::eager() };
+      c.server.outbound_writer().push( "response" );
+      c.send( "request" );
+      c.deliver_to_server();
+      expect( c.to_client.size() == 1, "one segment in reply" );
+      expect( c.to_client.front().sender.payload == "response", "reply carries data" );
+      expect( c.to_client.front().receiver.ackno.has_value(), "reply carries the acknowledgment" );
+    }
+
+    {
+      // with nothing to send in reply, the acknowledgment goes out on its own
+      Connection c { Connection::eager() };
+      c.send( "request" );
+      c.deliver_to_server();
+      expect( c.to_client.size() == 1, "one segment in reply" );
+      expect( c.to_client.front().sender.sequence_length() == 0, "standalone acknowledgment" );
+      expect( c.to_client.front().receiver.ackno == c.server.receiver().send().ackno, "of the request" );
+    }
+
+    {
+      // with the peer's window closed, the reply cannot carry the acknowledgment, so it goes out on its own
+      TCPConfig small = Connection::eager();
+      small.recv_capacity = TCPConfig::MAX_PAYLOAD_SIZE;
+      Connection c { small };
+      c.server.outbound_writer().push( string( TCPConfig::MAX_PAYLOAD_SIZE, 'x' ) );
+      c.server.push( c.to_client_fn() );
+      c.deliver_to_client();
+      c.deliver_to_server();
+      c.server.outbound_writer().push( "response" );
+      c.server.push( c.to_client_fn() );
+      expect( c.to_client.size() == 1 and c.to_client.front().sender.payload.size() == 1, "window probed" );
+      c.to_client.clear();
+
+      c.send( "request" );
+      c.deliver_to_server();
+      expect( c.to_client.size() == 1, "one segment in reply" );
+      expect( c.to_client.front().sender.sequence_length() == 0, "standalone acknowledgment" );
+      expect( c.to_client.front().receiver.ackno == c.server.receiver().send().ackno, "of the request" );
+    }
+
+    {
+      // a delayed acknowledgment that has ridden on data is not sent again when its timer would have expired
+      Connection c { Connection::delayed() };
+      c.send( "request" );
+      c.deliver_to_server();
+      expect( c.to_client.empty(), "acknowledgment delayed" );
+      c.server.outbound_writer().push( "response" );
+      c.server.push( c.to_client_fn() );
+      expect( c.to_client.size() == 1, "one segment in reply" );
+      expect( c.to_client.front().sender.payload == "response", "reply carries data" );
+      expect( c.to_client.front().receiver.ackno == c.server.receiver().send().ackno, "and the acknowledgment" );
+      c.server.tick( Connection::delayed().ack_delay_ms, c.to_client_fn() );
+      expect( c.to_client.size() == 1, "delayed-ack timer cancelled" );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,159 @@
+#include "tcp_over_ip.hh"
+#include "tcp_receiver.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <random>
+
+using namespace std;
+using namespace std::chrono;
+
+// Every copy of a segment's payload on the receive path lands in a freshly allocated string, so the
+// bytes allocated in payload-sized blocks are a count of the payload bytes copied.
+namespace {
+size_t copy_threshold = SIZE_MAX;
+size_t bytes_copied = 0;
+} // namespace
+
+void* operator new( const size_t size )
+{
+  if ( size >= copy_threshold ) {
+    bytes_copied += size;
+  }
+  if ( void* ptr = malloc( size ) ) { // NOLINT(*-no-malloc, *-owning-memory)
+    return ptr;
+  }
+  throw bad_alloc {};
+}
+
+void operator delete( void* ptr ) noexcept
+{
+  free( ptr ); // NOLINT(*-no-malloc, *-owning-memory)
+}
+
+void operator delete( void* ptr, const size_t size [[maybe_unused]] ) noexcept
+{
+  free( ptr ); // NOLINT(*-no-malloc, *-owning-memory)
+}
+
+struct Result
+{
+  double gigabits_per_second;
+  double copies_per_byte;
+};
+
+template<class Unwrap>
+Result run( const string& name, const vector<string>& datagrams, const string& data, Unwrap&& unwrap )
+{
+  TCPReceiver receiver { Reassembler { ByteStream { data.size() } } };
+  string output_data;
+  output_data.reserve( data.size() );
+
+  copy_threshold = TCPConfig::MAX_PAYLOAD_SIZE;
+  bytes_copied = 0;
+
+  const auto start_time = steady_clock::now();
+  for ( const auto& dgram : datagrams ) {
+    auto msg = unwrap( dgram );
+    if ( not msg.has_value() ) {
+      throw runtime_error( name + ": failed to unwrap datagram" );
+    }
+    receiver.receive( std::move( msg->sender ) );
+  }
+  const auto stop_time = steady_clock::now();
+
+  copy_threshold = SIZE_MAX;
+  const size_t copied = bytes_copied;
+
+  while ( receiver.reader().bytes_buffered() ) {
+    output_data += receiver.reader().peek();
+    receiver.reader().pop( receiver.reader().peek().size() );
+  }
+  if ( data != output_data ) {
+    throw runtime_error( name + ": mismatch between data sent and received" );
+  }
+
+  auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+  auto gigabits_per_second = 8 * static_cast<double>( data.size() ) / test_duration.count() / 1e9;
+  auto copies_per_byte = static_cast<double>( copied ) / static_cast<double>( data.size() );
+
+  cout << "Receive path (" << name << ") reached " << fixed << setprecision( 2 ) << gigabits_per_second
+       << " Gbit/s, copying each payload byte " << copies_per_byte << " times.\n";
+
+  return { gigabits_per_second, copies_per_byte };
+}
+
+void program_body()
+{
+  constexpr size_t input_len = 1e7;
+  const string data = [] {
+    default_random_engine rd { 1234 };
+    uniform_int_distribution<char> ud;
+    string ret;
+    for ( size_t i = 0; i < input_len; ++i ) {
+      ret += ud( rd );
+    }
+    return ret;
+  }();
+
+  // Serialize the stream as the datagrams a tun device would hand us
+  TCPOverIPv4Adapter sender;
+  sender.config_mut().source = IPv4Endpoint { Address { "10.0.0.2", 80 } };
+  sender.config_mut().destination = IPv4Endpoint { Address { "10.0.0.1", 1234 } };
+
+  vector<string> datagrams;
+  const Wrap32 isn { 98765 };
+  TCPMessage msg;
+  msg.sender.seqno = isn;
+  msg.sender.SYN = true;
+  for ( size_t i = 0; i < data.size(); i += TCPConfig::MAX_PAYLOAD_SIZE ) {
+    msg.sender.payload = data.substr( i, TCPConfig::MAX_PAYLOAD_SIZE );
+    PacketBuffer packet { TCPOverIPv4Adapter::HEADROOM, msg.sender.payload.size() };
+    sender.wrap_tcp_in_ip( msg, packet );
+    datagrams.emplace_back( packet.view() );
+    msg.sender.seqno = isn + 1 + i + msg.sender.payload.size();
+    msg.sender.SYN = false;
+  }
+
+  TCPOverIPv4Adapter receiver;
+  receiver.config_mut().source = IPv4Endpoint { Address { "10.0.0.1", 1234 } };
+  receiver.config_mut().destination = IPv4Endpoint { Address { "10.0.0.2", 80 } };
+
+  run( "via InternetDatagram", datagrams, data, [&]( const string& dgram ) -> optional<TCPMessage> {
+    InternetDatagram ip_dgram;
+    if ( not parse( ip_dgram, dgram ) ) {
+      return {};
+    }
+    return receiver.unwrap_tcp_in_ip( ip_dgram );
+  } );
+
+  const auto direct = run( "direct", datagrams, data, [&]( const string& dgram ) {
+    return receiver.unwrap_tcp_in_ip( string_view { dgram } );
+  } );
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+  debug_output << "         Receive path throughput: " << fixed << setprecision( 2 ) << direct.gigabits_per_second
+               << " Gbit/s\n";
+
+  if ( direct.copies_per_byte > 1.01 ) {
+    throw runtime_error( "Receive path copied the payload more than once." );
+  }
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -4,6 +4,7 @@
 #include <cstdint>
 #include <cstdlib>
 #include <iostream>
+#include <optional>
 #include <stdexcept>
 #include <string>
 
@@ -42,6 +43,27 @@ int main()
       test.execute( IsClosed { false } );
     }
 
+    /* timestamps are echoed, and PAWS drops old duplicates */
+    {
+      const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
+      TCPReceiverTestHarness test { "timestamps and PAWS", 4000 };
+      test.execute( ExpectTSecr { nullopt } );
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ).with_tsval( 100 ) );
+      test.execute( ExpectTSecr { 100 } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( "a" ).with_tsval( 200 ) );
+      test.execute( ExpectAckno { Wrap32 { isn + 2 } } );
+      test.execute( ExpectTSecr { 200 } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 3 ).with_data( "c" ).with_tsval( 300 ) );
+      test.execute( ExpectTSecr { 200 } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 2 ).with_data( "b" ).with_tsval( 150 ) );
+      test.execute( ExpectAckno { Wrap32 { isn + 2 } } );
+      test.execute( BytesPushed { 1 } );
+      test.execute( SegmentArrives {}.with_seqno( isn + 2 ).with_data( "b" ).with_tsval( 250 ) );
+      test.execute( ExpectAckno { Wrap32 { isn + 4 } } );
+      test.execute( ExpectTSecr { 250 } );
+      test.execute( ReadAll { "abc" } );
+    }
+
     /* empty segment */
     {
       const uint32_t isn = uniform_int_distribution<uint32_t> { 0, UINT32_MAX }( rd );
@@ -0,0 +1,52 @@
+#include "tcp_peer_test_harness.hh"
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    {
+      // a closed window is advertised again once the application has read a segment's worth
+      TCPConfig small = Connection::eager();
+      small.recv_capacity = 2 * TCPConfig::MAX_PAYLOAD_SIZE;
+      Connection c { small };
+      c.send( string( 2 * TCPConfig::MAX_PAYLOAD_SIZE, 'x' ) );
+      c.deliver_to_server();
+      c.deliver_to_server();
+      expect( c.to_client.size() == 2 and c.to_client.back().receiver.window_size == 0, "window closed" );
+      c.to_client.clear();
+      c.server.inbound_reader().pop( TCPConfig::MAX_PAYLOAD_SIZE - 1 );
+      c.server.update_window( c.to_client_fn() );
+      expect( c.to_client.empty(), "less than a segment not advertised" );
+      c.server.inbound_reader().pop( 1 );
+      c.server.update_window( c.to_client_fn() );
+      expect( c.to_client.size() == 1, "window update sent" );
+      expect( c.to_client.front().receiver.window_size == TCPConfig::MAX_PAYLOAD_SIZE, "window reopened" );
+      c.server.tick( 1, c.to_client_fn() );
+      expect( c.to_client.size() == 1, "window update sent once" );
+      expect( c.server.stats().window_updates == 1, "window update counted" );
+    }
+
+    {
+      // reading from a window that was never more than half closed sends nothing
+      Connection c { Connection::eager() };
+      c.send( string( 2 * TCPConfig::MAX_PAYLOAD_SIZE, 'x' ) );
+      c.deliver_to_server();
+      c.deliver_to_server();
+      c.to_client.clear();
+      c.server.inbound_reader().pop( 2 * TCPConfig::MAX_PAYLOAD_SIZE );
+      c.server.update_window( c.to_client_fn() );
+      expect( c.to_client.empty(), "no window update" );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -114,6 +114,7 @@ int main()
       TCPConfig cfg;
       const Wrap32 isn( rd() );
       cfg.isn = isn;
+      cfg.rack_tlp = false;
 
       TCPSenderTestHarness test { "FIN retx test", cfg };
       test.execute( Push {} );
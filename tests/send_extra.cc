@@ -22,6 +22,7 @@ int main()
       const size_t rto = uniform_int_distribution<uint16_t> { 30, 10000 }( rd );
       cfg.isn = isn;
       cfg.rt_timeout = rto;
+      cfg.rack_tlp = false;
 
       TCPSenderTestHarness test { "If already running, timer stays running when new segment sent", cfg };
       test.execute( Push {} );
@@ -46,6 +47,7 @@ int main()
       const size_t rto = uniform_int_distribution<uint16_t> { 30, 10000 }( rd );
       cfg.isn = isn;
       cfg.rt_timeout = rto;
+      cfg.rack_tlp = false;
 
       TCPSenderTestHarness test { "Retransmission still happens when expiration time not hit exactly", cfg };
       test.execute( Push {} );
@@ -70,6 +72,8 @@ int main()
       const size_t rto = uniform_int_distribution<uint16_t> { 30, 10000 }( rd );
       cfg.isn = isn;
       cfg.rt_timeout = rto;
+      cfg.rack_tlp = false;
+      cfg.adaptive_rto = false;
 
       TCPSenderTestHarness test { "Timer restarts on ACK of new data", cfg };
       test.execute( Push {} );
@@ -95,6 +99,7 @@ int main()
       const size_t rto = uniform_int_distribution<uint16_t> { 30, 10000 }( rd );
       cfg.isn = isn;
       cfg.rt_timeout = rto;
+      cfg.rack_tlp = false;
 
       TCPSenderTestHarness test { "Timer doesn't restart without ACK of new data", cfg };
       test.execute( Push {} );
@@ -124,6 +129,7 @@ int main()
       const size_t rto = uniform_int_distribution<uint16_t> { 30, 10000 }( rd );
       cfg.isn = isn;
       cfg.rt_timeout = rto;
+      cfg.rack_tlp = false;
 
       TCPSenderTestHarness test { "RTO resets on ACK of new data", cfg };
       test.execute( Push {} );
@@ -194,6 +200,7 @@ int main()
       const size_t rto = uniform_int_distribution<uint16_t> { 30, 10000 }( rd );
       cfg.isn = isn;
       cfg.rt_timeout = rto;
+      cfg.rack_tlp = false;
 
       TCPSenderTestHarness test { "Retransmit a FIN-containing segment same as any other", cfg };
       test.execute( Push {} );
@@ -217,6 +224,8 @@ int main()
       const size_t rto = uniform_int_distribution<uint16_t> { 30, 10000 }( rd );
       cfg.isn = isn;
       cfg.rt_timeout = rto;
+      cfg.rack_tlp = false;
+      cfg.adaptive_rto = false;
 
       TCPSenderTestHarness test { "Retransmit a FIN-only segment same as any other", cfg };
       test.execute( Push {} );
@@ -399,6 +408,7 @@ int main()
       const size_t rto = uniform_int_distribution<uint16_t> { 30, 10000 }( rd );
       cfg.isn = isn;
       cfg.rt_timeout = rto;
+      cfg.rack_tlp = false;
 
       TCPSenderTestHarness test { "Unlike a zero-size window, a full window of nonzero size should be respected",
                                   cfg };
@@ -444,6 +454,7 @@ int main()
       const size_t rto = uniform_int_distribution<uint16_t> { 30, 10000 }( rd );
       cfg.isn = isn;
       cfg.rt_timeout = rto;
+      cfg.rack_tlp = false;
 
       TCPSenderTestHarness test { "Repeated ACKs and outdated ACKs are harmless", cfg };
       test.execute( Push {} );
@@ -616,6 +627,7 @@ int main()
       const size_t rto = uniform_int_distribution<uint16_t> { 30, 10000 }( rd );
       cfg.isn = isn;
       cfg.rt_timeout = rto;
+      cfg.rack_tlp = false;
 
       TCPSenderTestHarness test { "When queue is empty, timer is stopped", cfg };
       test.execute( Push {} );
@@ -0,0 +1,110 @@
+#include "tcp_over_ip.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+
+using namespace std;
+using namespace std::chrono;
+
+string concat( const vector<string>& buffers )
+{
+  return accumulate( buffers.begin(), buffers.end(), string {} );
+}
+
+template<class Wrap>
+double run( const string& name, const vector<TCPMessage>& messages, const size_t input_len, Wrap&& wrap )
+{
+  size_t total = 0;
+  const auto start_time = steady_clock::now();
+  for ( const auto& msg : messages ) {
+    total += wrap( msg );
+  }
+  const auto stop_time = steady_clock::now();
+
+  if ( total < input_len ) {
+    throw runtime_error( name + ": datagrams shorter than their payloads" );
+  }
+
+  auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+  auto gigabits_per_second = 8 * static_cast<double>( input_len ) / test_duration.count() / 1e9;
+
+  cout << "Send path (" << name << ") reached " << fixed << setprecision( 2 ) << gigabits_per_second
+       << " Gbit/s.\n";
+
+  return gigabits_per_second;
+}
+
+void program_body()
+{
+  constexpr size_t input_len = 1e7;
+  const string data = [] {
+    default_random_engine rd { 4321 };
+    uniform_int_distribution<char> ud;
+    string ret;
+    for ( size_t i = 0; i < input_len; ++i ) {
+      ret += ud( rd );
+    }
+    return ret;
+  }();
+
+  // Odd-length payloads exercise the checksum's handling of a trailing byte
+  constexpr size_t payload_size = TCPConfig::MAX_PAYLOAD_SIZE - 1;
+  vector<TCPMessage> messages;
+  const Wrap32 isn { 13579 };
+  for ( size_t i = 0; i < data.size(); i += payload_size ) {
+    TCPMessage& msg = messages.emplace_back();
+    msg.sender.seqno = isn + i;
+    msg.sender.payload = data.substr( i, payload_size );
+    msg.receiver.ackno = Wrap32 { 24680 };
+    msg.receiver.window_size = 65000;
+  }
+
+  TCPOverIPv4Adapter adapter;
+  adapter.config_mut().source = IPv4Endpoint { Address { "10.0.0.1", 1234 } };
+  adapter.config_mut().destination = IPv4Endpoint { Address { "10.0.0.2", 80 } };
+
+  // The two paths must produce identical datagrams
+  for ( const auto& msg : messages ) {
+    PacketBuffer packet { TCPOverIPv4Adapter::HEADROOM, msg.sender.payload.size() };
+    adapter.wrap_tcp_in_ip( msg, packet );
+    if ( concat( serialize( adapter.wrap_tcp_in_ip( msg ) ) ) != packet.view() ) {
+      throw runtime_error( "PacketBuffer datagram differs from InternetDatagram serialization" );
+    }
+  }
+
+  run( "via InternetDatagram", messages, input_len, [&]( const TCPMessage& msg ) {
+    return concat( serialize( adapter.wrap_tcp_in_ip( msg ) ) ).size();
+  } );
+
+  string storage( TCPOverIPv4Adapter::HEADROOM + payload_size, 0 );
+  const auto fused = run( "fused copy and checksum", messages, input_len, [&]( const TCPMessage& msg ) {
+    PacketBuffer packet { storage, TCPOverIPv4Adapter::HEADROOM };
+    adapter.wrap_tcp_in_ip( msg, packet );
+    return packet.size();
+  } );
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+  debug_output << "            Send path throughput: " << fixed << setprecision( 2 ) << fused << " Gbit/s\n";
+
+  if ( fused < 0.1 ) {
+    throw runtime_error( "Send path did not meet minimum speed of 0.1 Gbit/s." );
+  }
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,131 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "NoDelay sends small segments right away", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( AckReceived { isn + 1 } );
+      test.execute( Push { "a" } );
+      test.execute( ExpectMessage {}.with_data( "a" ) );
+      test.execute( Push { "b" } );
+      test.execute( ExpectMessage {}.with_data( "b" ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.send_policy = TCPConfig::SendPolicy::Nagle;
+      cfg.rack_tlp = false;
+
+      TCPSenderTestHarness test { "Nagle holds small segments until the ack", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( AckReceived { isn + 1 } );
+      test.execute( Push { "a" } );
+      test.execute( ExpectMessage {}.with_data( "a" ) );
+      test.execute( Push { "b" } );
+      test.execute( Push { "c" } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 500 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { isn + 2 } );
+      test.execute( ExpectMessage {}.with_data( "bc" ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.send_policy = TCPConfig::SendPolicy::Nagle;
+
+      TCPSenderTestHarness test { "Nagle sends full segments, and holds the rest", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( AckReceived { isn + 1 }.with_win( 4000 ) );
+      test.execute( Push { "a" } );
+      test.execute( ExpectMessage {}.with_data( "a" ) );
+      test.execute( Push { string( TCPConfig::MAX_PAYLOAD_SIZE + 10, 'x' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( TCPConfig::MAX_PAYLOAD_SIZE ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSeqnosInFlight { 1 + TCPConfig::MAX_PAYLOAD_SIZE } );
+      test.execute( AckReceived { isn + 2 + TCPConfig::MAX_PAYLOAD_SIZE }.with_win( 4000 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 10 ) );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.send_policy = TCPConfig::SendPolicy::Nagle;
+
+      TCPSenderTestHarness test { "Nagle sends flushed data and FIN right away", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( AckReceived { isn + 1 } );
+      test.execute( Push { "a" } );
+      test.execute( ExpectMessage {}.with_data( "a" ) );
+      test.execute( Push { "b" } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Push { "c" }.with_flush() );
+      test.execute( ExpectMessage {}.with_data( "bc" ) );
+      test.execute( Push { "d" } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Push { "e" }.with_close() );
+      test.execute( ExpectMessage {}.with_data( "de" ).with_fin( true ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.send_policy = TCPConfig::SendPolicy::AutoCork;
+      cfg.cork_ms = 10;
+
+      TCPSenderTestHarness test { "AutoCork holds small segments for at most cork_ms", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( AckReceived { isn + 1 } );
+      test.execute( Push { "a" } );
+      test.execute( ExpectMessage {}.with_data( "a" ) );
+      test.execute( Push { "b" } );
+      test.execute( Tick { 6 } );
+      test.execute( Push { "c" } );
+      test.execute( Tick { 3 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_data( "bc" ) );
+      test.execute( Push { "d" } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { isn + 4 } );
+      test.execute( ExpectMessage {}.with_data( "d" ) );
+      test.execute( ExpectNoSegment {} );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
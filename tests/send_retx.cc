@@ -80,6 +80,7 @@ int main()
       const uint16_t retx_timeout = uniform_int_distribution<uint16_t> { 10, 10000 }( rd );
       cfg.isn = isn;
       cfg.rt_timeout = retx_timeout;
+      cfg.rack_tlp = false;
 
       TCPSenderTestHarness test { "Send some data, the retx and succeed, then retx till limit", cfg };
       test.execute( Push {} );
@@ -120,6 +121,7 @@ int main()
       const uint16_t retx_timeout = uniform_int_distribution<uint16_t> { 10, 10000 }( rd );
       cfg.isn = isn;
       cfg.rt_timeout = retx_timeout;
+      cfg.rack_tlp = false;
 
       // test that lowest seqno is sent on consecutive resends
       TCPSenderTestHarness test { "Retx after multiple sends, retx earliest packet", cfg };
@@ -0,0 +1,259 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 1000;
+      cfg.rack_tlp = false;
+
+      TCPSenderTestHarness test { "SRTT follows RFC 6298 and ignores retransmitted segments", cfg };
+      test.execute( ExpectSmoothedRTT { nullopt } );
+      test.execute( ExpectRTO { 1000 } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_seqno( isn ) );
+      test.execute( Tick { 100 } );
+      test.execute( AckReceived { isn + 1 } );
+      test.execute( ExpectSmoothedRTT { 100.0 } );
+
+      test.execute( Push { "abc" } );
+      test.execute( ExpectMessage {}.with_data( "abc" ) );
+      test.execute( Tick { 60 } );
+      test.execute( AckReceived { isn + 4 } );
+      test.execute( ExpectSmoothedRTT { 95.0 } ); // 100 + (60 - 100) / 8
+
+      test.execute( Push { "def" } );
+      test.execute( ExpectMessage {}.with_data( "def" ) );
+      test.execute( Tick { 1000 } );
+      test.execute( ExpectMessage {}.with_data( "def" ) );
+      test.execute( ExpectRTO { 2000 } );
+      test.execute( Tick { 10 } );
+      test.execute( AckReceived { isn + 7 } );
+      test.execute( ExpectSmoothedRTT { 95.0 } );
+      test.execute( ExpectRetransmissions { 1 } );
+      test.execute( ExpectTimeouts { 1 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 100;
+      cfg.rack_tlp = false;
+
+      TCPSenderTestHarness test { "The RTO follows SRTT and RTTVAR (RFC 6298)", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_seqno( isn ) );
+      test.execute( Tick { 60 } );
+      test.execute( Receive { { isn + 1, DEFAULT_TEST_WINDOW, false, 0 } } );
+      test.execute( ExpectRTO { 180 } ); // 60 + 4 * 30
+
+      test.execute( Push { "abc" } );
+      test.execute( ExpectMessage {}.with_data( "abc" ) );
+      test.execute( Tick { 30 } );
+      test.execute( Receive { { isn + 4, DEFAULT_TEST_WINDOW, false, 60 } } );
+      test.execute( ExpectSmoothedRTT { 56.25 } );
+      test.execute( ExpectRTO { 177 } ); // 56.25 + 4 * (30 * 3 / 4 + (60 - 30) / 4), rounded up
+
+      test.execute( Push { "def" } );
+      test.execute( ExpectMessage {}.with_data( "def" ) );
+      test.execute( Tick { 176 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_data( "def" ) );
+      test.execute( ExpectRTO { 354 } );
+      test.execute( Tick { 2 } );
+      test.execute( Receive { { isn + 7, DEFAULT_TEST_WINDOW, false, 267 } } );
+
+      // samples far shorter than the initial RTO do not take the timer below it
+      for ( uint32_t now = 269; now < 289; now++ ) {
+        test.execute( Push { "g" } );
+        test.execute( ExpectMessage {}.with_data( "g" ) );
+        test.execute( Tick { 1 } );
+        test.execute( Receive { { isn + 7 + ( now - 268 ), DEFAULT_TEST_WINDOW, false, now } } );
+      }
+      test.execute( ExpectRTO { 100 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 1000;
+
+      TCPSenderTestHarness test { "Echoed timestamps time retransmitted segments too", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_seqno( isn ) );
+      test.execute( Tick { 100 } );
+      test.execute( Receive { { isn + 1, DEFAULT_TEST_WINDOW, false, 0 } } );
+      test.execute( ExpectSmoothedRTT { 100.0 } );
+
+      test.execute( Push { "abc" } );
+      test.execute( ExpectMessage {}.with_data( "abc" ) );
+      test.execute( Tick { 1000 } );
+      test.execute( ExpectMessage {}.with_data( "abc" ) ); // stamped 1100
+      test.execute( Tick { 20 } );
+      test.execute( Receive { { isn + 4, DEFAULT_TEST_WINDOW, false, 1100 } } );
+      test.execute( ExpectSmoothedRTT { 90.0 } ); // 100 + (20 - 100) / 8
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 1000;
+
+      TCPSenderTestHarness test { "An echo of the original timestamp undoes a timeout (Eifel)", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Tick { 100 } );
+      test.execute( Receive { { isn + 1, DEFAULT_TEST_WINDOW, false, 0 } } );
+
+      test.execute( Push { "abc" } );
+      test.execute( ExpectMessage {}.with_data( "abc" ) ); // stamped 100
+      test.execute( Tick { 1000 } );
+      test.execute( ExpectMessage {}.with_data( "abc" ) ); // stamped 1100
+      test.execute( ExpectRTO { 2000 } );
+      test.execute( ExpectConsecutiveRetransmissions { 1 } );
+      test.execute( Tick { 10 } );
+      test.execute( Receive { { isn + 2, DEFAULT_TEST_WINDOW, false, 100 } } );
+      test.execute( ExpectSpuriousTimeouts { 1 } );
+      test.execute( ExpectRTO { 1000 } );
+      test.execute( ExpectConsecutiveRetransmissions { 0 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 1000;
+
+      TCPSenderTestHarness test { "An echo of the retransmission's timestamp keeps the backoff", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Tick { 100 } );
+      test.execute( Receive { { isn + 1, DEFAULT_TEST_WINDOW, false, 0 } } );
+
+      test.execute( Push { "abc" } );
+      test.execute( ExpectMessage {}.with_data( "abc" ) );
+      test.execute( Tick { 1000 } );
+      test.execute( ExpectMessage {}.with_data( "abc" ) );
+      test.execute( Tick { 10 } );
+      test.execute( Receive { { isn + 2, DEFAULT_TEST_WINDOW, false, 1100 } } );
+      test.execute( ExpectSpuriousTimeouts { 0 } );
+      test.execute( ExpectRTO { 2000 } );
+      test.execute( ExpectConsecutiveRetransmissions { 1 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.timestamps = false;
+      cfg.rack_tlp = false;
+
+      TCPSenderTestHarness test { "Two acks of new data after a timeout make it spurious (F-RTO)", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Tick { 100 } );
+      test.execute( AckReceived { isn + 1 } );
+
+      test.execute( Push { "abc" } );
+      test.execute( ExpectMessage {}.with_data( "abc" ) );
+      test.execute( Push { "def" } );
+      test.execute( ExpectMessage {}.with_data( "def" ) );
+      test.execute( Tick { 1000 } );
+      test.execute( ExpectMessage {}.with_data( "abc" ) );
+      test.execute( AckReceived { isn + 4 } );
+      test.execute( Push { "ghi" } );
+      test.execute( ExpectMessage {}.with_data( "ghi" ) );
+      test.execute( AckReceived { isn + 7 } );
+      test.execute( ExpectSpuriousTimeouts { 1 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.timestamps = false;
+      cfg.rack_tlp = false;
+
+      TCPSenderTestHarness test { "An ack of the whole flight after a timeout proves nothing (F-RTO)", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( Tick { 100 } );
+      test.execute( AckReceived { isn + 1 } );
+
+      test.execute( Push { "abc" } );
+      test.execute( ExpectMessage {}.with_data( "abc" ) );
+      test.execute( Push { "def" } );
+      test.execute( ExpectMessage {}.with_data( "def" ) );
+      test.execute( Tick { 1000 } );
+      test.execute( ExpectMessage {}.with_data( "abc" ) );
+      test.execute( AckReceived { isn + 7 } );
+      test.execute( Push { "ghi" } );
+      test.execute( ExpectMessage {}.with_data( "ghi" ) );
+      test.execute( AckReceived { isn + 10 } );
+      test.execute( ExpectSpuriousTimeouts { 0 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rack_tlp = false;
+
+      TCPSenderTestHarness test { "Duplicate acks are counted", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( AckReceived { isn + 1 }.with_win( 1000 ) );
+      test.execute( Push { "abc" } );
+      test.execute( ExpectMessage {}.with_data( "abc" ) );
+      test.execute( Push { "def" } );
+      test.execute( ExpectMessage {}.with_data( "def" ) );
+      test.execute( AckReceived { isn + 1 }.with_win( 1000 ) );
+      test.execute( AckReceived { isn + 1 }.with_win( 1000 ) );
+      test.execute( ExpectDuplicateAcks { 2 } );
+      test.execute( AckReceived { isn + 1 }.with_win( 900 ) ); // a window update is not a duplicate
+      test.execute( ExpectDuplicateAcks { 2 } );
+      test.execute( AckReceived { isn + 7 }.with_win( 900 ) );
+      test.execute( AckReceived { isn + 7 }.with_win( 900 ) ); // nothing outstanding
+      test.execute( ExpectDuplicateAcks { 2 } );
+      test.execute( ExpectRetransmissions { 0 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "Time with a zero window is counted", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( AckReceived { isn + 1 }.with_win( 0 ) );
+      test.execute( Tick { 250 } );
+      test.execute( AckReceived { isn + 1 }.with_win( 10 ) );
+      test.execute( Tick { 250 } );
+      test.execute( ExpectZeroWindowTime { 250 } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
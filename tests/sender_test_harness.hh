@@ -80,6 +80,62 @@ struct ExpectConsecutiveRetransmissions : public ExpectNumber<SenderAndOutput, u
   uint64_t value( SenderAndOutput& ss ) const override { return ss.sender.consecutive_retransmissions(); }
 };
 
+struct ExpectRetransmissions : public ExpectNumber<SenderAndOutput, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "retransmissions"; }
+  uint64_t value( SenderAndOutput& ss ) const override { return ss.sender.retransmissions(); }
+};
+
+struct ExpectTimeouts : public ExpectNumber<SenderAndOutput, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "timeouts"; }
+  uint64_t value( SenderAndOutput& ss ) const override { return ss.sender.timeouts(); }
+};
+
+struct ExpectSpuriousTimeouts : public ExpectNumber<SenderAndOutput, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "spurious_timeouts"; }
+  uint64_t value( SenderAndOutput& ss ) const override { return ss.sender.spurious_timeouts(); }
+};
+
+struct ExpectDuplicateAcks : public ExpectNumber<SenderAndOutput, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "duplicate_acks"; }
+  uint64_t value( SenderAndOutput& ss ) const override { return ss.sender.duplicate_acks(); }
+};
+
+struct ExpectLossProbes : public ExpectNumber<SenderAndOutput, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "loss_probes"; }
+  uint64_t value( SenderAndOutput& ss ) const override { return ss.sender.loss_probes(); }
+};
+
+struct ExpectRTO : public ExpectNumber<SenderAndOutput, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "current_RTO_ms"; }
+  uint64_t value( SenderAndOutput& ss ) const override { return ss.sender.current_RTO_ms(); }
+};
+
+struct ExpectSmoothedRTT : public ExpectNumber<SenderAndOutput, std::optional<double>>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "smoothed_RTT_ms"; }
+  std::optional<double> value( SenderAndOutput& ss ) const override { return ss.sender.smoothed_RTT_ms(); }
+};
+
+struct ExpectZeroWindowTime : public ExpectNumber<SenderAndOutput, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "zero_window_ms"; }
+  uint64_t value( SenderAndOutput& ss ) const override { return ss.sender.zero_window_ms(); }
+};
+
 struct ExpectNoSegment : public Expectation<SenderAndOutput>
 {
   std::string description() const override { return "nothing to send"; }
@@ -108,6 +164,7 @@ struct Push : public Action<SenderAndOutput>
 {
   std::string data_;
   bool close_ {};
+  bool flush_ {};
 
   explicit Push( std::string data = "" ) : data_( move( data ) ) {}
   std::string description() const override
@@ -121,7 +178,7 @@ struct Push : public Action<SenderAndOutput>
     }
 
     return "push \"" + Printer::prettify( data_ ) + "\" to stream" + ( close_ ? ", close it" : "" )
-           + ", then push to TCPSender";
+           + ( flush_ ? ", flush it" : "" ) + ", then push to TCPSender";
   }
   void execute( SenderAndOutput& ss ) const override
   {
@@ -131,6 +188,9 @@ struct Push : public Action<SenderAndOutput>
     if ( close_ ) {
       ss.sender.writer().close();
     }
+    if ( flush_ ) {
+      ss.sender.writer().flush();
+    }
     ss.sender.push( ss.make_transmit() );
   }
 
@@ -139,6 +199,12 @@ struct Push : public Action<SenderAndOutput>
     close_ = true;
     return *this;
   }
+
+  Push& with_flush()
+  {
+    flush_ = true;
+    return *this;
+  }
 };
 
 struct Tick : public Action<SenderAndOutput>
@@ -356,9 +422,9 @@ struct ExpectMessage : public Expectation<SenderAndOutput>
 class TCPSenderTestHarness : public TestHarness<SenderAndOutput>
 {
 public:
-  TCPSenderTestHarness( std::string name, TCPConfig config )
+  TCPSenderTestHarness( std::string name, const TCPConfig& config )
     : TestHarness( move( name ),
                    "initial_RTO_ms=" + to_string( config.rt_timeout ),
-                   { TCPSender { ByteStream { config.send_capacity }, config.isn, config.rt_timeout } } )
+                   { TCPSender { ByteStream { config.send_capacity }, config } } )
   {}
 };
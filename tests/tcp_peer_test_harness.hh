@@ -0,0 +1,79 @@
+#pragma once
+
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+
+#include <deque>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+inline void expect( const bool condition, const std::string& what )
+{
+  if ( not condition ) {
+    throw std::runtime_error( "Expectation failed: " + what );
+  }
+}
+
+// A client and a server, with the segments each has sent waiting to be delivered (or dropped)
+struct Connection
+{
+  TCPPeer client;
+  TCPPeer server;
+  std::deque<TCPMessage> to_server {};
+  std::deque<TCPMessage> to_client {};
+
+  // The default config, which delays acknowledgments by up to ack_delay_ms
+  static TCPConfig delayed() { return {}; }
+
+  // A config that acknowledges every segment at once
+  static TCPConfig eager()
+  {
+    TCPConfig cfg;
+    cfg.ack_delay_ms = 0;
+    return cfg;
+  }
+
+  explicit Connection( const TCPConfig& cfg ) : client( cfg ), server( cfg )
+  {
+    client.push( to_server_fn() );
+    deliver_to_server();
+    server.push( to_client_fn() );
+    while ( not to_client.empty() ) {
+      deliver_to_client();
+    }
+    while ( not to_server.empty() ) {
+      deliver_to_server();
+    }
+    expect( to_client.empty() and client.has_ackno() and server.has_ackno(), "handshake complete" );
+  }
+
+  TCPPeer::TransmitFunction to_server_fn()
+  {
+    return [this]( TCPMessage msg ) { to_server.push_back( std::move( msg ) ); };
+  }
+  TCPPeer::TransmitFunction to_client_fn()
+  {
+    return [this]( TCPMessage msg ) { to_client.push_back( std::move( msg ) ); };
+  }
+
+  void deliver_to_server()
+  {
+    const TCPMessage msg = to_server.front();
+    to_server.pop_front();
+    server.receive( msg, to_client_fn() );
+  }
+
+  void deliver_to_client()
+  {
+    const TCPMessage msg = to_client.front();
+    to_client.pop_front();
+    client.receive( msg, to_server_fn() );
+  }
+
+  void send( const std::string& data )
+  {
+    client.outbound_writer().push( data );
+    client.push( to_server_fn() );
+  }
+};
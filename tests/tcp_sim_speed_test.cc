@@ -0,0 +1,188 @@
+#include "netsim_nodes.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+// client i is 10.1.i.2 behind router 1 (10.1.i.1), and server i is 10.2.i.2 behind router 2 (10.2.i.1)
+constexpr uint32_t ip( const uint32_t a, const uint32_t b, const uint32_t c, const uint32_t d )
+{
+  return a << 24 | b << 16 | c << 8 | d;
+}
+
+struct Scenario
+{
+  string name;
+  size_t flows;
+  uint64_t bytes_per_flow;
+  LinkConfig bottleneck; // between the two routers, in each direction
+  uint64_t seed;
+};
+
+struct Result
+{
+  bool finished;
+  uint64_t simulated_us;
+  uint64_t events;
+  uint64_t bytes_received;
+  uint64_t segments_sent;
+  uint64_t retransmissions;
+  uint64_t queue_drops;
+  uint64_t losses;
+  double rtt_p50, rtt_p90, rtt_p99;
+
+  double goodput_mbps() const
+  {
+    return simulated_us ? 8 * static_cast<double>( bytes_received ) / static_cast<double>( simulated_us ) : 0;
+  }
+
+  bool operator==( const Result& other ) const = default;
+};
+
+// A dumbbell: `flows` clients on one side of a bottleneck between two routers, each sending to its own server
+// on the other side over fast access links
+Result run( const Scenario& scenario )
+{
+  constexpr uint64_t time_limit_us = 3600'000'000;
+  const LinkConfig access { .rate_bits_per_s = 1'000'000'000, .delay_us = 100, .queue_bytes = 1 << 20, .loss = 0 };
+
+  Simulator sim { scenario.seed };
+  SimRouter left { sim };
+  SimRouter right { sim };
+
+  const size_t left_trunk = left.add_interface( "left trunk", ip( 10, 0, 0, 1 ), scenario.bottleneck );
+  const size_t right_trunk = right.add_interface( "right trunk", ip( 10, 0, 0, 2 ), scenario.bottleneck );
+  connect( left.attachment( left_trunk ), right.attachment( right_trunk ) );
+  left.router().add_route( ip( 10, 2, 0, 0 ), 16, Address::from_ipv4_numeric( ip( 10, 0, 0, 2 ) ), left_trunk );
+  right.router().add_route( ip( 10, 1, 0, 0 ), 16, Address::from_ipv4_numeric( ip( 10, 0, 0, 1 ) ), right_trunk );
+
+  vector<unique_ptr<SimHost>> clients;
+  vector<unique_ptr<SimHost>> servers;
+  for ( uint32_t i = 0; i < scenario.flows; i++ ) {
+    const IPv4Endpoint client { ip( 10, 1, i, 2 ), static_cast<uint16_t>( 40000 + i ) };
+    const IPv4Endpoint server { ip( 10, 2, i, 2 ), 80 };
+    TCPConfig tcp_config;
+    tcp_config.isn = Wrap32 { static_cast<uint32_t>( sim.rng()() ) };
+
+    const size_t left_port = left.add_interface( "left " + to_string( i ), ip( 10, 1, i, 1 ), access );
+    left.router().add_route( ip( 10, 1, i, 0 ), 24, {}, left_port );
+    clients.push_back( make_unique<SimHost>(
+      sim, "client " + to_string( i ), tcp_config, client, server, ip( 10, 1, i, 1 ), access ) );
+    connect( clients.back()->attachment(), left.attachment( left_port ) );
+
+    tcp_config.isn = Wrap32 { static_cast<uint32_t>( sim.rng()() ) };
+    const size_t right_port = right.add_interface( "right " + to_string( i ), ip( 10, 2, i, 1 ), access );
+    right.router().add_route( ip( 10, 2, i, 0 ), 24, {}, right_port );
+    servers.push_back( make_unique<SimHost>(
+      sim, "server " + to_string( i ), tcp_config, server, client, ip( 10, 2, i, 1 ), access ) );
+    connect( servers.back()->attachment(), right.attachment( right_port ) );
+
+    clients.back()->connect();
+    clients.back()->send( scenario.bytes_per_flow );
+    servers.back()->send( 0 );
+  }
+
+  const bool finished = sim.run_while(
+    [&] {
+      return any_of( servers.begin(), servers.end(), []( const auto& server ) { return not server->done(); } );
+    },
+    time_limit_us );
+
+  Result result {};
+  result.finished = finished;
+  result.simulated_us = sim.now_us();
+  result.events = sim.events_processed();
+  for ( size_t i = 0; i < scenario.flows; i++ ) {
+    result.bytes_received += servers[i]->stats().bytes_received;
+    result.segments_sent += clients[i]->stats().segments_sent;
+    result.retransmissions += clients[i]->stats().retransmissions;
+  }
+  for ( const auto& router : { &left, &right } ) {
+    for ( size_t i = 0; i <= scenario.flows; i++ ) {
+      result.queue_drops += router->attachment( i ).port->link().stats().queue_drops;
+      result.losses += router->attachment( i ).port->link().stats().losses;
+    }
+  }
+
+  // The RTT distribution over all flows
+  SampleSet rtt_ms;
+  for ( const auto& client : clients ) {
+    rtt_ms.add( client->stats().rtt_ms );
+  }
+  result.rtt_p50 = rtt_ms.percentile( 50 );
+  result.rtt_p90 = rtt_ms.percentile( 90 );
+  result.rtt_p99 = rtt_ms.percentile( 99 );
+  return result;
+}
+
+void program_body()
+{
+  const vector<Scenario> scenarios {
+    { "one flow, 10 Mbit/s, 20 ms RTT", 1, 100'000'000, { 10'000'000, 10'000, 128 * 1024, 0 }, 1 },
+    { "one flow, 1% loss", 1, 10'000'000, { 10'000'000, 10'000, 128 * 1024, 0.01 }, 2 },
+    { "four flows share a 32 kB queue", 4, 5'000'000, { 10'000'000, 10'000, 32 * 1024, 0 }, 3 },
+  };
+
+  double simulated_seconds = 0;
+  const auto start_time = steady_clock::now();
+
+  for ( const auto& scenario : scenarios ) {
+    const Result result = run( scenario );
+    simulated_seconds += static_cast<double>( result.simulated_us ) / 1e6;
+
+    if ( not result.finished ) {
+      throw runtime_error( scenario.name + ": transfer did not finish" );
+    }
+    if ( result.bytes_received != scenario.flows * scenario.bytes_per_flow ) {
+      throw runtime_error( scenario.name + ": wrong number of bytes received" );
+    }
+
+    cout << scenario.name << ": " << fixed << setprecision( 2 ) << result.goodput_mbps() << " Mbit/s over "
+         << static_cast<double>( result.simulated_us ) / 1e6 << " s, " << result.retransmissions << " of "
+         << result.segments_sent << " segments retransmitted, " << result.queue_drops << " queue drops, "
+         << result.losses << " losses, RTT p50/p90/p99 " << result.rtt_p50 << "/" << result.rtt_p90 << "/"
+         << result.rtt_p99 << " ms\n";
+  }
+
+  const auto wall_seconds = duration_cast<duration<double>>( steady_clock::now() - start_time ).count();
+  const double speedup = simulated_seconds / wall_seconds;
+  cout << "Simulated " << fixed << setprecision( 1 ) << simulated_seconds << " s in " << wall_seconds << " s ("
+       << speedup << "x real time).\n";
+
+  // The same seed must reproduce the same run, event for event
+  if ( run( scenarios.at( 1 ) ) != run( scenarios.at( 1 ) ) ) {
+    throw runtime_error( "Two runs with the same seed differed." );
+  }
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+  debug_output << "          Network simulator speed: " << fixed << setprecision( 1 ) << speedup
+               << "x real time\n";
+
+  if ( speedup < 10 ) {
+    throw runtime_error( "Network simulator did not meet minimum speed of 10x real time." );
+  }
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
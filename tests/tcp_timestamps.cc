@@ -0,0 +1,125 @@
+#include "parser.hh"
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+#include "tcp_peer_test_harness.hh"
+#include "tcp_segment.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// Connect a client and a server, and return the segments the server sent
+vector<TCPMessage> handshake( TCPPeer& client, TCPPeer& server )
+{
+  vector<TCPMessage> to_client;
+  vector<TCPMessage> to_server;
+  const auto client_sends = [&]( TCPMessage msg ) { to_server.push_back( std::move( msg ) ); };
+  const auto server_sends = [&]( TCPMessage msg ) { to_client.push_back( std::move( msg ) ); };
+
+  client.push( client_sends );
+  server.receive( to_server.at( 0 ), server_sends );
+  for ( const auto& msg : to_client ) {
+    client.receive( msg, client_sends );
+  }
+  client.outbound_writer().push( "hello" );
+  client.push( client_sends );
+  for ( size_t i = 1; i < to_server.size(); i++ ) {
+    server.receive( to_server[i], server_sends );
+  }
+  server.tick( TCPConfig {}.ack_delay_ms, server_sends );
+  return to_client;
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    {
+      // the option goes on the wire after the fixed header, and is read back
+      TCPSegment seg;
+      seg.message.sender = { .seqno = Wrap32 { 1000 }, .payload = "hi", .TSval = 7 };
+      seg.message.receiver = { .ackno = Wrap32 { 5 }, .window_size = 100, .TSecr = 9 };
+      seg.compute_checksum( 0 );
+      expect( seg.header_length() == TCPSegment::MAX_HEADER_LENGTH, "header with options" );
+
+      string wire;
+      for ( const auto& buffer : serialize( seg ) ) {
+        wire += buffer;
+      }
+      expect( wire.size() == TCPSegment::MAX_HEADER_LENGTH + 2, "segment length" );
+      expect( wire[12] == '\x80', "data offset of eight words" );
+      expect( wire.substr( 20, 4 ) == "\x01\x01\x08\x0a", "NOP, NOP, timestamps option" );
+
+      TCPSegment parsed;
+      expect( parse( parsed, wire, 0 ), "segment parses" );
+      expect( parsed.message.sender.TSval == 7 and parsed.message.receiver.TSecr == 9, "timestamps read back" );
+      expect( parsed.message.sender.payload == "hi", "payload after the options" );
+
+      PacketBuffer packet { TCPSegment::MAX_HEADER_LENGTH };
+      seg.serialize( packet, "hi", 0 );
+      expect( packet.view() == wire, "in-place serialization matches" );
+
+      TCPSegment plain;
+      plain.message.sender.payload = "hi";
+      plain.compute_checksum( 0 );
+      expect( plain.header_length() == TCPSegment::HEADER_LENGTH, "no options without a timestamp" );
+    }
+
+    {
+      // both SYNs offered timestamps, so every segment carries them
+      TCPPeer client { TCPConfig {} };
+      TCPPeer server { TCPConfig {} };
+      const auto sent = handshake( client, server );
+      expect( sent.front().sender.SYN and sent.front().sender.TSval.has_value(), "SYN/ACK stamped" );
+      expect( sent.back().sender.TSval.has_value() and sent.back().receiver.TSecr.has_value(), "ACK stamped" );
+      expect( client.inbound_reader().bytes_buffered() == 0 and server.inbound_reader().peek() == "hello",
+              "data delivered" );
+    }
+
+    {
+      // the client did not offer timestamps, so the server does not use them
+      TCPConfig without;
+      without.timestamps = false;
+      TCPPeer client { without };
+      TCPPeer server { TCPConfig {} };
+      const auto sent = handshake( client, server );
+      for ( const auto& msg : sent ) {
+        expect( not msg.sender.TSval.has_value() and not msg.receiver.TSecr.has_value(), "no timestamps" );
+      }
+      expect( server.inbound_reader().peek() == "hello", "data delivered" );
+    }
+
+    {
+      // PAWS drops an old duplicate whole: its data, and also its acknowledgment and window, which are as stale
+      Connection c { TCPConfig {} };
+      c.send( "a" );
+      TCPMessage old = c.to_server.front();
+      c.deliver_to_server();
+      c.client.tick( 10, c.to_server_fn() );
+      c.send( "b" );
+      c.deliver_to_server();
+      const uint64_t window = c.server.sender().peer_window();
+      c.to_client.clear();
+
+      old.receiver.window_size = 0;
+      c.server.receive( old, c.to_client_fn() );
+      expect( c.server.sender().peer_window() == window, "stale window ignored" );
+      expect( c.server.inbound_reader().bytes_buffered() == 2, "stale data ignored" );
+      expect( c.to_client.size() == 1 and c.to_client.front().sender.sequence_length() == 0,
+              "old duplicate acknowledged" );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
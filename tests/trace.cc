@@ -0,0 +1,125 @@
+#include "trace.hh"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+void expect( const bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( "Expectation failed: " + what );
+  }
+}
+
+// Record `count` events tagged `tag`, numbered from 0
+void record_numbered( const uint32_t tag, const uint64_t count )
+{
+  for ( uint64_t i = 0; i < count; i++ ) {
+    Trace::record( TraceEvent::Ack, tag, i );
+  }
+}
+
+// Dump and load back, returning each tag's records in the order loaded
+map<uint32_t, vector<TraceRecord>> dump_and_load( const filesystem::path& path )
+{
+  Trace::dump( path );
+  map<uint32_t, vector<TraceRecord>> by_tag;
+  for ( const auto& [thread, record] : Trace::load( path ) ) {
+    by_tag[record.a].push_back( record );
+  }
+  return by_tag;
+}
+
+// The records are numbered consecutively, up to `last` (if given), and in order of time
+void expect_consecutive( const vector<TraceRecord>& records, const optional<uint64_t> last, const string& what )
+{
+  expect( not records.empty(), what + ": records kept" );
+  for ( size_t i = 1; i < records.size(); i++ ) {
+    expect( records[i].b == records[i - 1].b + 1, what + ": records consecutive" );
+    expect( records[i].time_ns >= records[i - 1].time_ns, what + ": records in order of time" );
+  }
+  if ( last.has_value() ) {
+    expect( records.back().b == last.value(), what + ": newest record kept" );
+  }
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    if constexpr ( not MINNOW_TRACE ) {
+      return EXIT_SUCCESS;
+    }
+
+    const auto path = filesystem::temp_directory_path() / ( "minnow_trace_" + to_string( getpid() ) + ".trace" );
+    Trace::enable( true );
+
+    {
+      // two threads that wrap their rings keep their newest RING_SIZE records
+      constexpr uint64_t count = Trace::RING_SIZE + 1000;
+      thread first { record_numbered, 1, count };
+      thread second { record_numbered, 2, count };
+      first.join();
+      second.join();
+
+      const auto by_tag = dump_and_load( path );
+      for ( const uint32_t tag : { 1, 2 } ) {
+        const auto& records = by_tag.at( tag );
+        const string what = "thread " + to_string( tag );
+        expect( records.size() == Trace::RING_SIZE, what + ": a whole ring kept" );
+        expect( records.front().b == count - Trace::RING_SIZE, what + ": oldest records overwritten" );
+        expect_consecutive( records, count - 1, what );
+        expect( records.front().event == TraceEvent::Ack, what + ": event kept" );
+      }
+    }
+
+    {
+      // a dump taken while a thread writes leaves out the records overwritten during it, and nothing else
+      atomic<bool> stop { false };
+      thread writer { [&] {
+        for ( uint64_t i = 0; not stop.load( memory_order_relaxed ); i++ ) {
+          Trace::record( TraceEvent::Ack, 3, i );
+        }
+      } };
+      for ( int round = 0; round < 50; round++ ) {
+        const auto by_tag = dump_and_load( path );
+        if ( by_tag.contains( 3 ) ) {
+          expect( by_tag.at( 3 ).size() <= Trace::RING_SIZE, "at most a ring kept" );
+          expect_consecutive( by_tag.at( 3 ), {}, "thread writing during the dump" );
+        }
+      }
+      stop = true;
+      writer.join();
+    }
+
+    {
+      // tracing switched off records nothing
+      Trace::enable( false );
+      thread quiet { record_numbered, 4, 10 };
+      quiet.join();
+      expect( not dump_and_load( path ).contains( 4 ), "nothing recorded while off" );
+    }
+
+    filesystem::remove( path );
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
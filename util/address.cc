@@ -195,3 +195,23 @@ const sockaddr_type* Address::as() const
 template const sockaddr_in* Address::as<sockaddr_in>() const;
 template const sockaddr_in6* Address::as<sockaddr_in6>() const;
 template const sockaddr_ll* Address::as<sockaddr_ll>() const;
+
+IPv4Endpoint::IPv4Endpoint( const Address& address )
+  : ip( address.ipv4_numeric() ), port( be16toh( address.as<sockaddr_in>()->sin_port ) )
+{}
+
+Address IPv4Endpoint::to_address() const
+{
+  sockaddr_in ipv4_addr {};
+  ipv4_addr.sin_family = AF_INET;
+  ipv4_addr.sin_addr.s_addr = htobe32( ip );
+  ipv4_addr.sin_port = htobe16( port );
+
+  return { reinterpret_cast<sockaddr*>( &ipv4_addr ), sizeof( ipv4_addr ) }; // NOLINT(*-reinterpret-cast)
+}
+
+string IPv4Endpoint::to_string() const
+{
+  return ::to_string( ip >> 24 ) + "." + ::to_string( ( ip >> 16 ) & 0xffU ) + "."
+         + ::to_string( ( ip >> 8 ) & 0xffU ) + "." + ::to_string( ip & 0xffU ) + ":" + ::to_string( port );
+}
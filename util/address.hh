@@ -76,3 +76,26 @@ public:
 
   //!@}
 };
+
+//! \brief A numeric IPv4 address and port.
+//! \details Trivially copyable and compared as two integers, so it suits per-packet paths, where Address (whose
+//! accessors format the address with getnameinfo) is far too slow.
+struct IPv4Endpoint
+{
+  uint32_t ip {};   //!< IPv4 address, in [host byte order](\ref man3::byteorder)
+  uint16_t port {}; //!< Port number, in host byte order
+
+  IPv4Endpoint() = default;
+  IPv4Endpoint( const uint32_t ip_address, const uint16_t port_number ) : ip( ip_address ), port( port_number ) {}
+
+  //! Convert from an IPv4 Address (throws if `address` is not IPv4)
+  explicit IPv4Endpoint( const Address& address );
+
+  //! Convert to an Address
+  Address to_address() const;
+
+  //! Human-readable string, e.g., "8.8.8.8:53".
+  std::string to_string() const;
+
+  bool operator==( const IPv4Endpoint& other ) const = default;
+};
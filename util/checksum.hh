@@ -1,33 +1,77 @@
 #pragma once
 
 #include <cstdint>
+#include <cstring>
+#include <endian.h>
 #include <string>
+#include <string_view>
 #include <vector>
 
 //! The internet checksum algorithm
 class InternetChecksum
 {
 private:
-  uint32_t sum_;
+  uint64_t sum_;
   bool parity_ {};
 
-public:
-  explicit InternetChecksum( const uint32_t sum = 0 ) : sum_( sum ) {}
-  void add( std::string_view data )
+  // Sum `data` as big-endian 16-bit words, optionally copying it to `dst` in the same pass. The bulk of the
+  // data is summed eight bytes at a time in host byte order; the ones'-complement sum does not depend on
+  // byte order, so the folded result only needs converting back at the end (RFC 1071, section 2(B)).
+  template<bool copy>
+  void accumulate( std::string_view data, char* dst )
   {
-    for ( const uint8_t i : data ) {
-      uint16_t val = i;
+    const char* in = data.data();
+    size_t len = data.size();
+
+    // finish a 16-bit word begun by the previous call
+    if ( len > 0 and parity_ ) {
+      sum_ += static_cast<uint8_t>( *in );
+      if constexpr ( copy ) {
+        *dst++ = *in;
+      }
+      ++in;
+      --len;
+      parity_ = false;
+    }
+
+    uint64_t wide = 0;
+    for ( ; len >= sizeof( uint64_t ); len -= sizeof( uint64_t ), in += sizeof( uint64_t ) ) {
+      uint64_t word {};
+      memcpy( &word, in, sizeof( word ) );
+      if constexpr ( copy ) {
+        memcpy( dst, in, sizeof( word ) );
+        dst += sizeof( word );
+      }
+      wide += ( word & 0xffff'ffffU ) + ( word >> 32 );
+    }
+    while ( wide > 0xffff ) {
+      wide = ( wide >> 16 ) + static_cast<uint16_t>( wide );
+    }
+    sum_ += be16toh( static_cast<uint16_t>( wide ) );
+
+    for ( ; len > 0; --len, ++in ) {
+      uint16_t val = static_cast<uint8_t>( *in );
       if ( not parity_ ) {
         val <<= 8;
       }
       sum_ += val;
       parity_ = !parity_;
+      if constexpr ( copy ) {
+        *dst++ = *in;
+      }
     }
   }
 
+public:
+  explicit InternetChecksum( const uint32_t sum = 0 ) : sum_( sum ) {}
+  void add( std::string_view data ) { accumulate<false>( data, nullptr ); }
+
+  //! Copy `data` to `dst` (which must have room for all of it) and add it to the checksum, in one pass
+  void add_and_copy( std::string_view data, char* dst ) { accumulate<true>( data, dst ); }
+
   uint16_t value() const
   {
-    uint32_t ret = sum_;
+    uint64_t ret = sum_;
 
     while ( ret > 0xffff ) {
       ret = ( ret >> 16 ) + static_cast<uint16_t>( ret );
@@ -0,0 +1,214 @@
+#pragma once
+
+#include "file_descriptor.hh"
+#include "ipv4_header.hh"
+#include "packet_capture.hh"
+#include "random.hh"
+#include "tcp_config.hh"
+#include "tcp_segment.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <optional>
+#include <random>
+#include <utility>
+#include <vector>
+
+//! \brief An adapter class that emulates a wide-area link in front of an FD adapter
+//! \details Each datagram written passes through Gilbert-Elliott loss, then a token-bucket rate limiter with a
+//! finite queue, then a delay line with jitter, reordering and duplication, before it is written to the
+//! underlying adapter. Time advances only in tick(), and that is when datagrams held back by the rate limiter or
+//! the delay line go out.
+//!
+//! Only the outgoing direction is shaped. Incoming datagrams are read when the file descriptor becomes readable,
+//! and nothing would call read() again later to collect one that had been held back. To shape both directions,
+//! run an emulated adapter at each end of the connection.
+template<typename AdapterT>
+class EmulatedFdAdapter
+{
+public:
+  //! What the emulated link has done to the datagrams written to it
+  struct Stats
+  {
+    uint64_t sent {};        //!< Datagrams written to the underlying adapter (duplicates included)
+    uint64_t lost {};        //!< Datagrams dropped by the loss model
+    uint64_t queue_drops {}; //!< Datagrams dropped because the bottleneck queue was full
+    uint64_t reordered {};   //!< Datagrams that overtook the delay line
+    uint64_t duplicated {};  //!< Datagrams sent twice
+  };
+
+private:
+  //! The underlying FD adapter
+  AdapterT _adapter;
+
+  //! The emulated link's parameters
+  EmulationConfig _emulation;
+
+  //! RNG behind every random decision
+  std::default_random_engine _rand;
+
+  uint64_t _now_ms {};    //!< Time elapsed, as told by tick()
+  bool _bad_state {};     //!< Is the loss model in its bad (bursty) state?
+  uint64_t _tokens;       //!< Token-bucket fill, in thousandths of a byte so partial tokens carry over
+  size_t _queue_bytes {}; //!< Bytes waiting in the bottleneck queue
+  uint64_t _last_due {};  //!< Release time of the last in-order datagram in the delay line
+  Stats _stats {};        //!< Counters
+
+  std::deque<TCPMessage> _queue {};                   //!< Bottleneck queue, in arrival order
+  std::multimap<uint64_t, TCPMessage> _delay_line {}; //!< Datagrams in flight, by release time
+
+  bool _chance( const double probability )
+  {
+    return probability > 0 and std::uniform_real_distribution<double> { 0, 1 }( _rand ) < probability;
+  }
+
+  //! Bytes a datagram occupies on the link: its IPv4 and TCP headers (with the TCP options) and its payload
+  static size_t _wire_size( const TCPMessage& msg )
+  {
+    return IPv4Header::LENGTH + TCPSegment::header_length( msg ) + msg.sender.payload.size();
+  }
+
+  //! Step the Gilbert-Elliott chain and decide whether the current datagram is lost
+  bool _should_drop()
+  {
+    _bad_state = _bad_state ? not _chance( _emulation.bad_to_good ) : _chance( _emulation.good_to_bad );
+    return _chance( _bad_state ? _emulation.loss_bad : _emulation.loss_good );
+  }
+
+  //! Put a datagram that has crossed the bottleneck onto the delay line
+  void _propagate( TCPMessage&& msg )
+  {
+    uint64_t due = _now_ms + _emulation.delay_ms;
+    if ( _emulation.jitter_ms > 0 ) {
+      const uint64_t jitter = std::uniform_int_distribution<uint64_t> { 0, 2 * _emulation.jitter_ms }( _rand );
+      due = std::max( due + jitter, _now_ms + _emulation.jitter_ms ) - _emulation.jitter_ms;
+    }
+
+    if ( _chance( _emulation.reorder_probability ) ) {
+      due = _now_ms; // overtakes everything still on the delay line
+      _stats.reordered++;
+    } else {
+      due = std::max( due, _last_due ); // jitter on its own keeps datagrams in order
+      _last_due = due;
+    }
+
+    if ( _chance( _emulation.duplicate_probability ) ) {
+      _delay_line.emplace( due, msg );
+      _stats.duplicated++;
+    }
+    _delay_line.emplace( due, std::move( msg ) );
+  }
+
+  //! Move datagrams across the bottleneck as far as the tokens allow, then send whatever is due
+  void _service()
+  {
+    while ( not _queue.empty() ) {
+      const size_t size = _wire_size( _queue.front() );
+      if ( _emulation.rate_bytes_per_s > 0 ) {
+        if ( _tokens < size * 1000 ) {
+          break;
+        }
+        _tokens -= size * 1000;
+      }
+      _queue_bytes -= size;
+      _propagate( std::move( _queue.front() ) );
+      _queue.pop_front();
+    }
+
+    while ( not _delay_line.empty() and _delay_line.begin()->first <= _now_ms ) {
+      _adapter.write( _delay_line.begin()->second );
+      _delay_line.erase( _delay_line.begin() );
+      _stats.sent++;
+    }
+  }
+
+public:
+  //! Conversion to a FileDescriptor by returning the underlying AdapterT
+  FileDescriptor& fd() { return _adapter.fd(); }
+
+  //! Construct from the adapter to wrap and the link to emulate (by default, a perfect one)
+  explicit EmulatedFdAdapter( AdapterT&& adapter, const EmulationConfig& emulation = {} )
+    : _adapter( std::move( adapter ) )
+    , _emulation( emulation )
+    , _rand( emulation.seed ? std::default_random_engine( emulation.seed ) : get_random_engine() )
+    , _tokens( emulation.bucket_bytes * 1000 )
+  {}
+
+  //! \brief Read from the underlying AdapterT instance (incoming datagrams are not shaped)
+  std::optional<TCPMessage> read() { return _adapter.read(); }
+
+  //! \brief Read a batch from the underlying AdapterT instance (incoming datagrams are not shaped)
+  void read_batch( std::vector<TCPMessage>& segments, const size_t max_datagrams )
+  {
+    _adapter.read_batch( segments, max_datagrams );
+  }
+
+  //! \brief Send a datagram over the emulated link
+  //! \param[in] seg is the packet to send, drop, or hold back until a later tick()
+  void write( const TCPMessage& seg )
+  {
+    if ( _should_drop() ) {
+      _stats.lost++;
+      return;
+    }
+
+    const size_t size = _wire_size( seg );
+    if ( _emulation.rate_bytes_per_s > 0 and _queue_bytes + size > _emulation.queue_bytes ) {
+      _stats.queue_drops++;
+      return;
+    }
+
+    _queue.push_back( seg );
+    _queue_bytes += size;
+    _service();
+  }
+
+  //! Advance the emulated link's clock, sending the datagrams that become due
+  //! \details The clock advances a millisecond at a time, so datagrams leave the bottleneck at their own
+  //! departure times (and the bucket's depth limits bursts, not the rate) however coarse the ticks are.
+  void tick( const size_t ms_since_last_tick )
+  {
+    for ( size_t i = 0; i < ms_since_last_tick; i++ ) {
+      _now_ms++;
+
+      if ( _emulation.rate_bytes_per_s > 0 ) {
+        // the bucket always holds at least one datagram's worth, so an oversized datagram can't stall the queue
+        const size_t depth = std::max( _emulation.bucket_bytes, _queue.empty() ? 0 : _wire_size( _queue.front() ) );
+        _tokens = std::min( _tokens + _emulation.rate_bytes_per_s, uint64_t { depth } * 1000 );
+      }
+
+      _service();
+    }
+
+    _adapter.tick( ms_since_last_tick );
+  }
+
+  //! Access the underlying adapter
+  const AdapterT& adapter() const { return _adapter; }
+
+  //! What the emulated link has done so far
+  const Stats& emulation_stats() const { return _stats; }
+
+  //! Bytes held back by the emulated link (waiting for tokens or in flight)
+  size_t bytes_in_flight() const
+  {
+    size_t total = _queue_bytes;
+    for ( const auto& [due, msg] : _delay_line ) {
+      total += _wire_size( msg );
+    }
+    return total;
+  }
+
+  //! \name
+  //! Passthrough functions to the underlying AdapterT instance
+
+  void set_listening( const bool l ) { _adapter.set_listening( l ); } //!< FdAdapterBase::set_listening passthrough
+  const FdAdapterConfig& config() const { return _adapter.config(); } //!< FdAdapterBase::config passthrough
+  FdAdapterConfig& config_mut() { return _adapter.config_mut(); }     //!< FdAdapterBase::config_mut passthrough
+
+  //! FdAdapterBase::set_capture passthrough (so the capture shows what reaches the device, after any losses)
+  void set_capture( std::shared_ptr<PacketCapture> capture ) { _adapter.set_capture( std::move( capture ) ); }
+};
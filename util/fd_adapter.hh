@@ -2,10 +2,12 @@
 
 #include "file_descriptor.hh"
 #include "lossy_fd_adapter.hh"
+#include "packet_capture.hh"
 #include "socket.hh"
 #include "tcp_config.hh"
 #include "tcp_segment.hh"
 
+#include <memory>
 #include <optional>
 #include <utility>
 
@@ -14,12 +16,21 @@
 class FdAdapterBase
 {
 private:
-  FdAdapterConfig _cfg {}; //!< Configuration values
-  bool _listen = false;    //!< Is the connected TCP FSM in listen state?
+  FdAdapterConfig _cfg {};                    //!< Configuration values
+  bool _listen = false;                       //!< Is the connected TCP FSM in listen state?
+  std::shared_ptr<PacketCapture> _capture {}; //!< Where to record the datagrams read and written, if anywhere
 
 protected:
   FdAdapterConfig& config_mutable() { return _cfg; }
 
+  //! Record a datagram read or written (if capturing)
+  void capture( const std::string_view datagram )
+  {
+    if ( _capture ) {
+      _capture->capture( datagram );
+    }
+  }
+
 public:
   //! \brief Set the listening flag
   //! \param[in] l is the new value for the flag
@@ -37,6 +48,10 @@ public:
   //! \returns a mutable reference
   FdAdapterConfig& config_mut() { return _cfg; }
 
+  //! \brief Record every datagram read from or written to the device (before any filtering) in `capture`
+  //! \details The capture should have link type PacketCapture::LinkType::IPv4.
+  void set_capture( std::shared_ptr<PacketCapture> capture ) { _capture = std::move( capture ); }
+
   //! Called periodically when time elapses
   void tick( const size_t unused [[maybe_unused]] ) {}
 };
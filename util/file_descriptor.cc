@@ -108,6 +108,29 @@ void FileDescriptor::read( string& buffer )
   buffer.resize( bytes_read );
 }
 
+size_t FileDescriptor::read( span<char> buffer )
+{
+  const ssize_t bytes_read = ::read( fd_num(), buffer.data(), buffer.size() );
+  if ( bytes_read < 0 ) {
+    if ( internal_fd_->non_blocking_ and ( errno == EAGAIN or errno == EINPROGRESS ) ) {
+      return 0;
+    }
+    throw unix_error { "read" };
+  }
+
+  register_read();
+
+  if ( bytes_read == 0 and not buffer.empty() ) {
+    internal_fd_->eof_ = true;
+  }
+
+  if ( bytes_read > static_cast<ssize_t>( buffer.size() ) ) {
+    throw runtime_error( "read() read more than requested" );
+  }
+
+  return bytes_read;
+}
+
 void FileDescriptor::read( vector<string>& buffers )
 {
   if ( buffers.empty() ) {
@@ -153,7 +176,8 @@ void FileDescriptor::read( vector<string>& buffers )
 
 size_t FileDescriptor::write( string_view buffer )
 {
-  return write( vector<string_view> { buffer } );
+  const iovec single { const_cast<char*>( buffer.data() ), buffer.size() }; // NOLINT(*-const-cast)
+  return write_iovecs( &single, 1, buffer.size() );
 }
 
 size_t FileDescriptor::write( const vector<std::string>& buffers )
@@ -176,8 +200,12 @@ size_t FileDescriptor::write( const vector<string_view>& buffers )
     total_size += x.size();
   }
 
-  const ssize_t bytes_written
-    = CheckSystemCall( "writev", ::writev( fd_num(), iovecs.data(), static_cast<int>( iovecs.size() ) ) );
+  return write_iovecs( iovecs.data(), static_cast<int>( iovecs.size() ), total_size );
+}
+
+size_t FileDescriptor::write_iovecs( const iovec* iovecs, const int count, const size_t total_size )
+{
+  const ssize_t bytes_written = CheckSystemCall( "writev", ::writev( fd_num(), iovecs, count ) );
   register_write();
 
   if ( bytes_written == 0 and total_size != 0 ) {
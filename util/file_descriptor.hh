@@ -3,8 +3,12 @@
 #include <cstddef>
 #include <limits>
 #include <memory>
+#include <span>
+#include <string>
 #include <vector>
 
+struct iovec;
+
 // A reference-counted handle to a file descriptor
 class FileDescriptor
 {
@@ -54,6 +58,9 @@ protected:
   template<typename T>
   T CheckSystemCall( std::string_view s_attempt, T return_value ) const;
 
+private:
+  size_t write_iovecs( const iovec* iovecs, int count, size_t total_size );
+
 public:
   // Construct from a file descriptor number returned by the kernel
   explicit FileDescriptor( int fd );
@@ -64,6 +71,8 @@ public:
   // Read into `buffer`
   void read( std::string& buffer );
   void read( std::vector<std::string>& buffers );
+  // Read into caller-provided memory; returns the number of bytes read
+  size_t read( std::span<char> buffer );
 
   // Attempt to write a buffer
   // returns number of bytes written
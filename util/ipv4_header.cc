@@ -4,6 +4,7 @@
 #include <arpa/inet.h>
 #include <array>
 #include <cstddef>
+#include <span>
 #include <sstream>
 
 using namespace std;
@@ -107,15 +108,31 @@ uint32_t IPv4Header::pseudo_checksum() const
 void IPv4Header::compute_checksum()
 {
   cksum = 0;
-  Serializer s;
+  array<char, LENGTH> raw {};
+  Serializer s { raw };
   serialize( s );
 
   // calculate checksum -- taken over header only
   InternetChecksum check;
-  check.add( s.output() );
+  check.add( { raw.data(), raw.size() } );
   cksum = check.value();
 }
 
+void IPv4Header::serialize( PacketBuffer& buffer )
+{
+  cksum = 0;
+  const span<char> raw = buffer.prepend( LENGTH );
+  Serializer s { raw };
+  serialize( s );
+
+  InternetChecksum check;
+  check.add( { raw.data(), raw.size() } );
+  cksum = check.value();
+
+  Serializer patch { raw.subspan( CHECKSUM_OFFSET, sizeof( cksum ) ) };
+  patch.integer( cksum );
+}
+
 std::string IPv4Header::to_string() const
 {
   stringstream ss {};
@@ -62,4 +62,11 @@ struct IPv4Header
 
   void parse( Parser& parser );
   void serialize( Serializer& serializer ) const;
+
+  // Serialize into the headroom in front of a PacketBuffer, then compute the checksum over the bytes just
+  // written and patch it in place (sets cksum)
+  void serialize( PacketBuffer& buffer );
+
+private:
+  static constexpr size_t CHECKSUM_OFFSET = 10; // position of the checksum field within the header
 };
@@ -0,0 +1,93 @@
+#include "loopback_adapter.hh"
+#include "exception.hh"
+#include "parser.hh"
+
+#include <array>
+#include <cstring>
+#include <span>
+#include <string>
+#include <vector>
+#include <sys/eventfd.h>
+
+using namespace std;
+
+shared_ptr<TCPOverIPv4OverLoopbackFdAdapter::Queue> TCPOverIPv4OverLoopbackFdAdapter::make_queue()
+{
+  // a read resets the count, so a reader that leaves datagrams queued signals the eventfd again (see read_batch)
+  auto queue = make_shared<Queue>( FileDescriptor { CheckSystemCall( "eventfd", eventfd( 0, 0 ) ) } );
+  queue->ready.set_blocking( false );
+  return queue;
+}
+
+void TCPOverIPv4OverLoopbackFdAdapter::signal( Queue& queue )
+{
+  const uint64_t one = 1;
+  array<char, sizeof( one )> increment {};
+  memcpy( increment.data(), &one, sizeof( one ) );
+  queue.ready.write( string_view { increment.data(), increment.size() } );
+}
+
+using LoopbackPair = pair<TCPOverIPv4OverLoopbackFdAdapter, TCPOverIPv4OverLoopbackFdAdapter>;
+
+LoopbackPair TCPOverIPv4OverLoopbackFdAdapter::make_pair()
+{
+  auto a_to_b = make_queue();
+  auto b_to_a = make_queue();
+  return { TCPOverIPv4OverLoopbackFdAdapter { b_to_a, a_to_b },
+           TCPOverIPv4OverLoopbackFdAdapter { std::move( a_to_b ), std::move( b_to_a ) } };
+}
+
+optional<TCPMessage> TCPOverIPv4OverLoopbackFdAdapter::read()
+{
+  vector<TCPMessage> segments;
+  read_batch( segments, 1 );
+  if ( segments.empty() ) {
+    return {};
+  }
+  return std::move( segments.front() );
+}
+
+void TCPOverIPv4OverLoopbackFdAdapter::read_batch( vector<TCPMessage>& segments, const size_t max_datagrams )
+{
+  array<char, sizeof( uint64_t )> count {};
+  _inbound->ready.read( span { count } );
+
+  _batch.clear();
+  bool left_behind = false;
+  {
+    const lock_guard lock { _inbound->lock };
+    while ( _batch.size() < max_datagrams and not _inbound->datagrams.empty() ) {
+      _inbound->bytes -= _inbound->datagrams.front().size();
+      _batch.push_back( std::move( _inbound->datagrams.front() ) );
+      _inbound->datagrams.pop_front();
+    }
+    left_behind = not _inbound->datagrams.empty();
+  }
+  if ( left_behind ) {
+    signal( *_inbound );
+  }
+
+  for ( const auto& datagram : _batch ) {
+    capture( datagram );
+    if ( auto segment = unwrap_tcp_in_ip( string_view { datagram } ) ) {
+      segments.push_back( std::move( segment.value() ) );
+    }
+  }
+}
+
+void TCPOverIPv4OverLoopbackFdAdapter::write( const TCPMessage& seg )
+{
+  PacketBuffer packet { HEADROOM, seg.sender.payload.size() };
+  wrap_tcp_in_ip( seg, packet );
+  capture( packet.view() );
+
+  {
+    const lock_guard lock { _outbound->lock };
+    if ( _outbound->bytes + packet.size() > QUEUE_BYTES ) {
+      return;
+    }
+    _outbound->bytes += packet.size();
+    _outbound->datagrams.emplace_back( packet.view() );
+  }
+  signal( *_outbound );
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "file_descriptor.hh"
+#include "tcp_over_ip.hh"
+#include "tcp_segment.hh"
+#include "tuntap_adapter.hh"
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+//! \brief A FD adapter for IPv4 datagrams exchanged with another adapter in the same process
+//! \details Each direction of a loopback link is a queue of serialized datagrams, with an eventfd that is readable
+//! while the queue is non-empty, so the two ends need no network device and no privileges. Writes never block: a
+//! datagram that would overfill the far end's queue is dropped, as a full device queue would drop it.
+class TCPOverIPv4OverLoopbackFdAdapter : public TCPOverIPv4Adapter
+{
+public:
+  static constexpr size_t QUEUE_BYTES = 1 << 20; //!< Capacity of each direction's queue
+
+private:
+  struct Queue
+  {
+    explicit Queue( FileDescriptor&& eventfd ) : ready( std::move( eventfd ) ) {}
+
+    std::mutex lock {};
+    std::deque<std::string> datagrams {};
+    size_t bytes {};
+    FileDescriptor ready; //!< eventfd, readable while datagrams are queued
+  };
+
+  std::shared_ptr<Queue> _inbound;
+  std::shared_ptr<Queue> _outbound;
+
+  TCPOverIPv4OverLoopbackFdAdapter( std::shared_ptr<Queue> inbound, std::shared_ptr<Queue> outbound )
+    : _inbound( std::move( inbound ) ), _outbound( std::move( outbound ) )
+  {}
+
+  static std::shared_ptr<Queue> make_queue();
+  static void signal( Queue& queue );
+
+  std::vector<std::string> _batch {}; // datagrams taken off the queue together, outside its lock
+
+public:
+  //! Make the two ends of a loopback link
+  static std::pair<TCPOverIPv4OverLoopbackFdAdapter, TCPOverIPv4OverLoopbackFdAdapter> make_pair();
+
+  //! Attempts to read and parse an IPv4 datagram containing a TCP segment related to the current connection
+  std::optional<TCPMessage> read();
+
+  //! Reads up to `max_datagrams` of the datagrams waiting, and appends the TCP segments among them to `segments`
+  void read_batch( std::vector<TCPMessage>& segments, size_t max_datagrams );
+
+  //! Creates an IPv4 datagram from a TCP segment and queues it for the far end
+  void write( const TCPMessage& seg );
+
+  //! Access the file descriptor that is readable while datagrams are waiting
+  FileDescriptor& fd() { return _inbound->ready; }
+};
+
+static_assert( TCPDatagramAdapter<TCPOverIPv4OverLoopbackFdAdapter> );
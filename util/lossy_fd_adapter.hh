@@ -1,13 +1,18 @@
 #pragma once
 
 #include "file_descriptor.hh"
+#include "packet_capture.hh"
 #include "random.hh"
 #include "tcp_config.hh"
 #include "tcp_segment.hh"
 
+#include <algorithm>
+#include <cstddef>
+#include <memory>
 #include <optional>
 #include <random>
 #include <utility>
+#include <vector>
 
 //! An adapter class that adds random dropping behavior to an FD adapter
 template<typename AdapterT>
@@ -49,6 +54,17 @@ public:
     return ret;
   }
 
+  //! \brief Read a batch from the underlying AdapterT instance, potentially dropping each datagram read
+  void read_batch( std::vector<TCPMessage>& segments, const size_t max_datagrams )
+  {
+    const size_t first = segments.size();
+    _adapter.read_batch( segments, max_datagrams );
+    segments.erase( std::remove_if( segments.begin() + static_cast<std::ptrdiff_t>( first ),
+                                    segments.end(),
+                                    [&]( const TCPMessage& ) { return _should_drop( false ); } ),
+                    segments.end() );
+  }
+
   //! \brief Write to the underlying AdapterT instance, potentially dropping the datagram to be written
   //! \param[in] seg is the packet to either write or drop
   void write( const TCPMessage& seg )
@@ -65,5 +81,8 @@ public:
   void set_listening( const bool l ) { _adapter.set_listening( l ); } //!< FdAdapterBase::set_listening passthrough
   const FdAdapterConfig& config() const { return _adapter.config(); } //!< FdAdapterBase::config passthrough
   FdAdapterConfig& config_mut() { return _adapter.config_mut(); }     //!< FdAdapterBase::config_mut passthrough
+
+  //! FdAdapterBase::set_capture passthrough (so the capture shows what reaches the device, after any losses)
+  void set_capture( std::shared_ptr<PacketCapture> capture ) { _adapter.set_capture( std::move( capture ) ); }
   void tick( const size_t ms_since_last_tick ) { _adapter.tick( ms_since_last_tick ); }
 };
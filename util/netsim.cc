@@ -0,0 +1,110 @@
+#include "netsim.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <numeric>
+
+using namespace std;
+
+bool Simulator::later( const Event& a, const Event& b )
+{
+  return a.time_us != b.time_us ? a.time_us > b.time_us : a.seq > b.seq;
+}
+
+void Simulator::at( const uint64_t time_us, function<void()> action )
+{
+  events_.push_back( { max( time_us, now_us_ ), next_seq_++, std::move( action ) } );
+  push_heap( events_.begin(), events_.end(), later );
+}
+
+void Simulator::every_ms( const uint64_t period_ms, function<void( uint64_t )> ticker )
+{
+  // the event reschedules itself, sharing one copy of the ticker among its occurrences
+  auto recurring = make_shared<function<void()>>();
+  *recurring = [this, period_ms, ticker = std::move( ticker ), weak = weak_ptr( recurring )] {
+    ticker( period_ms );
+    at( now_us_ + period_ms * 1000, [self = weak.lock()] { ( *self )(); } );
+  };
+  at( now_us_ + period_ms * 1000, [recurring] { ( *recurring )(); } );
+}
+
+void Simulator::run_next()
+{
+  pop_heap( events_.begin(), events_.end(), later );
+  Event event = std::move( events_.back() );
+  events_.pop_back();
+
+  now_us_ = event.time_us;
+  processed_++;
+  event.action();
+}
+
+void Simulator::run_until( const uint64_t end_us )
+{
+  while ( not events_.empty() and events_.front().time_us <= end_us ) {
+    run_next();
+  }
+  now_us_ = max( now_us_, end_us );
+}
+
+bool Simulator::run_while( const function<bool()>& condition, const uint64_t end_us )
+{
+  while ( not events_.empty() and events_.front().time_us <= end_us ) {
+    if ( not condition() ) {
+      return true;
+    }
+    run_next();
+  }
+  return not condition();
+}
+
+uint64_t SimLink::transmission_time_us( const size_t bytes ) const
+{
+  return config_.rate_bits_per_s ? bytes * 8 * 1'000'000 / config_.rate_bits_per_s : 0;
+}
+
+size_t SimLink::queue_bytes() const
+{
+  const uint64_t backlog_us = busy_until_us_ > sim_->now_us() ? busy_until_us_ - sim_->now_us() : 0;
+  return backlog_us * config_.rate_bits_per_s / 8 / 1'000'000;
+}
+
+bool SimLink::send( const size_t bytes, function<void()> deliver )
+{
+  const size_t queued = queue_bytes();
+  if ( config_.rate_bits_per_s and queued + bytes > config_.queue_bytes ) {
+    stats_.queue_drops++;
+    return false;
+  }
+  stats_.max_queue_bytes = max( stats_.max_queue_bytes, queued + bytes );
+
+  // a lost packet still occupies the bottleneck; it just never arrives
+  busy_until_us_ = max( busy_until_us_, sim_->now_us() ) + transmission_time_us( bytes );
+  stats_.packets_sent++;
+  stats_.bytes_sent += bytes;
+  if ( config_.loss > 0 and uniform_real_distribution<double> { 0, 1 }( sim_->rng() ) < config_.loss ) {
+    stats_.losses++;
+    return true;
+  }
+
+  sim_->at( busy_until_us_ + config_.delay_us, std::move( deliver ) );
+  return true;
+}
+
+double SampleSet::mean() const
+{
+  return samples_.empty() ? 0 : accumulate( samples_.begin(), samples_.end(), 0.0 ) / samples_.size();
+}
+
+double SampleSet::percentile( const double p ) const
+{
+  if ( samples_.empty() ) {
+    return 0;
+  }
+  vector<double> sorted = samples_;
+  const auto rank = static_cast<size_t>( ceil( p / 100 * sorted.size() ) );
+  const auto nth = sorted.begin() + static_cast<ptrdiff_t>( rank ? rank - 1 : 0 );
+  nth_element( sorted.begin(), nth, sorted.end() );
+  return *nth;
+}
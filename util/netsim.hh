@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <vector>
+
+//! \brief A deterministic discrete-event simulator with a virtual clock
+//! \details Events run in order of their scheduled time (ties in the order they were scheduled), and the clock
+//! jumps straight from one event to the next, so idle stretches of simulated time cost nothing. Every random
+//! decision draws from one seeded engine, so a run is reproduced exactly by reusing its seed.
+class Simulator
+{
+public:
+  explicit Simulator( uint64_t seed ) : rng_( seed ) {}
+
+  uint64_t now_us() const { return now_us_; }             //!< Virtual time, in microseconds
+  uint64_t events_processed() const { return processed_; } //!< Events run so far
+  std::mt19937_64& rng() { return rng_; }                  //!< The engine behind every random decision
+
+  //! Run `action` at virtual time `time_us` (or now, if that is already past)
+  void at( uint64_t time_us, std::function<void()> action );
+
+  //! Run `action` after `delay_us` of virtual time
+  void after( uint64_t delay_us, std::function<void()> action ) { at( now_us_ + delay_us, std::move( action ) ); }
+
+  //! Call `ticker` every `period_ms` of virtual time, passing the milliseconds elapsed (as `tick()` expects)
+  void every_ms( uint64_t period_ms, std::function<void( uint64_t )> ticker );
+
+  //! Run events until none are left before `end_us`, then advance the clock to `end_us`
+  void run_until( uint64_t end_us );
+
+  //! Run events while `condition` holds, but not past `end_us`
+  //! \returns whether `condition` stopped the run (as opposed to the time limit)
+  bool run_while( const std::function<bool()>& condition, uint64_t end_us );
+
+private:
+  struct Event
+  {
+    uint64_t time_us;
+    uint64_t seq; // breaks ties, so events scheduled for the same time run in FIFO order
+    std::function<void()> action;
+  };
+  static bool later( const Event& a, const Event& b );
+
+  void run_next();
+
+  std::vector<Event> events_ {}; // a min-heap by (time_us, seq)
+  uint64_t now_us_ {};
+  uint64_t next_seq_ {};
+  uint64_t processed_ {};
+  std::mt19937_64 rng_;
+};
+
+//! Parameters of one direction of a simulated link
+struct LinkConfig
+{
+  uint64_t rate_bits_per_s = 10'000'000; //!< Bottleneck rate (0 means infinitely fast)
+  uint64_t delay_us = 10'000;            //!< One-way propagation delay
+  size_t queue_bytes = 64 * 1024;        //!< Room in the drop-tail queue in front of the bottleneck
+  double loss = 0;                       //!< Probability that a packet is lost on the wire
+};
+
+//! \brief One direction of a simulated point-to-point link
+//! \details A packet offered to the link waits in a drop-tail FIFO queue, is serialized at the link's rate, and
+//! arrives at the far end after the propagation delay (unless it is lost on the way).
+class SimLink
+{
+public:
+  //! What the link has done with the packets offered to it
+  struct Stats
+  {
+    uint64_t packets_sent {};  //!< Packets put on the wire (including those then lost)
+    uint64_t bytes_sent {};    //!< Bytes put on the wire
+    uint64_t queue_drops {};   //!< Packets that found the queue full
+    uint64_t losses {};        //!< Packets lost on the wire
+    size_t max_queue_bytes {}; //!< High-water mark of the queue
+  };
+
+  SimLink( Simulator& sim, const LinkConfig& config ) : sim_( &sim ), config_( config ) {}
+
+  //! Offer a packet of `bytes` to the link; `deliver` runs when it arrives at the far end
+  //! \returns false if the packet was dropped at the queue
+  bool send( size_t bytes, std::function<void()> deliver );
+
+  //! Bytes waiting in the queue (including the packet being serialized)
+  size_t queue_bytes() const;
+
+  const LinkConfig& config() const { return config_; }
+  const Stats& stats() const { return stats_; }
+
+private:
+  uint64_t transmission_time_us( size_t bytes ) const;
+
+  Simulator* sim_;
+  LinkConfig config_;
+  uint64_t busy_until_us_ {}; // when the last packet queued finishes serializing
+  Stats stats_ {};
+};
+
+//! A collection of measurements, summarized by mean and percentiles
+class SampleSet
+{
+public:
+  void add( double sample ) { samples_.push_back( sample ); }
+  void add( const SampleSet& other )
+  {
+    samples_.insert( samples_.end(), other.samples_.begin(), other.samples_.end() );
+  }
+  size_t count() const { return samples_.size(); }
+  double mean() const;
+
+  //! The `p`th percentile (0 <= p <= 100), by nearest rank; 0 if there are no samples
+  double percentile( double p ) const;
+
+private:
+  std::vector<double> samples_ {};
+};
@@ -0,0 +1,296 @@
+#pragma once
+
+#include "netsim.hh"
+#include "network_interface.hh"
+#include "router.hh"
+#include "tcp_over_ip.hh"
+#include "tcp_peer.hh"
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+
+// The nodes of a simulated network: hosts running TCPPeer and routers running Router, each with
+// NetworkInterfaces whose frames travel over SimLinks. Every node is driven by the Simulator's virtual clock.
+
+//! \brief The output port of a simulated interface: frames go over a SimLink to the interface at the far end
+class SimPort : public NetworkInterface::OutputPort
+{
+public:
+  SimPort( Simulator& sim, const LinkConfig& config ) : link_( sim, config ) {}
+
+  //! Plug the cable's far end into `peer`; `on_delivery` tells the peer's node that a frame has arrived
+  void attach( std::shared_ptr<NetworkInterface> peer, std::function<void()> on_delivery )
+  {
+    peer_ = std::move( peer );
+    on_delivery_ = std::move( on_delivery );
+  }
+
+  void transmit( const NetworkInterface& sender [[maybe_unused]], const EthernetFrame& frame ) override
+  {
+    if ( not peer_ ) {
+      return;
+    }
+    size_t bytes = EthernetHeader::LENGTH;
+    for ( const auto& buffer : frame.payload ) {
+      bytes += buffer.size();
+    }
+    link_.send( bytes, [peer = peer_, frame, on_delivery = on_delivery_] {
+      peer->recv_frame( frame );
+      on_delivery();
+    } );
+  }
+
+  const SimLink& link() const { return link_; }
+
+private:
+  SimLink link_;
+  std::shared_ptr<NetworkInterface> peer_ {};
+  std::function<void()> on_delivery_ {};
+};
+
+//! A node's interface together with the link carrying its outgoing frames
+struct SimAttachment
+{
+  std::shared_ptr<SimPort> port;
+  std::shared_ptr<NetworkInterface> interface;
+  std::function<void()> on_delivery; //!< Tells the owning node that the interface has received something
+};
+
+//! Make an interface with a random (but seeded) Ethernet address, sending over a link with the given parameters
+inline SimAttachment make_attachment( Simulator& sim,
+                                      const std::string& name,
+                                      uint32_t ip,
+                                      const LinkConfig& egress,
+                                      std::function<void()> on_delivery )
+{
+  EthernetAddress ethernet_address;
+  for ( auto& byte : ethernet_address ) {
+    byte = static_cast<uint8_t>( sim.rng()() );
+  }
+  ethernet_address.at( 0 ) &= 0xfe; // unicast
+
+  auto port = std::make_shared<SimPort>( sim, egress );
+  auto interface
+    = std::make_shared<NetworkInterface>( name, port, ethernet_address, Address::from_ipv4_numeric( ip ) );
+  return { std::move( port ), std::move( interface ), std::move( on_delivery ) };
+}
+
+//! Join two interfaces with a cable (one link in each direction)
+inline void connect( const SimAttachment& a, const SimAttachment& b )
+{
+  a.port->attach( b.interface, b.on_delivery );
+  b.port->attach( a.interface, a.on_delivery );
+}
+
+//! \brief A simulated host: a TCPPeer over IPv4 over a NetworkInterface, with a bulk-transfer application
+//! \details The application writes `send()`'s bytes into the outbound stream as room allows, closing it once they
+//! are all written, and reads everything that arrives on the inbound stream. The host records what its peer
+//! transmits: segments, retransmissions, and round-trip times (sampled per Karn's algorithm, so a sequence range
+//! that was ever retransmitted gives no sample).
+class SimHost
+{
+public:
+  struct Stats
+  {
+    uint64_t segments_sent {};
+    uint64_t retransmissions {};      //!< Segments that resent sequence numbers already sent
+    uint64_t bytes_received {};       //!< Bytes the application read from the inbound stream
+    std::optional<uint64_t> done_us;  //!< When the inbound stream finished
+    SampleSet rtt_ms {};              //!< Round-trip times of acknowledged segments
+  };
+
+  //! \param[in] gateway is the next hop for every outgoing datagram
+  SimHost( Simulator& sim,
+           const std::string& name,
+           const TCPConfig& tcp_config,
+           const IPv4Endpoint& local,
+           const IPv4Endpoint& remote,
+           uint32_t gateway,
+           const LinkConfig& uplink )
+    : sim_( &sim )
+    , peer_( tcp_config )
+    , isn_( tcp_config.isn )
+    , gateway_( gateway )
+    , attachment_( make_attachment( sim, name, local.ip, uplink, [this] { poll(); } ) )
+  {
+    adapter_.config_mut().source = local;
+    adapter_.config_mut().destination = remote;
+    sim.every_ms( 1, [this]( uint64_t ms ) { tick( ms ); } );
+  }
+
+  // The simulator's events point at the host
+  SimHost( const SimHost& other ) = delete;
+  SimHost& operator=( const SimHost& other ) = delete;
+
+  const SimAttachment& attachment() const { return attachment_; }
+
+  //! Open the connection (otherwise, the host waits for its peer to open it)
+  void connect()
+  {
+    open_ = true;
+    pump();
+  }
+
+  //! Have the application send `bytes` bytes, then close the outbound stream
+  void send( uint64_t bytes )
+  {
+    to_send_ += bytes;
+    close_when_sent_ = true;
+    pump();
+  }
+
+  //! Has the inbound stream finished?
+  bool done() const { return stats_.done_us.has_value(); }
+
+  const Stats& stats() const { return stats_; }
+  const TCPPeer& peer() const { return peer_; }
+
+private:
+  void transmit( TCPMessage msg )
+  {
+    record_sent( msg );
+    attachment_.interface->send_datagram( adapter_.wrap_tcp_in_ip( msg ), gateway_ );
+  }
+
+  // Run the application, then let the peer send whatever it now can
+  void pump()
+  {
+    Writer& writer = peer_.outbound_writer();
+    while ( to_send_ > 0 and writer.available_capacity() > 0 ) {
+      const uint64_t len = std::min( { to_send_, writer.available_capacity(), uint64_t { 65536 } } );
+      writer.push( std::string( len, 'x' ) );
+      to_send_ -= len;
+    }
+    if ( close_when_sent_ and to_send_ == 0 and not writer.is_closed() ) {
+      writer.close();
+    }
+
+    Reader& reader = peer_.inbound_reader();
+    while ( reader.bytes_buffered() > 0 ) {
+      const uint64_t len = reader.peek().size();
+      stats_.bytes_received += len;
+      reader.pop( len );
+    }
+    if ( reader.is_finished() and not stats_.done_us ) {
+      stats_.done_us = sim_->now_us();
+    }
+
+    if ( open_ ) {
+      peer_.push( transmit_ );
+    }
+  }
+
+  void poll()
+  {
+    auto& datagrams = attachment_.interface->datagrams_received();
+    while ( not datagrams.empty() ) {
+      auto msg = adapter_.unwrap_tcp_in_ip( datagrams.front() );
+      datagrams.pop();
+      if ( msg ) {
+        open_ = true;
+        record_ack( *msg );
+        peer_.receive( std::move( *msg ), transmit_ );
+      }
+    }
+    pump();
+  }
+
+  void tick( uint64_t ms )
+  {
+    peer_.tick( ms, transmit_ );
+    attachment_.interface->tick( ms );
+    pump();
+  }
+
+  void record_sent( const TCPMessage& msg )
+  {
+    const uint64_t length = msg.sender.sequence_length();
+    if ( length == 0 ) {
+      return;
+    }
+    stats_.segments_sent++;
+    const uint64_t start = msg.sender.seqno.unwrap( isn_, highest_sent_ );
+    if ( start < highest_sent_ ) {
+      stats_.retransmissions++;
+      retransmitted_up_to_ = std::max( retransmitted_up_to_, start + length );
+      return;
+    }
+    highest_sent_ = start + length;
+    unacked_.push_back( { highest_sent_, sim_->now_us() } );
+  }
+
+  void record_ack( const TCPMessage& msg )
+  {
+    if ( not msg.receiver.ackno ) {
+      return;
+    }
+    const uint64_t ackno = msg.receiver.ackno->unwrap( isn_, highest_sent_ );
+    while ( not unacked_.empty() and unacked_.front().end <= ackno ) {
+      if ( unacked_.front().end > retransmitted_up_to_ ) {
+        stats_.rtt_ms.add( static_cast<double>( sim_->now_us() - unacked_.front().sent_us ) / 1000 );
+      }
+      unacked_.pop_front();
+    }
+  }
+
+  struct Unacked
+  {
+    uint64_t end;     // absolute sequence number just past the segment
+    uint64_t sent_us; // when it was first sent
+  };
+
+  Simulator* sim_;
+  TCPPeer peer_;
+  TCPOverIPv4Adapter adapter_ {};
+  Wrap32 isn_;
+  uint32_t gateway_;
+  SimAttachment attachment_;
+  TCPPeer::TransmitFunction transmit_ { [this]( TCPMessage msg ) { transmit( std::move( msg ) ); } };
+
+  bool open_ {};
+  uint64_t to_send_ {};
+  bool close_when_sent_ {};
+
+  uint64_t highest_sent_ {};
+  uint64_t retransmitted_up_to_ {};
+  std::deque<Unacked> unacked_ {};
+  Stats stats_ {};
+};
+
+//! A simulated router: a Router whose interfaces send over SimLinks, routing whenever a frame arrives
+class SimRouter
+{
+public:
+  explicit SimRouter( Simulator& sim ) : sim_( &sim )
+  {
+    sim.every_ms( 1, [this]( uint64_t ms ) {
+      for ( const auto& attachment : attachments_ ) {
+        attachment.interface->tick( ms );
+      }
+      router_.route();
+    } );
+  }
+
+  // The simulator's events point at the router
+  SimRouter( const SimRouter& other ) = delete;
+  SimRouter& operator=( const SimRouter& other ) = delete;
+
+  //! Add an interface with address `ip`, whose outgoing frames travel over a link with parameters `egress`
+  //! \returns the interface's index (for add_route and attachment)
+  size_t add_interface( const std::string& name, uint32_t ip, const LinkConfig& egress )
+  {
+    attachments_.push_back( make_attachment( *sim_, name, ip, egress, [this] { router_.route(); } ) );
+    return router_.add_interface( attachments_.back().interface );
+  }
+
+  const SimAttachment& attachment( size_t n ) const { return attachments_.at( n ); }
+  Router& router() { return router_; }
+
+private:
+  Simulator* sim_;
+  Router router_ {};
+  std::vector<SimAttachment> attachments_ {};
+};
@@ -0,0 +1,209 @@
+#include "packet_capture.hh"
+
+#include "exception.hh"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+// The classic pcap file header, in the writer's byte order (readers tell it from the magic number)
+struct PcapFileHeader
+{
+  static constexpr uint32_t MAGIC_US = 0xa1b2'c3d4; // microsecond timestamps
+  static constexpr uint32_t MAGIC_NS = 0xa1b2'3c4d; // nanosecond timestamps
+
+  uint32_t magic = MAGIC_NS;
+  uint16_t version_major = 2;
+  uint16_t version_minor = 4;
+  int32_t thiszone = 0;
+  uint32_t sigfigs = 0;
+  uint32_t snaplen;
+  uint32_t network;
+};
+
+struct PcapRecordHeader
+{
+  uint32_t ts_sec;
+  uint32_t ts_nsec;
+  uint32_t incl_len;
+  uint32_t orig_len;
+};
+
+template<typename T>
+void append( string& batch, const T& value )
+{
+  batch.append( reinterpret_cast<const char*>( &value ), sizeof( value ) ); // NOLINT(*-reinterpret-cast)
+}
+
+uint32_t swap_bytes( const uint32_t value )
+{
+  return ( value >> 24 ) | ( ( value >> 8 ) & 0xff00 ) | ( ( value << 8 ) & 0xff'0000 ) | ( value << 24 );
+}
+
+void write_all( FileDescriptor& file, string_view data )
+{
+  while ( not data.empty() ) {
+    data.remove_prefix( file.write( data ) );
+  }
+}
+} // namespace
+
+PacketCapture::PacketCapture( const string& path, const LinkType link_type, const CaptureOptions& options )
+  : options_( options )
+  , slot_mask_( bit_ceil( max<size_t>( options.ring_slots, 1 ) ) - 1 )
+  , headers_( slot_mask_ + 1 )
+  , data_( ( slot_mask_ + 1 ) * options.snap_length )
+  , writer_()
+{
+  if ( options_.snap_length == 0 or options_.sample_every == 0 ) {
+    throw runtime_error( "PacketCapture: snap_length and sample_every must be positive" );
+  }
+
+  FileDescriptor file { CheckSystemCall( "open " + path,
+                                         ::open( path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 ) ) };
+  string header;
+  const PcapFileHeader file_header {
+    .snaplen = options_.snap_length, .network = static_cast<uint32_t>( link_type ) };
+  append( header, file_header );
+  write_all( file, header );
+
+  writer_ = jthread {
+    [this, file = std::move( file )]( const stop_token& stop ) mutable { write_loop( stop, file ); } };
+}
+
+PacketCapture::~PacketCapture()
+{
+  writer_.request_stop(); // the writer drains the ring once more before it exits
+}
+
+void PacketCapture::capture( const span<const string_view> pieces )
+{
+  while ( capturing_.test_and_set( memory_order_acquire ) ) {}
+
+  if ( seen_++ % options_.sample_every != 0 ) {
+    sampled_out_.fetch_add( 1, memory_order_relaxed );
+    capturing_.clear( memory_order_release );
+    return;
+  }
+
+  const uint64_t head = head_.load( memory_order_relaxed );
+  if ( head - tail_.load( memory_order_acquire ) > slot_mask_ ) {
+    dropped_.fetch_add( 1, memory_order_relaxed );
+    capturing_.clear( memory_order_release );
+    return;
+  }
+
+  const size_t slot = head & slot_mask_;
+  char* const data = data_.data() + slot * options_.snap_length;
+  size_t original_length = 0;
+  size_t captured_length = 0;
+  for ( const auto piece : pieces ) {
+    const size_t copied = min<size_t>( piece.size(), options_.snap_length - captured_length );
+    memcpy( data + captured_length, piece.data(), copied );
+    captured_length += copied;
+    original_length += piece.size();
+  }
+
+  const auto now = chrono::system_clock::now().time_since_epoch();
+  headers_[slot] = { static_cast<uint64_t>( chrono::duration_cast<chrono::nanoseconds>( now ).count() ),
+                     static_cast<uint32_t>( original_length ),
+                     static_cast<uint32_t>( captured_length ) };
+  head_.store( head + 1, memory_order_release );
+  capturing_.clear( memory_order_release );
+}
+
+PacketCapture::Stats PacketCapture::stats() const
+{
+  return { head_.load( memory_order_relaxed ),
+           sampled_out_.load( memory_order_relaxed ),
+           dropped_.load( memory_order_relaxed ) };
+}
+
+void PacketCapture::write_loop( const stop_token& stop, FileDescriptor& file )
+{
+  string batch;
+  while ( not stop.stop_requested() ) {
+    {
+      unique_lock lock { wake_mutex_ };
+      wake_.wait_for( lock, stop, chrono::milliseconds { options_.flush_interval_ms }, [] { return false; } );
+    }
+    drain( file, batch );
+  }
+  drain( file, batch );
+}
+
+void PacketCapture::drain( FileDescriptor& file, string& batch )
+{
+  const uint64_t head = head_.load( memory_order_acquire );
+  uint64_t tail = tail_.load( memory_order_relaxed );
+  if ( tail == head ) {
+    return;
+  }
+
+  batch.clear();
+  for ( ; tail != head; tail++ ) {
+    const size_t slot = tail & slot_mask_;
+    const SlotHeader& header = headers_[slot];
+    append( batch,
+            PcapRecordHeader { static_cast<uint32_t>( header.time_ns / 1'000'000'000 ),
+                               static_cast<uint32_t>( header.time_ns % 1'000'000'000 ),
+                               header.captured_length,
+                               header.original_length } );
+    batch.append( data_.data() + slot * options_.snap_length, header.captured_length );
+  }
+
+  // the slots are free again once copied out, so the capturing thread can reuse them while the batch is written
+  tail_.store( tail, memory_order_release );
+  write_all( file, batch );
+}
+
+PcapFile PcapFile::read( const string& path )
+{
+  ifstream in { path, ios::binary };
+  if ( not in ) {
+    throw runtime_error( "could not open " + path );
+  }
+  const string file { istreambuf_iterator<char> { in }, {} };
+
+  const auto read_header = [&]<typename T>( const size_t offset, T& header ) {
+    if ( offset + sizeof( header ) > file.size() ) {
+      throw runtime_error( path + ": truncated pcap file" );
+    }
+    memcpy( &header, file.data() + offset, sizeof( header ) );
+  };
+
+  PcapFileHeader file_header {};
+  read_header( 0, file_header );
+  const bool swapped = file_header.magic == swap_bytes( PcapFileHeader::MAGIC_US )
+                       or file_header.magic == swap_bytes( PcapFileHeader::MAGIC_NS );
+  const auto field = [swapped]( const uint32_t value ) { return swapped ? swap_bytes( value ) : value; };
+  const uint32_t magic = field( file_header.magic );
+  if ( magic != PcapFileHeader::MAGIC_US and magic != PcapFileHeader::MAGIC_NS ) {
+    throw runtime_error( path + ": not a pcap file" );
+  }
+  const uint64_t ns_per_tick = magic == PcapFileHeader::MAGIC_US ? 1000 : 1;
+
+  PcapFile pcap { field( file_header.network ), field( file_header.snaplen ), {} };
+  for ( size_t offset = sizeof( file_header ); offset < file.size(); ) {
+    PcapRecordHeader record {};
+    read_header( offset, record );
+    offset += sizeof( record );
+    const uint32_t captured_length = field( record.incl_len );
+    if ( offset + captured_length > file.size() ) {
+      throw runtime_error( path + ": truncated pcap file" );
+    }
+    pcap.packets.push_back( { field( record.ts_sec ) * 1'000'000'000UL + field( record.ts_nsec ) * ns_per_tick,
+                              field( record.orig_len ),
+                              file.substr( offset, captured_length ) } );
+    offset += captured_length;
+  }
+  return pcap;
+}
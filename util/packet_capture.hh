@@ -0,0 +1,114 @@
+#pragma once
+
+#include "file_descriptor.hh"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+//! How a PacketCapture records packets
+struct CaptureOptions
+{
+  uint32_t snap_length = 256;      //!< Bytes kept of each packet (the rest is cut off, as with tcpdump -s)
+  uint32_t sample_every = 1;       //!< Record one packet in this many (1: every packet)
+  size_t ring_slots = 4096;        //!< Packets that can wait for the writer thread (rounded up to a power of two)
+  uint32_t flush_interval_ms = 50; //!< How often the writer thread wakes up to write out what has been captured
+};
+
+//! \brief Records packets to a pcap file without making the capturing thread wait on the disk
+//! \details A capture copies (the first `snap_length` bytes of) each packet into a preallocated ring of slots,
+//! and a background thread writes the ring out to the file. Capturing a packet takes a clock read and a copy of
+//! at most `snap_length` bytes: it never allocates, makes a system call or waits for the writer. If the writer
+//! falls behind and the ring fills up, packets are dropped from the capture (and counted), never held up.
+//!
+//! The file is in the classic pcap format with nanosecond timestamps, readable by tcpdump and Wireshark.
+class PacketCapture
+{
+public:
+  //! What a capture's packets start with
+  enum class LinkType : uint32_t
+  {
+    Ethernet = 1, //!< Ethernet frames
+    IPv4 = 228,   //!< IPv4 datagrams, without a link-layer header
+  };
+
+  //! What a capture has done so far
+  struct Stats
+  {
+    uint64_t captured {};    //!< Packets recorded
+    uint64_t sampled_out {}; //!< Packets skipped by sampling
+    uint64_t dropped {};     //!< Packets lost because the ring was full
+  };
+
+  //! Create (or truncate) the file at `path`, and start the writer thread
+  PacketCapture( const std::string& path, LinkType link_type, const CaptureOptions& options = {} );
+
+  //! Write out whatever is still in the ring, and close the file
+  ~PacketCapture();
+
+  PacketCapture( const PacketCapture& other ) = delete;
+  PacketCapture& operator=( const PacketCapture& other ) = delete;
+  PacketCapture( PacketCapture&& other ) = delete;
+  PacketCapture& operator=( PacketCapture&& other ) = delete;
+
+  //! Record a packet
+  void capture( std::string_view packet ) { capture( std::span { &packet, 1 } ); }
+
+  //! Record a packet that is held in pieces (e.g. a header and a payload), as if they were concatenated
+  void capture( std::span<const std::string_view> pieces );
+
+  Stats stats() const;
+
+private:
+  struct SlotHeader
+  {
+    uint64_t time_ns;
+    uint32_t original_length;
+    uint32_t captured_length;
+  };
+
+  CaptureOptions options_;
+  size_t slot_mask_;
+
+  std::vector<SlotHeader> headers_;
+  std::vector<char> data_; // slot i's bytes are at i * snap_length
+
+  std::atomic<uint64_t> head_ {};                 // slots filled, ever
+  std::atomic<uint64_t> tail_ {};                 // slots written out, ever
+  std::atomic_flag capturing_ = ATOMIC_FLAG_INIT; // held while a packet is copied in, so any thread may capture
+  uint64_t seen_ {};                              // packets offered, for sampling (guarded by capturing_)
+  std::atomic<uint64_t> sampled_out_ {};
+  std::atomic<uint64_t> dropped_ {};
+
+  std::mutex wake_mutex_ {};
+  std::condition_variable_any wake_ {};
+  std::jthread writer_;
+
+  void write_loop( const std::stop_token& stop, FileDescriptor& file );
+  void drain( FileDescriptor& file, std::string& batch );
+};
+
+//! A packet read back from a pcap file
+struct CapturedPacket
+{
+  uint64_t time_ns;         //!< When it was captured, in ns since the epoch
+  uint32_t original_length; //!< Its length on the wire (more than data.size() if it was cut to the snap length)
+  std::string data;
+};
+
+//! The contents of a pcap file
+struct PcapFile
+{
+  uint32_t link_type; //!< As in the file header (see PacketCapture::LinkType)
+  uint32_t snap_length;
+  std::vector<CapturedPacket> packets;
+
+  //! Read a whole pcap file (with microsecond or nanosecond timestamps, in either byte order)
+  static PcapFile read( const std::string& path );
+};
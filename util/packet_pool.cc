@@ -0,0 +1,169 @@
+#include "packet_pool.hh"
+
+#include "exception.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <utility>
+
+using namespace std;
+
+namespace {
+// Set once the calling thread's cache has been destroyed (during thread exit)
+thread_local bool thread_cache_destroyed = false;
+} // namespace
+
+PacketPool::Handle::~Handle()
+{
+  if ( data_ ) {
+    PacketPool::global().release( data_ );
+  }
+}
+
+PacketPool::Handle::Handle( Handle&& other ) noexcept
+  : data_( exchange( other.data_, nullptr ) ), size_( exchange( other.size_, 0 ) )
+{}
+
+PacketPool::Handle& PacketPool::Handle::operator=( Handle&& other ) noexcept
+{
+  if ( this != &other ) {
+    if ( data_ ) {
+      PacketPool::global().release( data_ );
+    }
+    data_ = exchange( other.data_, nullptr );
+    size_ = exchange( other.size_, 0 );
+  }
+  return *this;
+}
+
+void PacketPool::Handle::resize( const size_t size )
+{
+  if ( size > ( data_ ? BUFFER_SIZE : 0 ) ) {
+    throw runtime_error( "PacketPool::Handle::resize beyond buffer capacity" );
+  }
+  size_ = size;
+}
+
+PacketPool& PacketPool::global()
+{
+  static PacketPool* const pool = new PacketPool; // NOLINT(*-owning-memory): intentionally never freed
+  return *pool;
+}
+
+PacketPool::ThreadCache::~ThreadCache()
+{
+  thread_cache_destroyed = true;
+  PacketPool::global().drain( *this, 0 );
+}
+
+PacketPool::ThreadCache* PacketPool::thread_cache()
+{
+  if ( thread_cache_destroyed ) {
+    return nullptr;
+  }
+  thread_local ThreadCache cache;
+  return &cache;
+}
+
+PacketPool::Handle PacketPool::acquire()
+{
+  ThreadCache* const cache = thread_cache();
+  if ( cache == nullptr ) {
+    const lock_guard lock { mutex_ };
+    if ( free_.empty() ) {
+      add_slab();
+    }
+    char* const data = free_.back();
+    free_.pop_back();
+    return Handle { data };
+  }
+
+  if ( cache->buffers.empty() ) {
+    refill( *cache );
+  }
+  char* const data = cache->buffers.back();
+  cache->buffers.pop_back();
+  return Handle { data };
+}
+
+void PacketPool::release( char* const data )
+{
+  ThreadCache* const cache = thread_cache();
+  if ( cache == nullptr ) {
+    const lock_guard lock { mutex_ };
+    free_.push_back( data );
+    return;
+  }
+
+  cache->buffers.push_back( data );
+  if ( cache->buffers.size() >= 2 * ThreadCache::BATCH ) {
+    drain( *cache, ThreadCache::BATCH );
+  }
+}
+
+void PacketPool::refill( ThreadCache& cache )
+{
+  const lock_guard lock { mutex_ };
+  if ( free_.empty() ) {
+    add_slab();
+  }
+  const auto first = free_.end() - static_cast<ptrdiff_t>( min( free_.size(), ThreadCache::BATCH ) );
+  cache.buffers.insert( cache.buffers.end(), first, free_.end() );
+  free_.erase( first, free_.end() );
+}
+
+void PacketPool::drain( ThreadCache& cache, const size_t keep )
+{
+  if ( cache.buffers.size() <= keep ) {
+    return;
+  }
+  const lock_guard lock { mutex_ };
+  const auto first = cache.buffers.begin() + static_cast<ptrdiff_t>( keep );
+  free_.insert( free_.end(), first, cache.buffers.end() );
+  cache.buffers.erase( first, cache.buffers.end() );
+}
+
+void PacketPool::add_slab()
+{
+  // Prefer an explicit hugepage; this fails unless hugepages have been reserved (vm.nr_hugepages).
+  void* slab = mmap( nullptr, SLAB_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+  if ( slab == MAP_FAILED ) {
+    // A transparent hugepage has to be 2 MiB-aligned, so map twice the slab and trim it to an aligned one.
+    void* const mapping
+      = mmap( nullptr, 2 * SLAB_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    if ( mapping == MAP_FAILED ) {
+      throw unix_error { "mmap" };
+    }
+    char* const start = static_cast<char*>( mapping );
+    const auto address = reinterpret_cast<uintptr_t>( start ); // NOLINT(*-reinterpret-cast)
+    const size_t head = ( SLAB_SIZE - address % SLAB_SIZE ) % SLAB_SIZE;
+    if ( head > 0 ) {
+      munmap( start, head );
+    }
+    munmap( start + head + SLAB_SIZE, SLAB_SIZE - head );
+    slab = start + head;
+    madvise( slab, SLAB_SIZE, MADV_HUGEPAGE ); // only a hint, so failure is harmless
+  } else {
+    hugepages_ = true;
+  }
+
+  slabs_.push_back( slab );
+  char* const base = static_cast<char*>( slab );
+  for ( size_t offset = 0; offset + BUFFER_SIZE <= SLAB_SIZE; offset += BUFFER_SIZE ) {
+    free_.push_back( base + offset );
+  }
+}
+
+size_t PacketPool::slab_count() const
+{
+  const lock_guard lock { mutex_ };
+  return slabs_.size();
+}
+
+bool PacketPool::uses_hugepages() const
+{
+  const lock_guard lock { mutex_ };
+  return hugepages_;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <span>
+#include <string_view>
+#include <vector>
+
+//! \brief A pool of fixed-size packet buffers for datagram I/O
+//! \details Buffers are carved out of 2 MiB slabs, backed by hugepages when the system has them reserved
+//! (and by ordinary pages, with a transparent-hugepage hint, otherwise). Released buffers go to a small
+//! per-thread cache and are handed out again from there, so once the pool has warmed up, acquiring and
+//! releasing a buffer neither allocates nor takes a lock.
+class PacketPool
+{
+public:
+  static constexpr size_t BUFFER_SIZE = 16384;    //!< Capacity of each buffer, in bytes
+  static constexpr size_t SLAB_SIZE = 2UL << 20; //!< Slab size (one 2 MiB hugepage)
+
+  //! Unique owner of one pool buffer; returns the buffer to the pool when destroyed
+  class Handle
+  {
+    char* data_ {};
+    size_t size_ {};
+
+    friend class PacketPool;
+    explicit Handle( char* data ) : data_( data ) {}
+
+  public:
+    Handle() = default;
+    ~Handle();
+
+    Handle( Handle&& other ) noexcept;
+    Handle& operator=( Handle&& other ) noexcept;
+    Handle( const Handle& other ) = delete;
+    Handle& operator=( const Handle& other ) = delete;
+
+    //! The whole buffer, e.g. to read into
+    std::span<char> buffer() { return { data_, data_ ? BUFFER_SIZE : 0 }; }
+
+    //! The bytes in use
+    std::string_view view() const { return { data_, size_ }; }
+    size_t size() const { return size_; }
+    void resize( size_t size );
+
+    explicit operator bool() const { return data_ != nullptr; }
+  };
+
+  //! The process-wide pool (never destroyed, so handles may be released at any point during exit)
+  static PacketPool& global();
+
+  //! Take a buffer from the pool, growing it by a slab if every buffer is in use
+  Handle acquire();
+
+  //! \name Statistics
+  //!@{
+  size_t slab_count() const;
+  bool uses_hugepages() const;
+  //!@}
+
+  PacketPool( const PacketPool& other ) = delete;
+  PacketPool& operator=( const PacketPool& other ) = delete;
+  PacketPool( PacketPool&& other ) = delete;
+  PacketPool& operator=( PacketPool&& other ) = delete;
+  ~PacketPool() = default;
+
+private:
+  PacketPool() = default;
+
+  //! Cache of free buffers owned by one thread
+  struct ThreadCache
+  {
+    static constexpr size_t BATCH = 32; //!< Buffers moved between the cache and the shared free list at once
+    std::vector<char*> buffers {};
+    ~ThreadCache();
+  };
+  static ThreadCache* thread_cache();
+
+  void release( char* data );
+  void refill( ThreadCache& cache );
+  void drain( ThreadCache& cache, size_t keep );
+  void add_slab(); // requires mutex_ to be held
+
+  mutable std::mutex mutex_ {};
+  std::vector<char*> free_ {};
+  std::vector<void*> slabs_ {};
+  bool hugepages_ {};
+};
@@ -1,10 +1,12 @@
 #pragma once
 
+#include "checksum.hh"
+
 #include <algorithm>
 #include <concepts>
 #include <cstdint>
 #include <cstring>
-#include <deque>
+#include <endian.h>
 #include <numeric>
 #include <span>
 #include <stdexcept>
@@ -14,15 +16,19 @@
 
 class Parser
 {
+  // A non-owning view of the input buffers. The caller keeps the underlying bytes alive (and unchanged)
+  // for as long as the Parser is in use, so parsing never copies the input.
   class BufferList
   {
     uint64_t size_ {};
-    std::deque<std::string> buffer_ {};
-    uint64_t skip_ {};
+    std::vector<std::string_view> buffer_ {};
+    size_t front_ {};
 
   public:
-    explicit BufferList( const std::vector<std::string>& buffers )
+    template<class S>
+    explicit BufferList( std::span<const S> buffers )
     {
+      buffer_.reserve( buffers.size() );
       for ( const auto& x : buffers ) {
         append( x );
       }
@@ -34,22 +40,22 @@ class Parser
 
     std::string_view peek() const
     {
-      if ( buffer_.empty() ) {
+      if ( front_ == buffer_.size() ) {
         throw std::runtime_error( "peek on empty BufferList" );
       }
-      return std::string_view { buffer_.front() }.substr( skip_ );
+      return buffer_[front_];
     }
 
     void remove_prefix( uint64_t len )
     {
-      while ( len and not buffer_.empty() ) {
-        const uint64_t to_pop_now = std::min( len, peek().size() );
-        skip_ += to_pop_now;
+      while ( len and front_ != buffer_.size() ) {
+        auto& view = buffer_[front_];
+        const uint64_t to_pop_now = std::min( len, static_cast<uint64_t>( view.size() ) );
+        view.remove_prefix( to_pop_now );
         len -= to_pop_now;
         size_ -= to_pop_now;
-        if ( skip_ == buffer_.front().size() ) {
-          buffer_.pop_front();
-          skip_ = 0;
+        if ( view.empty() ) {
+          ++front_;
         }
       }
     }
@@ -57,54 +63,42 @@ class Parser
     void dump_all( std::vector<std::string>& out )
     {
       out.clear();
-      if ( empty() ) {
-        return;
-      }
-      std::string first_str = std::move( buffer_.front() );
-      if ( skip_ ) {
-        first_str = first_str.substr( skip_ );
-      }
-      out.emplace_back( std::move( first_str ) );
-      buffer_.pop_front();
-      for ( auto&& x : buffer_ ) {
-        out.emplace_back( std::move( x ) );
+      out.reserve( buffer_.size() - front_ );
+      for ( ; front_ != buffer_.size(); ++front_ ) {
+        out.emplace_back( buffer_[front_] );
       }
+      size_ = 0;
     }
 
     void dump_all( std::string& out )
     {
-      std::vector<std::string> concat;
-      dump_all( concat );
-      if ( concat.size() == 1 ) {
-        out = std::move( concat.front() );
-        return;
-      }
-
       out.clear();
-      for ( const auto& s : concat ) {
-        out.append( s );
+      out.reserve( size_ );
+      for ( ; front_ != buffer_.size(); ++front_ ) {
+        out.append( buffer_[front_] );
       }
+      size_ = 0;
+    }
+
+    void dump_all( std::vector<std::string_view>& out )
+    {
+      out.assign( buffer_.begin() + static_cast<ptrdiff_t>( front_ ), buffer_.end() );
+      front_ = buffer_.size();
+      size_ = 0;
     }
 
     std::vector<std::string_view> buffer() const
     {
-      if ( empty() ) {
-        return {};
-      }
-      std::vector<std::string_view> ret;
-      ret.reserve( buffer_.size() );
-      auto tmp_skip = skip_;
-      for ( const auto& x : buffer_ ) {
-        ret.push_back( std::string_view { x }.substr( tmp_skip ) );
-        tmp_skip = 0;
-      }
-      return ret;
+      return { buffer_.begin() + static_cast<ptrdiff_t>( front_ ), buffer_.end() };
     }
 
-    void append( std::string str )
+    void append( std::string_view str )
     {
+      if ( str.empty() ) {
+        return;
+      }
       size_ += str.size();
-      buffer_.push_back( std::move( str ) );
+      buffer_.push_back( str );
     }
   };
 
@@ -118,8 +112,28 @@ class Parser
     }
   }
 
+  template<std::unsigned_integral T>
+  static T from_big_endian( T raw )
+  {
+    if constexpr ( sizeof( T ) == 1 ) {
+      return raw;
+    } else if constexpr ( sizeof( T ) == 2 ) {
+      return be16toh( raw );
+    } else if constexpr ( sizeof( T ) == 4 ) {
+      return be32toh( raw );
+    } else {
+      static_assert( sizeof( T ) == 8 );
+      return be64toh( raw );
+    }
+  }
+
 public:
-  explicit Parser( const std::vector<std::string>& input ) : input_( input ) {}
+  explicit Parser( const std::vector<std::string>& input ) : input_( std::span { input } ) {}
+  explicit Parser( std::span<const std::string_view> input ) : input_( input ) {}
+  explicit Parser( std::string_view input ) : input_( std::span<const std::string_view> { &input, 1 } ) {}
+
+  // The Parser only refers to its input, so it must not outlive it
+  explicit Parser( std::vector<std::string>&& input ) = delete;
 
   const BufferList& input() const { return input_; }
 
@@ -135,17 +149,21 @@ public:
       return;
     }
 
-    if constexpr ( sizeof( T ) == 1 ) {
-      out = static_cast<uint8_t>( input_.peek().front() );
-      input_.remove_prefix( 1 );
+    // Common case: the whole integer lies in one buffer, so load it at once and fix the byte order
+    const auto view = input_.peek();
+    if ( view.size() >= sizeof( T ) ) {
+      T raw {};
+      std::memcpy( &raw, view.data(), sizeof( T ) );
+      out = from_big_endian( raw );
+      input_.remove_prefix( sizeof( T ) );
       return;
-    } else {
-      out = static_cast<T>( 0 );
-      for ( size_t i = 0; i < sizeof( T ); i++ ) {
-        out <<= 8;
-        out |= static_cast<uint8_t>( input_.peek().front() );
-        input_.remove_prefix( 1 );
-      }
+    }
+
+    out = static_cast<T>( 0 );
+    for ( size_t i = 0; i < sizeof( T ); i++ ) {
+      out <<= 8;
+      out |= static_cast<uint8_t>( input_.peek().front() );
+      input_.remove_prefix( 1 );
     }
   }
 
@@ -166,6 +184,9 @@ public:
 
   void all_remaining( std::vector<std::string>& out ) { input_.dump_all( out ); }
   void all_remaining( std::string& out ) { input_.dump_all( out ); }
+
+  // Hand out the rest of the input without copying (the views are only valid while the input is)
+  void all_remaining( std::vector<std::string_view>& out ) { input_.dump_all( out ); }
   std::vector<std::string_view> buffer() const { return input_.buffer(); }
 };
 
@@ -174,15 +195,30 @@ class Serializer
   std::vector<std::string> output_ {};
   std::string buffer_ {};
 
+  // When set, integers are written in place into this fixed-size region (e.g. a PacketBuffer's headroom)
+  std::span<char> region_ {};
+  size_t region_used_ {};
+
 public:
   Serializer() = default;
   explicit Serializer( std::string&& buffer ) : buffer_( std::move( buffer ) ) {}
+  explicit Serializer( std::span<char> region ) : region_( region ) {}
 
   template<std::unsigned_integral T>
   void integer( const T val )
   {
     constexpr uint64_t len = sizeof( T );
 
+    if ( region_.data() ) {
+      if ( region_used_ + len > region_.size() ) {
+        throw std::runtime_error( "Serializer: in-place region is too small" );
+      }
+      for ( uint64_t i = 0; i < len; ++i ) {
+        region_[region_used_++] = static_cast<char>( static_cast<uint8_t>( val >> ( ( len - i - 1 ) * 8 ) ) );
+      }
+      return;
+    }
+
     for ( uint64_t i = 0; i < len; ++i ) {
       const uint8_t byte_val = val >> ( ( len - i - 1 ) * 8 );
       buffer_.push_back( byte_val );
@@ -191,6 +227,9 @@ public:
 
   void buffer( std::string buf )
   {
+    if ( region_.data() ) {
+      throw std::runtime_error( "Serializer: buffers cannot be written in place" );
+    }
     flush();
     if ( not buf.empty() ) {
       output_.push_back( std::move( buf ) );
@@ -217,6 +256,105 @@ public:
     flush();
     return output_;
   }
+
+  // Take the output out of the Serializer instead of copying it
+  std::vector<std::string> release()
+  {
+    flush();
+    return std::move( output_ );
+  }
+
+  // Number of bytes written in place so far
+  size_t region_used() const { return region_used_; }
+};
+
+// A packet under construction in one contiguous buffer, with headroom reserved in front of the payload.
+// Each lower layer (TCP, then IPv4, then Ethernet) writes its header in place in front of what is already
+// there, so the payload is copied once and the finished packet can be handed to write() as a single region.
+class PacketBuffer
+{
+  std::string owned_ {};
+  std::span<char> storage_;
+  bool external_;
+  size_t head_;
+  size_t tail_;
+
+public:
+  // Build the packet in a buffer of its own
+  explicit PacketBuffer( const size_t headroom, const size_t payload_capacity = 0 )
+    : owned_( headroom + payload_capacity, 0 )
+    , storage_( owned_ )
+    , external_( false )
+    , head_( headroom )
+    , tail_( headroom )
+  {}
+
+  // Build the packet in memory owned by someone else (e.g. a PacketPool buffer), which must outlive it
+  PacketBuffer( std::span<char> storage, const size_t headroom )
+    : storage_( storage ), external_( true ), head_( headroom ), tail_( headroom )
+  {
+    if ( headroom > storage.size() ) {
+      throw std::runtime_error( "PacketBuffer: headroom exceeds storage" );
+    }
+  }
+
+  // Refers to its own storage, so it can be neither copied nor moved
+  PacketBuffer( const PacketBuffer& other ) = delete;
+  PacketBuffer& operator=( const PacketBuffer& other ) = delete;
+  PacketBuffer( PacketBuffer&& other ) = delete;
+  PacketBuffer& operator=( PacketBuffer&& other ) = delete;
+  ~PacketBuffer() = default;
+
+  // Append bytes at the end of the packet
+  void append( std::string_view data ) { std::copy( data.begin(), data.end(), extend( data.size() ) ); }
+
+  // Append bytes at the end of the packet, adding them to `checksum` as they are copied
+  void append( std::string_view data, InternetChecksum& checksum )
+  {
+    checksum.add_and_copy( data, extend( data.size() ) );
+  }
+
+  // Claim `len` bytes of headroom directly in front of the packet
+  std::span<char> prepend( const size_t len )
+  {
+    if ( len > head_ ) {
+      throw std::runtime_error( "PacketBuffer: not enough headroom" );
+    }
+    head_ -= len;
+    return storage_.subspan( head_, len );
+  }
+
+  // Serialize a header of exactly `len` bytes into the headroom directly in front of the packet
+  template<class T>
+  void prepend( const T& header, const size_t len )
+  {
+    Serializer s { prepend( len ) };
+    header.serialize( s );
+    if ( s.region_used() != len ) {
+      throw std::runtime_error( "PacketBuffer: header did not fill its region" );
+    }
+  }
+
+  size_t headroom() const { return head_; }
+  size_t size() const { return tail_ - head_; }
+  std::string_view view() const { return { storage_.data() + head_, size() }; }
+  std::span<char> mutable_view() { return storage_.subspan( head_, size() ); }
+
+private:
+  // Grow the packet by `len` bytes at the end, returning where they go
+  char* extend( const size_t len )
+  {
+    if ( tail_ + len > storage_.size() ) {
+      if ( external_ ) {
+        throw std::runtime_error( "PacketBuffer: out of space" );
+      }
+      owned_.resize( tail_ + len );
+      storage_ = owned_;
+    }
+    char* const ret = storage_.data() + tail_;
+    tail_ += len;
+    return ret;
+  }
 };
 
 // Helper to serialize any object (without constructing a Serializer of the caller's own)
@@ -225,7 +363,7 @@ std::vector<std::string> serialize( const T& obj )
 {
   Serializer s;
   obj.serialize( s );
-  return s.output();
+  return s.release();
 }
 
 // Helper to parse any object (without constructing a Parser of the caller's own). Returns true if successful.
@@ -236,3 +374,12 @@ bool parse( T& obj, const std::vector<std::string>& buffers, Targs&&... Fargs )
   obj.parse( p, std::forward<Targs>( Fargs )... );
   return not p.has_error();
 }
+
+// Helper to parse any object directly from a contiguous buffer. Returns true if successful.
+template<class T, typename... Targs>
+bool parse( T& obj, std::string_view buffer, Targs&&... Fargs )
+{
+  Parser p { buffer };
+  obj.parse( p, std::forward<Targs>( Fargs )... );
+  return not p.has_error();
+}
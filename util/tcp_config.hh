@@ -16,19 +16,62 @@ public:
   static constexpr uint16_t TIMEOUT_DFLT = 1000;    //!< Default re-transmit timeout is 1 second
   static constexpr unsigned MAX_RETX_ATTEMPTS = 8;  //!< Maximum re-transmit attempts before giving up
 
-  uint16_t rt_timeout = TIMEOUT_DFLT;      //!< Initial value of the retransmission timeout, in milliseconds
-  size_t recv_capacity = DEFAULT_CAPACITY; //!< Receive capacity, in bytes
-  size_t send_capacity = DEFAULT_CAPACITY; //!< Sender capacity, in bytes
-  Wrap32 isn { 137 };                      //!< Default initial sequence number
+  //! When the sender may send a segment with less than MAX_PAYLOAD_SIZE bytes of data (a segment that closes the
+  //! stream, or carries bytes the application has flushed with Writer::flush, may always be sent)
+  enum class SendPolicy
+  {
+    NoDelay,  //!< Whenever there is data to send
+    Nagle,    //!< Only while nothing is in flight (RFC 896)
+    AutoCork, //!< Only while nothing is in flight, or once the data has been held back for cork_ms
+  };
+
+  uint16_t rt_timeout = TIMEOUT_DFLT;           //!< Initial (and least) retransmission timeout, in milliseconds
+  size_t recv_capacity = DEFAULT_CAPACITY;      //!< Receive capacity, in bytes
+  size_t send_capacity = DEFAULT_CAPACITY;      //!< Sender capacity, in bytes
+  Wrap32 isn { 137 };                           //!< Default initial sequence number
+  SendPolicy send_policy = SendPolicy::NoDelay; //!< When to send less than a full segment
+  uint16_t cork_ms = 10;                        //!< Longest time SendPolicy::AutoCork holds data back
+  uint16_t ack_delay_ms = 40;                   //!< Longest delay of an acknowledgment, in ms (0: never delay)
+  bool timestamps = true;                       //!< Offer the timestamps option (RFC 7323) on the SYN
+  bool adaptive_rto = true;                     //!< Derive the RTO from measured round trips (RFC 6298)
+  bool rack_tlp = true;                         //!< Detect losses by time and probe for lost tails (RFC 8985)
+  bool pacing = false;                          //!< Spread segments out in time instead of sending back to back
+  uint64_t pacing_rate = 0;                     //!< Bytes per second to pace at (0: 1.25 peer windows per SRTT)
 };
 
 //! Config for classes derived from FdAdapter
 class FdAdapterConfig
 {
 public:
-  Address source { "0", 0 };      //!< Source address and port
-  Address destination { "0", 0 }; //!< Destination address and port
+  IPv4Endpoint source {};      //!< Source address and port
+  IPv4Endpoint destination {}; //!< Destination address and port
 
   uint16_t loss_rate_dn = 0; //!< Downlink loss rate (for LossyFdAdapter)
   uint16_t loss_rate_up = 0; //!< Uplink loss rate (for LossyFdAdapter)
 };
+
+//! Config for EmulatedFdAdapter: the link it imposes on outgoing datagrams (the defaults impose nothing)
+class EmulationConfig
+{
+public:
+  uint64_t delay_ms = 0;  //!< One-way propagation delay, in milliseconds
+  uint64_t jitter_ms = 0; //!< Each datagram's delay varies uniformly by up to this much either way
+
+  uint64_t rate_bytes_per_s = 0;  //!< Bottleneck rate (token-bucket fill rate); 0 means unlimited
+  size_t bucket_bytes = 3000;     //!< Token-bucket depth, i.e. the largest burst sent at once
+  size_t queue_bytes = 64 * 1024; //!< Bottleneck queue size; datagrams that don't fit are dropped
+
+  double reorder_probability = 0;   //!< Chance a datagram skips the delay line, overtaking those ahead of it
+  double duplicate_probability = 0; //!< Chance a datagram is sent twice
+
+  //! \name Gilbert-Elliott loss: a two-state Markov chain, stepped once per datagram, with its own loss rate in
+  //! each state. The defaults never leave the good state and never lose anything.
+  //!@{
+  double good_to_bad = 0; //!< Probability of moving from the good state to the bad state
+  double bad_to_good = 1; //!< Probability of moving from the bad state back to the good state
+  double loss_good = 0;   //!< Loss probability in the good state
+  double loss_bad = 1;    //!< Loss probability in the bad state
+  //!@}
+
+  uint64_t seed = 0; //!< Random seed, for reproducible runs (0 means seed randomly)
+};
@@ -6,10 +6,12 @@
 #include "socket.hh"
 #include "tcp_config.hh"
 #include "tcp_peer.hh"
+#include "tcp_stats.hh"
 #include "tuntap_adapter.hh"
 
 #include <atomic>
 #include <cstdint>
+#include <mutex>
 #include <optional>
 #include <thread>
 #include <vector>
@@ -56,7 +58,11 @@ public:
   //!@}
 
   // Return peer address from underlying datagram adapter
-  const Address& peer_address() const { return _datagram_adapter.config().destination; }
+  Address peer_address() const { return _datagram_adapter.config().destination.to_address(); }
+
+  //! A snapshot of the connection's statistics, refreshed whenever the TCPPeer thread handles an event
+  //! (after the connection ends, the last snapshot taken)
+  TCPStats stats() const;
 
 protected:
   //! Adapter to underlying datagram socket (e.g., UDP or IP)
@@ -72,6 +78,9 @@ private:
   //! TCP state machine
   std::optional<TCPPeer> _tcp {};
 
+  //! Segments read from the network in one wakeup, to be given to the TCPPeer together
+  std::vector<TCPMessage> _received {};
+
   //! eventloop that handles all the events (new inbound datagram, new outbound bytes, new inbound bytes)
   EventLoop _eventloop {};
 
@@ -94,10 +103,15 @@ private:
   bool _outbound_shutdown { false }; //!< Has the owner shut down the outbound data to the TCP connection?
 
   bool _fully_acked { false }; //!< Has the outbound data been fully acknowledged by the peer?
+
+  mutable std::mutex _stats_mutex {}; //!< Protects _stats, which the owner reads while the TCPPeer thread writes
+  TCPStats _stats {};                 //!< Latest snapshot of the TCPPeer's statistics
 };
 
 using TCPOverIPv4MinnowSocket = TCPMinnowSocket<TCPOverIPv4OverTunFdAdapter>;
 using LossyTCPOverIPv4MinnowSocket = TCPMinnowSocket<LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>>;
+using EmulatedTCPOverIPv4MinnowSocket
+  = TCPMinnowSocket<EmulatedFdAdapter<LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>>>;
 
 //! \class TCPMinnowSocket
 //! This class involves the simultaneous operation of two threads.
@@ -130,8 +144,8 @@ public:
     tcp_config.rt_timeout = 100;
 
     FdAdapterConfig multiplexer_config;
-    multiplexer_config.source = { "169.254.144.9", std::to_string( uint16_t( std::random_device()() ) ) };
-    multiplexer_config.destination = address;
+    multiplexer_config.source = IPv4Endpoint { Address { "169.254.144.9", uint16_t( std::random_device()() ) } };
+    multiplexer_config.destination = IPv4Endpoint { address };
 
     TCPOverIPv4MinnowSocket::connect( tcp_config, multiplexer_config );
   }
@@ -4,6 +4,7 @@
 #include "parser.hh"
 #include "tun.hh"
 
+#include <algorithm>
 #include <cstddef>
 #include <exception>
 #include <iostream>
@@ -16,6 +17,7 @@
 #include <utility>
 
 static constexpr size_t TCP_TICK_MS = 10;
+static constexpr size_t TCP_RECEIVE_BATCH = 32; //!< Most datagrams read from the network per wakeup
 
 inline uint64_t timestamp_ms()
 {
@@ -30,7 +32,12 @@ void TCPMinnowSocket<AdaptT>::_tcp_loop( const std::function<bool()>& condition
 {
   auto base_time = timestamp_ms();
   while ( condition() ) {
-    auto ret = _eventloop.wait_next_event( TCP_TICK_MS );
+    // wake up early if pacing is holding back a segment that is due before the next tick
+    size_t timeout_ms = TCP_TICK_MS;
+    if ( _tcp.has_value() ) {
+      timeout_ms = std::min<size_t>( timeout_ms, _tcp->pacing_delay_ms().value_or( TCP_TICK_MS ) );
+    }
+    auto ret = _eventloop.wait_next_event( static_cast<int>( timeout_ms ) );
     if ( ret == EventLoop::Result::Exit or _abort ) {
       break;
     }
@@ -45,6 +52,9 @@ void TCPMinnowSocket<AdaptT>::_tcp_loop( const std::function<bool()>& condition
       _datagram_adapter.tick( next_time - base_time );
       base_time = next_time;
     }
+
+    const std::scoped_lock lock { _stats_mutex };
+    _stats = _tcp->stats();
   }
 }
 
@@ -86,14 +96,19 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
     _datagram_adapter.fd(),
     Direction::In,
     [&] {
-      if ( auto seg = _datagram_adapter.read() ) {
-        _tcp->receive( std::move( seg.value() ), [&]( auto x ) { _datagram_adapter.write( x ); } );
+      // the datagrams waiting get one reply between them
+      _received.clear();
+      _datagram_adapter.read_batch( _received, TCP_RECEIVE_BATCH );
+      if ( not _received.empty() ) {
+        _tcp->receive_batch( _received, [&]( auto x ) { _datagram_adapter.write( x ); } );
+
+        // an acknowledgment may have opened the window for data that is already buffered (if the buffer is
+        // full, rule 2 won't run to push it)
+        _tcp->push( [&]( auto x ) { _datagram_adapter.write( x ); } );
       }
 
-      // debugging output:
       if ( _thread_data.eof() and _tcp.value().sender().sequence_numbers_in_flight() == 0 and not _fully_acked ) {
-        std::cerr << "DEBUG: minnow outbound stream to " << _datagram_adapter.config().destination.to_string()
-                  << " has been fully acknowledged.\n";
+        Trace::record( TraceEvent::OutboundAcked );
         _fully_acked = true;
       }
     },
@@ -113,12 +128,7 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
       if ( _thread_data.eof() ) {
         _tcp->outbound_writer().close();
         _outbound_shutdown = true;
-
-        // debugging output:
-        std::cerr << "DEBUG: minnow outbound stream to " << _datagram_adapter.config().destination.to_string()
-                  << " finished (" << _tcp.value().sender().sequence_numbers_in_flight() << " seqno"
-                  << ( _tcp.value().sender().sequence_numbers_in_flight() == 1 ? "" : "s" )
-                  << " still in flight).\n";
+        Trace::record( TraceEvent::OutboundClosed, 0, _tcp.value().sender().sequence_numbers_in_flight() );
       }
 
       _tcp->push( [&]( auto x ) { _datagram_adapter.write( x ); } );
@@ -132,7 +142,7 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
       _outbound_shutdown = true;
     },
     [&] {
-      std::cerr << "DEBUG: minnow outbound stream had error.\n";
+      Trace::record( TraceEvent::StreamError, 0, 0, 0, 0 );
       _tcp->outbound_writer().set_error();
     } );
 
@@ -150,15 +160,15 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
         const std::string_view buffer = inbound.peek();
         const auto bytes_written = _thread_data.write( buffer );
         inbound.pop( bytes_written );
+
+        // reading may have reopened a window the peer is waiting on
+        _tcp->update_window( [&]( auto x ) { _datagram_adapter.write( x ); } );
       }
 
       if ( inbound.is_finished() or inbound.has_error() ) {
         _thread_data.shutdown( SHUT_WR );
         _inbound_shutdown = true;
-
-        // debugging output:
-        std::cerr << "DEBUG: minnow inbound stream from " << _datagram_adapter.config().destination.to_string()
-                  << " finished " << ( inbound.has_error() ? "uncleanly.\n" : "cleanly.\n" );
+        Trace::record( TraceEvent::InboundFinished, 0, 0, 0, inbound.has_error() );
       }
     },
     [&] {
@@ -168,11 +178,18 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
     },
     [&] {},
     [&] {
-      std::cerr << "DEBUG: minnow inbound stream had error.\n";
+      Trace::record( TraceEvent::StreamError, 0, 0, 0, 1 );
       _tcp->inbound_reader().set_error();
     } );
 }
 
+template<TCPDatagramAdapter AdaptT>
+TCPStats TCPMinnowSocket<AdaptT>::stats() const
+{
+  const std::scoped_lock lock { _stats_mutex };
+  return _stats;
+}
+
 //! \brief Call [socketpair](\ref man2::socketpair) and return connected Unix-domain sockets of specified type
 //! \param[in] type is the type of AF_UNIX sockets to create (e.g., SOCK_SEQPACKET)
 //! \returns a std::pair of connected sockets
@@ -211,9 +228,8 @@ void TCPMinnowSocket<AdaptT>::wait_until_closed()
 {
   shutdown( SHUT_RDWR );
   if ( _tcp_thread.joinable() ) {
-    std::cerr << "DEBUG: minnow waiting for clean shutdown... ";
+    Trace::record( TraceEvent::Closing );
     _tcp_thread.join();
-    std::cerr << "done.\n";
   }
 }
 
@@ -230,7 +246,7 @@ void TCPMinnowSocket<AdaptT>::connect( const TCPConfig& c_tcp, const FdAdapterCo
 
   _datagram_adapter.config_mut() = c_ad;
 
-  std::cerr << "DEBUG: minnow connecting to " << c_ad.destination.to_string() << "...\n";
+  Trace::record( TraceEvent::Connecting, c_ad.destination.ip, c_ad.destination.port );
 
   if ( not _tcp.has_value() ) {
     throw std::runtime_error( "TCPPeer not successfully initialized" );
@@ -243,11 +259,8 @@ void TCPMinnowSocket<AdaptT>::connect( const TCPConfig& c_tcp, const FdAdapterCo
   }
 
   _tcp_loop( [&] { return _tcp->sender().sequence_numbers_in_flight() == 1; } );
-  if ( _tcp->inbound_reader().has_error() ) {
-    std::cerr << "DEBUG: minnow error on connecting to " << c_ad.destination.to_string() << ".\n";
-  } else {
-    std::cerr << "DEBUG: minnow successfully connected to " << c_ad.destination.to_string() << ".\n";
-  }
+  Trace::record(
+    TraceEvent::Connected, c_ad.destination.ip, c_ad.destination.port, 0, _tcp->inbound_reader().has_error() );
 
   _tcp_thread = std::thread( &TCPMinnowSocket::_tcp_main, this );
 }
@@ -266,9 +279,10 @@ void TCPMinnowSocket<AdaptT>::listen_and_accept( const TCPConfig& c_tcp, const F
   _datagram_adapter.config_mut() = c_ad;
   _datagram_adapter.set_listening( true );
 
-  std::cerr << "DEBUG: minnow listening for incoming connection...\n";
+  Trace::record( TraceEvent::Listening );
   _tcp_loop( [&] { return ( not _tcp->has_ackno() ) or ( _tcp->sender().sequence_numbers_in_flight() ); } );
-  std::cerr << "DEBUG: minnow new connection from " << _datagram_adapter.config().destination.to_string() << ".\n";
+  const auto& peer = _datagram_adapter.config().destination;
+  Trace::record( TraceEvent::Accepted, peer.ip, peer.port );
 
   _tcp_thread = std::thread( &TCPMinnowSocket::_tcp_main, this );
 }
@@ -283,8 +297,7 @@ void TCPMinnowSocket<AdaptT>::_tcp_main()
     _tcp_loop( [] { return true; } );
     shutdown( SHUT_RDWR );
     if ( not _tcp.value().active() ) {
-      std::cerr << "DEBUG: minnow TCP connection finished "
-                << ( _tcp->inbound_reader().has_error() ? "uncleanly.\n" : "cleanly.\n" );
+      Trace::record( TraceEvent::ConnectionEnded, 0, 0, 0, _tcp->inbound_reader().has_error() );
     }
     _tcp.reset();
   } catch ( const std::exception& e ) {
@@ -24,40 +24,60 @@ using namespace std;
 //! from the TCP header; it uses this information to filter future reads.
 //! \returns a std::optional<TCPSegment> that is empty if the segment was invalid or unrelated
 optional<TCPMessage> TCPOverIPv4Adapter::unwrap_tcp_in_ip( const InternetDatagram& ip_dgram )
+{
+  Parser payload { ip_dgram.payload };
+  return unwrap_tcp_in_ip( ip_dgram.header, payload );
+}
+
+//! \details Parses the IPv4 header and then the TCP segment from the same serialized datagram, without
+//! materializing the IPv4 payload in between.
+//! \returns a std::optional<TCPSegment> that is empty if the datagram or segment was invalid or unrelated
+optional<TCPMessage> TCPOverIPv4Adapter::unwrap_tcp_in_ip( const string_view ip_dgram )
+{
+  Parser parser { ip_dgram };
+  IPv4Header header;
+  header.parse( parser );
+  if ( parser.has_error() ) {
+    return {};
+  }
+  return unwrap_tcp_in_ip( header, parser );
+}
+
+optional<TCPMessage> TCPOverIPv4Adapter::unwrap_tcp_in_ip( const IPv4Header& ip_header, Parser& ip_payload )
 {
   // is the IPv4 datagram for us?
   // Note: it's valid to bind to address "0" (INADDR_ANY) and reply from actual address contacted
-  if ( not listening() and ( ip_dgram.header.dst != config().source.ipv4_numeric() ) ) {
+  if ( not listening() and ( ip_header.dst != config().source.ip ) ) {
     return {};
   }
 
   // is the IPv4 datagram from our peer?
-  if ( not listening() and ( ip_dgram.header.src != config().destination.ipv4_numeric() ) ) {
+  if ( not listening() and ( ip_header.src != config().destination.ip ) ) {
     return {};
   }
 
   // does the IPv4 datagram claim that its payload is a TCP segment?
-  if ( ip_dgram.header.proto != IPv4Header::PROTO_TCP ) {
+  if ( ip_header.proto != IPv4Header::PROTO_TCP ) {
     return {};
   }
 
   // is the payload a valid TCP segment?
   TCPSegment tcp_seg;
-  if ( not parse( tcp_seg, ip_dgram.payload, ip_dgram.header.pseudo_checksum() ) ) {
+  tcp_seg.parse( ip_payload, ip_header.pseudo_checksum() );
+  if ( ip_payload.has_error() ) {
     return {};
   }
 
   // is the TCP segment for us?
-  if ( tcp_seg.udinfo.dst_port != config().source.port() ) {
+  if ( tcp_seg.udinfo.dst_port != config().source.port ) {
     return {};
   }
 
   // should we target this source addr/port (and use its destination addr as our source) in reply?
   if ( listening() ) {
     if ( tcp_seg.message.sender.SYN and not tcp_seg.message.sender.RST ) {
-      config_mutable().source = Address { inet_ntoa( { htobe32( ip_dgram.header.dst ) } ), config().source.port() };
-      config_mutable().destination
-        = Address { inet_ntoa( { htobe32( ip_dgram.header.src ) } ), tcp_seg.udinfo.src_port };
+      config_mutable().source = { ip_header.dst, config().source.port };
+      config_mutable().destination = { ip_header.src, tcp_seg.udinfo.src_port };
       set_listening( false );
     } else {
       return {};
@@ -65,32 +85,66 @@ optional<TCPMessage> TCPOverIPv4Adapter::unwrap_tcp_in_ip( const InternetDatagra
   }
 
   // is the TCP segment from our peer?
-  if ( tcp_seg.udinfo.src_port != config().destination.port() ) {
+  if ( tcp_seg.udinfo.src_port != config().destination.port ) {
     return {};
   }
 
-  return tcp_seg.message;
+  return std::move( tcp_seg.message );
 }
 
 //! Takes a TCP segment, sets port numbers as necessary, and wraps it in an IPv4 datagram
 //! \param[in] seg is the TCP segment to convert
 InternetDatagram TCPOverIPv4Adapter::wrap_tcp_in_ip( const TCPMessage& msg )
 {
-  TCPSegment seg { .message = msg };
-  // set the port numbers in the TCP segment
-  seg.udinfo.src_port = config().source.port();
-  seg.udinfo.dst_port = config().destination.port();
+  TCPSegment seg = make_segment( msg );
 
   // create an Internet Datagram and set its addresses and length
   InternetDatagram ip_dgram;
-  ip_dgram.header.src = config().source.ipv4_numeric();
-  ip_dgram.header.dst = config().destination.ipv4_numeric();
-  ip_dgram.header.len = ip_dgram.header.hlen * 4 + 20 /* tcp header len */ + seg.message.sender.payload.size();
+  ip_dgram.header = make_header( seg, seg.message.sender.payload.size() );
+
+  ip_dgram.header.compute_checksum();
 
   // set payload, calculating TCP checksum using information from IP header
   seg.compute_checksum( ip_dgram.header.pseudo_checksum() );
-  ip_dgram.header.compute_checksum();
   ip_dgram.payload = serialize( seg );
 
   return ip_dgram;
 }
+
+//! Takes a TCP segment and writes it, wrapped in an IPv4 datagram, into a packet buffer. The payload is
+//! copied once, and its checksum is computed in the same pass; the TCP and IPv4 headers are written in place
+//! in the buffer's headroom and their checksums patched in afterwards.
+//! \param[in] msg is the TCP message to convert
+//! \param[out] packet is an empty buffer with at least TCPOverIPv4Adapter::HEADROOM bytes of headroom
+void TCPOverIPv4Adapter::wrap_tcp_in_ip( const TCPMessage& msg, PacketBuffer& packet )
+{
+  // the segment only supplies the header fields; the payload is copied straight from `msg`
+  TCPSegment seg = make_segment( { .sender = { .seqno = msg.sender.seqno,
+                                               .SYN = msg.sender.SYN,
+                                               .FIN = msg.sender.FIN,
+                                               .RST = msg.sender.RST,
+                                               .TSval = msg.sender.TSval },
+                                   .receiver = msg.receiver } );
+  IPv4Header header = make_header( seg, msg.sender.payload.size() );
+
+  seg.serialize( packet, msg.sender.payload, header.pseudo_checksum() );
+  header.serialize( packet );
+}
+
+TCPSegment TCPOverIPv4Adapter::make_segment( TCPMessage msg ) const
+{
+  TCPSegment seg { .message = std::move( msg ) };
+  // set the port numbers in the TCP segment
+  seg.udinfo.src_port = config().source.port;
+  seg.udinfo.dst_port = config().destination.port;
+  return seg;
+}
+
+IPv4Header TCPOverIPv4Adapter::make_header( const TCPSegment& seg, const size_t payload_size ) const
+{
+  IPv4Header header;
+  header.src = config().source.ip;
+  header.dst = config().destination.ip;
+  header.len = header.hlen * 4 + seg.header_length() + payload_size;
+  return header;
+}
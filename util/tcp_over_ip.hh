@@ -12,5 +12,21 @@ class TCPOverIPv4Adapter : public FdAdapterBase
 public:
   std::optional<TCPMessage> unwrap_tcp_in_ip( const InternetDatagram& ip_dgram );
 
+  // Same as above, but parses the TCP segment straight out of the serialized datagram, so the
+  // payload is copied exactly once (into the returned message)
+  std::optional<TCPMessage> unwrap_tcp_in_ip( std::string_view ip_dgram );
+
   InternetDatagram wrap_tcp_in_ip( const TCPMessage& msg );
+
+  // Same as above, but writes the finished datagram into `packet`, which must be empty and have
+  // headroom for both the IPv4 and the TCP header
+  void wrap_tcp_in_ip( const TCPMessage& msg, PacketBuffer& packet );
+
+  // Headroom needed in front of the payload for wrap_tcp_in_ip
+  static constexpr size_t HEADROOM = IPv4Header::LENGTH + TCPSegment::MAX_HEADER_LENGTH;
+
+private:
+  std::optional<TCPMessage> unwrap_tcp_in_ip( const IPv4Header& ip_header, Parser& ip_payload );
+  TCPSegment make_segment( TCPMessage msg ) const;
+  IPv4Header make_header( const TCPSegment& seg, size_t payload_size ) const; // checksum left unset
 };
@@ -6,9 +6,14 @@
 #include "tcp_segment.hh"
 #include "tcp_sender.hh"
 #include "tcp_sender_message.hh"
+#include "tcp_stats.hh"
+#include "trace.hh"
 
+#include <algorithm>
+#include <cstdint>
 #include <functional>
 #include <optional>
+#include <span>
 
 class TCPPeer
 {
@@ -32,9 +37,37 @@ public:
   {
     cumulative_time_ += t;
     sender_.tick( t, make_send( transmit ) );
+
+    // A delayed acknowledgment is due, or the application has read enough to open the window by two segments
+    const bool ack_due = ack_deadline_.has_value() and cumulative_time_ >= ack_deadline_.value();
+    const bool window_opened = ack_deadline_.has_value()
+                               and receiver_.send().window_size >= window_sent_ + 2 * TCPConfig::MAX_PAYLOAD_SIZE;
+    if ( ack_due or window_opened ) {
+      send( sender_.make_empty_message(), transmit );
+    }
+    update_window( transmit );
+  }
+
+  /* Advertise a window that the application has opened by reading, if the peer may be held back by the window
+     last advertised and the new one is big enough to be worth sending (receiver-side silly window syndrome
+     avoidance, RFC 1122 4.2.3.3). Otherwise the update would wait for the next segment the peer sends. */
+  void update_window( const TransmitFunction& transmit )
+  {
+    if ( not has_ackno() or receiver_.writer().is_closed() ) {
+      return;
+    }
+    const uint64_t max_window = std::min<uint64_t>( cfg_.recv_capacity, UINT16_MAX );
+    const uint64_t threshold = std::min<uint64_t>( TCPConfig::MAX_PAYLOAD_SIZE, max_window / 2 );
+    if ( 2UL * window_sent_ <= max_window and receiver_.send().window_size >= window_sent_ + threshold ) {
+      stats_.window_updates++;
+      send( sender_.make_empty_message(), transmit );
+    }
   }
   bool has_ackno() const { return receiver_.send().ackno.has_value(); }
 
+  /* How long until pacing lets out a segment it is holding back (none held: nullopt) */
+  std::optional<uint64_t> pacing_delay_ms() const { return sender_.pacing_delay_ms(); }
+
   /* Is the peer still active? */
   bool active() const
   {
@@ -52,12 +85,101 @@ public:
     if ( not active() ) {
       return;
     }
+    absorb( std::move( msg ) );
+    reply( transmit );
+  }
+
+  /* Receive segments that arrived together: each goes through the receiver and sender in turn, and then one
+     reply acknowledges them all (riding on data, if there is any to send). Segments after one that ends the
+     connection are ignored, but those before it are still acknowledged. */
+  void receive_batch( std::span<TCPMessage> msgs, const TransmitFunction& transmit )
+  {
+    for ( auto& msg : msgs ) {
+      if ( not active() ) {
+        break;
+      }
+      absorb( std::move( msg ) );
+    }
+    reply( transmit );
+  }
 
+  /* A snapshot of the connection's statistics */
+  TCPStats stats() const
+  {
+    TCPStats stats = stats_;
+    stats.retransmits = sender_.retransmissions();
+    stats.timeouts = sender_.timeouts();
+    stats.spurious_timeouts = sender_.spurious_timeouts();
+    stats.duplicate_acks = sender_.duplicate_acks();
+    stats.loss_probes = sender_.loss_probes();
+    stats.rto_ms = sender_.current_RTO_ms();
+    stats.srtt_ms = sender_.smoothed_RTT_ms();
+    stats.peer_window = sender_.peer_window();
+    stats.zero_window_ms = sender_.zero_window_ms();
+    stats.reassembler_pending = receiver_.reassembler().bytes_pending();
+    stats.outbound_buffered = sender_.reader().bytes_buffered();
+    stats.outbound_high_water = sender_.reader().max_bytes_buffered();
+    stats.inbound_buffered = receiver_.reader().bytes_buffered();
+    stats.inbound_high_water = receiver_.reader().max_bytes_buffered();
+    return stats;
+  }
+
+  // Testing interface
+  const TCPReceiver& receiver() const { return receiver_; }
+  const TCPSender& sender() const { return sender_; }
+
+private:
+  TCPConfig cfg_;
+  TCPSender sender_ { ByteStream { cfg_.send_capacity }, cfg_ };
+  TCPReceiver receiver_ { Reassembler { ByteStream { cfg_.recv_capacity } } };
+
+  bool need_send_ {};
+  std::optional<uint64_t> ack_deadline_ {}; // when a delayed acknowledgment must go out
+  size_t unacked_bytes_ {};                 // in-order bytes received since the last acknowledgment
+  uint16_t window_sent_ {};                 // the window advertised by the last acknowledgment
+  bool peer_timestamps_ {};                 // both SYNs offered the timestamps option
+  TCPStats stats_ {}; // the traffic counters (the rest of a snapshot comes from the sender and receiver)
+
+  // Take in a received segment, noting whether it needs a reply (now, or by ack_deadline_)
+  void absorb( TCPMessage&& msg )
+  {
     // Record time in case this peer has to linger after streams finish.
     time_of_last_receipt_ = cumulative_time_;
 
-    // If SenderMessage occupies a sequence number, make sure to reply.
-    need_send_ |= ( msg.sender.sequence_length() > 0 );
+    stats_.segments_received++;
+    stats_.bytes_received += msg.sender.payload.size();
+    trace( TraceEvent::SegmentReceived, msg );
+
+    // Timestamps are used only if both SYNs offered them (RFC 7323, section 3.2), and ignored otherwise.
+    if ( msg.sender.SYN ) {
+      peer_timestamps_ = cfg_.timestamps and msg.sender.TSval.has_value();
+    }
+    if ( not peer_timestamps_ ) {
+      msg.sender.TSval.reset();
+      msg.receiver.TSecr.reset();
+    }
+
+    // PAWS (RFC 7323, section 5.3): an old duplicate is acknowledged and otherwise dropped whole, so that its
+    // stale acknowledgment, window and echoed timestamp never reach the sender.
+    if ( not msg.sender.SYN and not msg.sender.RST and receiver_.stale( msg.sender ) ) {
+      need_send_ = true;
+      return;
+    }
+
+    // Header prediction (Van Jacobson): the next segment in order with no flags, whether data that fits in the
+    // window or a bare acknowledgment, goes straight to the stream and the sender, skipping the checks below.
+    if ( receiver_.predicts( msg.sender ) ) {
+      const size_t payload_size = msg.sender.payload.size();
+      receiver_.receive_predicted( std::move( msg.sender ) );
+      if ( payload_size > 0 ) {
+        stats_.predicted_data++;
+        acknowledge( payload_size, false );
+      } else {
+        stats_.predicted_acks++;
+      }
+      sender_.receive( msg.receiver, payload_size > 0 );
+      return;
+    }
 
     // If SenderMessage is a "keep-alive" (with intentionally invalid seqno), make sure to reply.
     // (N.B. orthodox TCP rules require a reply on any unacceptable segment.)
@@ -70,33 +192,83 @@ public:
     }
 
     // Give incoming TCPSenderMessage to receiver.
+    const bool occupies_sequence_space = msg.sender.sequence_length() > 0;
+    const bool syn_or_fin = msg.sender.SYN or msg.sender.FIN;
+    const size_t payload_size = msg.sender.payload.size();
+    const bool filled_gap = receiver_.reassembler().bytes_pending() > 0;
     receiver_.receive( std::move( msg.sender ) );
 
+    // If SenderMessage occupies a sequence number, make sure to reply. Out-of-order data, data that fills a gap,
+    // a SYN or a FIN is acknowledged at once (RFC 5681 4.2).
+    if ( occupies_sequence_space ) {
+      const bool in_order = receiver_.send().ackno != our_ackno;
+      acknowledge( payload_size, syn_or_fin or not in_order or filled_gap );
+    }
+
     // Give incoming TCPReceiverMessage to sender.
-    sender_.receive( msg.receiver );
+    sender_.receive( msg.receiver, occupies_sequence_space );
+  }
+
+  // Acknowledge received sequence space now, or within ack_delay_ms (RFC 1122 4.2.3.2)
+  void acknowledge( const size_t payload_size, const bool at_once )
+  {
+    unacked_bytes_ += payload_size;
+    if ( at_once or cfg_.ack_delay_ms == 0
+         or unacked_bytes_ >= std::min( 2 * TCPConfig::MAX_PAYLOAD_SIZE, cfg_.recv_capacity / 2 ) ) {
+      need_send_ = true;
+    } else if ( not ack_deadline_.has_value() ) {
+      ack_deadline_ = cumulative_time_ + cfg_.ack_delay_ms;
+    }
+  }
 
-    // Send reply if needed.
+  void reply( const TransmitFunction& transmit )
+  {
+    // Send reply if needed: the acknowledgment rides on data if the sender has any to send, and goes out on an
+    // empty segment only if not.
+    if ( need_send_ ) {
+      push( transmit );
+    }
     if ( need_send_ ) {
       send( sender_.make_empty_message(), transmit );
     }
   }
 
-  // Testing interface
-  const TCPReceiver& receiver() const { return receiver_; }
-  const TCPSender& sender() const { return sender_; }
-
-private:
-  TCPConfig cfg_;
-  TCPSender sender_ { ByteStream { cfg_.send_capacity }, cfg_.isn, cfg_.rt_timeout };
-  TCPReceiver receiver_ { Reassembler { ByteStream { cfg_.recv_capacity } } };
-
-  bool need_send_ {};
-
   void send( const TCPSenderMessage& sender_message, const TransmitFunction& transmit )
   {
     TCPMessage msg { sender_message, receiver_.send() };
+    if ( not peer_timestamps_ and not( msg.sender.SYN and not has_ackno() ) ) {
+      msg.sender.TSval.reset(); // offered only on our SYN until the peer's SYN has offered them too
+      msg.receiver.TSecr.reset();
+    }
+    stats_.segments_sent++;
+    stats_.bytes_sent += msg.sender.payload.size();
+    trace( TraceEvent::SegmentSent, msg );
+    window_sent_ = msg.receiver.window_size;
     transmit( std::move( msg ) );
     need_send_ = false;
+    ack_deadline_.reset();
+    unacked_bytes_ = 0;
+  }
+
+  // A trace record holds the seqno and ackno as they are on the wire
+  class TraceableWrap32 : public Wrap32
+  {
+  public:
+    explicit TraceableWrap32( const Wrap32& value ) : Wrap32( value ) {}
+    uint32_t raw_value() const { return raw_value_; }
+  };
+
+  static void trace( TraceEvent event, const TCPMessage& msg )
+  {
+    const uint16_t flags = ( msg.sender.SYN ? TRACE_SYN : 0 ) | ( msg.sender.FIN ? TRACE_FIN : 0 )
+                           | ( msg.sender.RST or msg.receiver.RST ? TRACE_RST : 0 )
+                           | ( msg.receiver.ackno.has_value() ? TRACE_ACK : 0 );
+    const uint64_t ackno = msg.receiver.ackno.has_value() ? TraceableWrap32 { *msg.receiver.ackno }.raw_value() : 0;
+    Trace::record( event,
+                   TraceableWrap32 { msg.sender.seqno }.raw_value(),
+                   msg.sender.payload.size(),
+                   ackno << 32 | msg.receiver.window_size,
+                   flags );
   }
 
   bool linger_after_streams_finish_ { true }; // one peer may need to linger to make sure all closure conditions met
@@ -2,12 +2,13 @@
 
 #include "wrapping_integers.hh"
 
+#include <cstdint>
 #include <optional>
 
 /*
  * The TCPReceiverMessage structure contains the information sent from a TCP receiver to its sender.
  *
- * It contains three fields:
+ * It contains four fields:
  *
  * 1) The acknowledgment number (ackno): the *next* sequence number needed by the TCP Receiver.
  *    This is an optional field that is empty if the TCPReceiver hasn't yet received the Initial Sequence Number.
@@ -17,6 +18,9 @@
  *    the <cstdint> header).
  *
  * 3) The RST (reset) flag. If set, the stream has suffered an error and the connection should be aborted.
+ *
+ * 4) The timestamp echo reply (TSecr, RFC 7323), if the peer uses timestamps: the TSval of the latest
+ *    in-order segment received from the peer.
  */
 
 struct TCPReceiverMessage
@@ -24,4 +28,5 @@ struct TCPReceiverMessage
   std::optional<Wrap32> ackno {};
   uint16_t window_size {};
   bool RST {};
+  std::optional<uint32_t> TSecr {};
 };
@@ -2,10 +2,19 @@
 #include "checksum.hh"
 #include "wrapping_integers.hh"
 
+#include <array>
 #include <cstddef>
+#include <span>
+#include <stdexcept>
 
 static constexpr uint32_t TCPHeaderMinLen = 5; // 32-bit words
 
+// TCP option kinds (RFC 9293 and RFC 7323)
+static constexpr uint8_t TCPOptionEnd = 0;
+static constexpr uint8_t TCPOptionNOP = 1;
+static constexpr uint8_t TCPOptionTimestamps = 8;
+static constexpr uint8_t TCPOptionTimestampsLen = 10;
+
 using namespace std;
 
 void TCPSegment::parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum )
@@ -47,15 +56,53 @@ void TCPSegment::parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum
   parser.integer( udinfo.cksum );
   parser.integer( raw16 ); // urgent pointer
 
-  // skip any options or anything extra in the header
   if ( data_offset < TCPHeaderMinLen ) {
     parser.set_error();
+    return;
   }
-  parser.remove_prefix( data_offset * 4 - TCPHeaderMinLen * 4 );
+  parse_options( parser, data_offset * 4 - TCPHeaderMinLen * 4 );
 
   parser.all_remaining( message.sender.payload );
 }
 
+// Read the timestamps option, and skip any other
+void TCPSegment::parse_options( Parser& parser, size_t options_length )
+{
+  while ( options_length > 0 and not parser.has_error() ) {
+    uint8_t kind {};
+    parser.integer( kind );
+    options_length--;
+    if ( kind == TCPOptionEnd ) {
+      break;
+    }
+    if ( kind == TCPOptionNOP ) {
+      continue;
+    }
+
+    uint8_t length {};
+    parser.integer( length );
+    if ( length < 2 or length - 1U > options_length ) {
+      parser.set_error();
+      return;
+    }
+    options_length -= length - 1;
+
+    if ( kind == TCPOptionTimestamps and length == TCPOptionTimestampsLen ) {
+      uint32_t tsval {};
+      uint32_t tsecr {};
+      parser.integer( tsval );
+      parser.integer( tsecr );
+      message.sender.TSval = tsval;
+      if ( message.receiver.ackno.has_value() ) {
+        message.receiver.TSecr = tsecr; // only meaningful with an ACK
+      }
+    } else {
+      parser.remove_prefix( length - 2 );
+    }
+  }
+  parser.remove_prefix( options_length ); // padding after the end of the options
+}
+
 class Wrap32Serializable : public Wrap32
 {
 public:
@@ -63,12 +110,41 @@ public:
 };
 
 void TCPSegment::serialize( Serializer& serializer ) const
+{
+  serialize_header( serializer );
+  serializer.buffer( message.sender.payload );
+}
+
+void TCPSegment::serialize( PacketBuffer& buffer,
+                            const string_view payload,
+                            const uint32_t datagram_layer_pseudo_checksum )
+{
+  if ( buffer.size() != 0 ) {
+    throw runtime_error( "TCPSegment::serialize: PacketBuffer already holds data" );
+  }
+
+  udinfo.cksum = 0;
+  const span<char> header = buffer.prepend( header_length() );
+  Serializer header_serializer { header };
+  serialize_header( header_serializer );
+
+  InternetChecksum check { datagram_layer_pseudo_checksum };
+  check.add( { header.data(), header.size() } );
+  buffer.append( payload, check );
+  udinfo.cksum = check.value();
+
+  // appending may have moved the buffer, so find the header again before patching it
+  Serializer patch { buffer.mutable_view().subspan( CHECKSUM_OFFSET, sizeof( udinfo.cksum ) ) };
+  patch.integer( udinfo.cksum );
+}
+
+void TCPSegment::serialize_header( Serializer& serializer ) const
 {
   serializer.integer( udinfo.src_port );
   serializer.integer( udinfo.dst_port );
   serializer.integer( Wrap32Serializable { message.sender.seqno }.raw_value() );
   serializer.integer( Wrap32Serializable { message.receiver.ackno.value_or( Wrap32 { 0 } ) }.raw_value() );
-  serializer.integer( uint8_t { TCPHeaderMinLen << 4 } ); // data offset
+  serializer.integer( static_cast<uint8_t>( header_length() / 4 << 4 ) ); // data offset
   const bool reset = message.sender.RST or message.receiver.RST;
   const uint8_t flags = ( message.receiver.ackno.has_value() ? 0b0001'0000U : 0 ) | ( reset ? 0b0000'0100U : 0 )
                         | ( message.sender.SYN ? 0b0000'0010U : 0 ) | ( message.sender.FIN ? 0b0000'0001U : 0 );
@@ -76,16 +152,27 @@ void TCPSegment::serialize( Serializer& serializer ) const
   serializer.integer( message.receiver.window_size );
   serializer.integer( udinfo.cksum );
   serializer.integer( uint16_t { 0 } ); // urgent pointer
-  serializer.buffer( message.sender.payload );
+
+  if ( message.sender.TSval.has_value() ) {
+    serializer.integer( TCPOptionNOP );
+    serializer.integer( TCPOptionNOP );
+    serializer.integer( TCPOptionTimestamps );
+    serializer.integer( TCPOptionTimestampsLen );
+    serializer.integer( message.sender.TSval.value() );
+    serializer.integer( message.receiver.TSecr.value_or( 0 ) );
+  }
 }
 
 void TCPSegment::compute_checksum( uint32_t datagram_layer_pseudo_checksum )
 {
   udinfo.cksum = 0;
-  Serializer s;
-  serialize( s );
+  array<char, MAX_HEADER_LENGTH> storage {};
+  const span<char> header = span { storage }.first( header_length() );
+  Serializer s { header };
+  serialize_header( s );
 
   InternetChecksum check { datagram_layer_pseudo_checksum };
-  check.add( s.output() );
+  check.add( { header.data(), header.size() } );
+  check.add( message.sender.payload );
   udinfo.cksum = check.value();
 }
@@ -13,11 +13,33 @@ struct TCPMessage
 
 struct TCPSegment
 {
+  static constexpr size_t HEADER_LENGTH = 20;                                    // not including options
+  static constexpr size_t TIMESTAMPS_LENGTH = 12;                                // NOP, NOP, timestamps option
+  static constexpr size_t MAX_HEADER_LENGTH = HEADER_LENGTH + TIMESTAMPS_LENGTH; // with every option we write
+
   TCPMessage message {};
   UserDatagramInfo udinfo {};
 
   void parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum );
   void serialize( Serializer& serializer ) const;
+  void serialize_header( Serializer& serializer ) const;
+
+  // Write the header into the headroom of an empty PacketBuffer and append `payload` behind it, computing the
+  // checksum while the payload is copied and then patching it into the header in place (sets udinfo.cksum).
+  // The payload is passed separately so that a caller holding it elsewhere need not copy it into `message`.
+  void serialize( PacketBuffer& buffer, std::string_view payload, uint32_t datagram_layer_pseudo_checksum );
 
   void compute_checksum( uint32_t datagram_layer_pseudo_checksum );
+
+  // The header length, including the options this segment (or one carrying `msg`) carries
+  size_t header_length() const { return header_length( message ); }
+  static size_t header_length( const TCPMessage& msg )
+  {
+    return HEADER_LENGTH + ( msg.sender.TSval.has_value() ? TIMESTAMPS_LENGTH : 0 );
+  }
+
+private:
+  void parse_options( Parser& parser, size_t options_length );
+
+  static constexpr size_t CHECKSUM_OFFSET = 16; // position of the checksum field within the header
 };
@@ -0,0 +1,41 @@
+#include "tcp_stats.hh"
+
+#include <iomanip>
+#include <sstream>
+
+using namespace std;
+
+ostream& operator<<( ostream& out, const TCPStats& stats )
+{
+  out << "sent: " << stats.bytes_sent << " bytes in " << stats.segments_sent << " segments, received: "
+      << stats.bytes_received << " bytes in " << stats.segments_received << " segments\n";
+
+  const auto predicted = stats.predicted_data + stats.predicted_acks;
+  out << "header prediction: " << predicted << " of " << stats.segments_received << " segments";
+  if ( stats.segments_received > 0 ) {
+    ostringstream rate; // keep the precision from sticking to `out`
+    rate << fixed << setprecision( 1 ) << 100.0 * static_cast<double>( predicted ) / stats.segments_received;
+    out << " (" << rate.str() << "%)";
+  }
+  out << ", " << stats.predicted_data << " with data and " << stats.predicted_acks << " bare acks\n";
+
+  out << "retransmits: " << stats.retransmits << ", timeouts: " << stats.timeouts << " ("
+      << stats.spurious_timeouts << " spurious), duplicate acks: " << stats.duplicate_acks
+      << ", loss probes: " << stats.loss_probes << ", rto: " << stats.rto_ms << " ms, srtt: ";
+  if ( stats.srtt_ms.has_value() ) {
+    ostringstream srtt; // keep the precision from sticking to `out`
+    srtt << fixed << setprecision( 1 ) << stats.srtt_ms.value();
+    out << srtt.str() << " ms\n";
+  } else {
+    out << "(none)\n";
+  }
+
+  out << "peer window: " << stats.peer_window << " bytes, zero window for " << stats.zero_window_ms
+      << " ms, window updates sent: " << stats.window_updates << "\n";
+
+  out << "reassembler pending: " << stats.reassembler_pending << " bytes, outbound: " << stats.outbound_buffered
+      << " bytes (max " << stats.outbound_high_water << "), inbound: " << stats.inbound_buffered << " bytes (max "
+      << stats.inbound_high_water << ")\n";
+
+  return out;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <ostream>
+
+//! \brief A snapshot of one connection's counters and state (in the spirit of Linux's TCP_INFO)
+//! \details Segment counts include retransmissions and bare acknowledgments.
+struct TCPStats
+{
+  //! \name Traffic
+  //!@{
+  uint64_t bytes_sent {};        //!< Payload bytes transmitted, including retransmissions
+  uint64_t segments_sent {};     //!< Segments transmitted
+  uint64_t bytes_received {};    //!< Payload bytes of the segments received
+  uint64_t segments_received {}; //!< Segments received
+  uint64_t predicted_data {};    //!< Segments received in order, with data, on the header-prediction fast path
+  uint64_t predicted_acks {};    //!< Bare acknowledgments received on the header-prediction fast path
+  //!@}
+
+  //! \name Loss recovery
+  //!@{
+  uint64_t retransmits {};          //!< Segments sent again
+  uint64_t timeouts {};             //!< Expirations of the retransmission timer
+  uint64_t spurious_timeouts {};    //!< Timeouts whose retransmission turned out to be unnecessary
+  uint64_t duplicate_acks {};       //!< Acknowledgments that acknowledged nothing new while data was outstanding
+  uint64_t loss_probes {};          //!< Tail loss probes sent (RACK-TLP)
+  uint64_t rto_ms {};               //!< Current retransmission timeout
+  std::optional<double> srtt_ms {}; //!< Smoothed round-trip time, once a sample has been taken
+  //!@}
+
+  //! \name Flow control
+  //!@{
+  uint64_t peer_window {};    //!< Latest window advertised by the peer
+  uint64_t zero_window_ms {}; //!< Time spent with a zero window from the peer
+  uint64_t window_updates {}; //!< Acknowledgments sent only to advertise a window the application opened
+  //!@}
+
+  //! \name Buffers
+  //!@{
+  uint64_t reassembler_pending {}; //!< Bytes held by the reassembler until the gap before them is filled
+  uint64_t outbound_buffered {};   //!< Bytes written by the application and not yet sent
+  uint64_t outbound_high_water {}; //!< Most bytes the outbound stream has held
+  uint64_t inbound_buffered {};    //!< Bytes received in order and not yet read by the application
+  uint64_t inbound_high_water {};  //!< Most bytes the inbound stream has held
+  //!@}
+};
+
+//! Print the statistics as a few lines of "name: value" pairs
+std::ostream& operator<<( std::ostream& out, const TCPStats& stats );
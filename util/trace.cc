@@ -0,0 +1,352 @@
+#include "trace.hh"
+
+#include "address.hh"
+#include "ethernet_header.hh"
+#include "exception.hh"
+#include "file_descriptor.hh"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+using namespace std;
+
+atomic<bool> Trace::enabled_ { false };
+
+namespace {
+
+// A dump is a header, then for each thread a section header and its records (oldest first)
+constexpr array<char, 8> DUMP_MAGIC { 'M', 'N', 'T', 'R', 'A', 'C', 'E', '1' };
+
+struct DumpHeader
+{
+  array<char, 8> magic;
+  uint32_t threads;
+  uint32_t record_size;
+};
+
+struct DumpSection
+{
+  uint32_t thread;
+  uint32_t records;
+};
+
+struct Ring
+{
+  array<TraceRecord, Trace::RING_SIZE> records {};
+  atomic<uint64_t> head {};    // records ever written; the newest is at (head - 1) % RING_SIZE
+  atomic<uint64_t> started {}; // records ever begun: head + 1 while one is being written, head otherwise
+};
+
+// Rings are never freed, so a thread's history outlives it (and a dump never races with a free)
+array<atomic<Ring*>, Trace::MAX_THREADS> rings {};
+atomic<size_t> threads_registered {};
+
+Ring* this_thread_ring()
+{
+  thread_local Ring* const ring = []() -> Ring* {
+    const size_t index = threads_registered.fetch_add( 1 );
+    if ( index >= Trace::MAX_THREADS ) {
+      return nullptr;
+    }
+    auto* const new_ring = new Ring; // NOLINT(*-owning-memory)
+    rings.at( index ).store( new_ring, memory_order_release );
+    return new_ring;
+  }();
+  return ring;
+}
+
+// Where to dump on a signal, kept in static storage for the signal handler
+array<char, 4096> signal_dump_path {};
+
+// Scratch space for copying a ring out before writing it, so records overwritten meanwhile can be left out
+array<TraceRecord, Trace::RING_SIZE> scratch {};
+atomic_flag dumping = ATOMIC_FLAG_INIT;
+
+void write_all( const int fd, const void* data, size_t len )
+{
+  const auto* bytes = static_cast<const char*>( data );
+  while ( len > 0 ) {
+    const ssize_t written = ::write( fd, bytes, len );
+    if ( written <= 0 ) {
+      return;
+    }
+    bytes += written;
+    len -= written;
+  }
+}
+
+string ethernet( const uint64_t packed )
+{
+  EthernetAddress address;
+  for ( size_t i = 0; i < address.size(); i++ ) {
+    address.at( i ) = static_cast<uint8_t>( packed >> ( 8 * ( address.size() - 1 - i ) ) );
+  }
+  return to_string( address );
+}
+
+string ip( const uint64_t numeric )
+{
+  return Address::from_ipv4_numeric( static_cast<uint32_t>( numeric ) ).ip();
+}
+
+string segment( const TraceRecord& record )
+{
+  ostringstream out;
+  out << "seqno=" << record.a;
+  constexpr array<pair<TraceFlag, const char*>, 3> flag_names {
+    { { TRACE_SYN, " +SYN" }, { TRACE_FIN, " +FIN" }, { TRACE_RST, " +RST" } } };
+  for ( const auto& [flag, name] : flag_names ) {
+    if ( record.flags & flag ) {
+      out << name;
+    }
+  }
+  out << " payload=" << record.b;
+  if ( record.flags & TRACE_ACK ) {
+    out << " ackno=" << ( record.c >> 32 );
+  }
+  out << " win=" << ( record.c & 0xffff'ffffU );
+  return out.str();
+}
+
+} // namespace
+
+void Trace::append( const TraceEvent event,
+                    const uint32_t a,
+                    const uint64_t b,
+                    const uint64_t c,
+                    const uint16_t flags )
+{
+  Ring* const ring = this_thread_ring();
+  if ( ring == nullptr ) {
+    return;
+  }
+  const uint64_t now
+    = chrono::duration_cast<chrono::nanoseconds>( chrono::steady_clock::now().time_since_epoch() ).count();
+  const uint64_t head = ring->head.load( memory_order_relaxed );
+  ring->started.store( head + 1, memory_order_relaxed );
+  atomic_thread_fence( memory_order_release ); // a dump that sees the new record's bytes sees `started` too
+  ring->records[head % RING_SIZE] = { now, event, flags, a, b, c };
+  ring->head.store( head + 1, memory_order_release );
+}
+
+void Trace::write_dump( const int fd )
+{
+  if ( dumping.test_and_set( memory_order_acquire ) ) {
+    return; // another thread is dumping (and using the scratch space)
+  }
+
+  const auto threads = static_cast<uint32_t>( min( threads_registered.load(), MAX_THREADS ) );
+  const DumpHeader header { DUMP_MAGIC, threads, sizeof( TraceRecord ) };
+  write_all( fd, &header, sizeof( header ) );
+
+  for ( uint32_t thread = 0; thread < threads; thread++ ) {
+    const Ring* const ring = rings.at( thread ).load( memory_order_acquire );
+    uint64_t first = 0;
+    uint64_t end = 0;
+    if ( ring != nullptr ) {
+      end = ring->head.load( memory_order_acquire );
+      first = end > RING_SIZE ? end - RING_SIZE : 0;
+      for ( uint64_t i = first; i < end; i++ ) {
+        scratch.at( i - first ) = ring->records.at( i % RING_SIZE );
+      }
+
+      // the thread kept writing while we copied: leave out the records it may have overwritten (including the
+      // one it may be writing now)
+      atomic_thread_fence( memory_order_acquire );
+      const uint64_t now_started = ring->started.load( memory_order_relaxed );
+      const uint64_t overwritten_before = now_started > RING_SIZE ? now_started - RING_SIZE : 0;
+      const uint64_t skip = overwritten_before > first ? min( overwritten_before, end ) - first : 0;
+      memmove( scratch.data(), scratch.data() + skip, ( end - first - skip ) * sizeof( TraceRecord ) );
+      first += skip;
+    }
+
+    const DumpSection section { thread, static_cast<uint32_t>( end - first ) };
+    write_all( fd, &section, sizeof( section ) );
+    write_all( fd, scratch.data(), section.records * sizeof( TraceRecord ) );
+  }
+
+  dumping.clear( memory_order_release );
+}
+
+void Trace::dump( const string& path )
+{
+  FileDescriptor file { CheckSystemCall( "open " + path,
+                                         ::open( path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 ) ) };
+  write_dump( file.fd_num() );
+}
+
+void Trace::handle_signal( const int signal )
+{
+  const int saved_errno = errno;
+  const int fd = ::open( signal_dump_path.data(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 );
+  if ( fd >= 0 ) {
+    write_dump( fd );
+    ::close( fd );
+  }
+  errno = saved_errno;
+
+  if ( signal != SIGUSR1 ) {
+    // the handler was reset to the default when it ran, so this kills the process as the signal would have
+    ::raise( signal );
+  }
+}
+
+void Trace::dump_on_signal( const string& path )
+{
+  if ( path.size() >= signal_dump_path.size() ) {
+    throw runtime_error( "Trace::dump_on_signal: path too long" );
+  }
+  ranges::copy( path, signal_dump_path.begin() );
+  signal_dump_path.at( path.size() ) = '\0';
+
+  struct sigaction action
+  {};
+  action.sa_handler = handle_signal;
+  sigemptyset( &action.sa_mask );
+  action.sa_flags = SA_RESTART;
+  CheckSystemCall( "sigaction", sigaction( SIGUSR1, &action, nullptr ) );
+
+  action.sa_flags = SA_RESETHAND;
+  for ( const int signal : { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT } ) {
+    CheckSystemCall( "sigaction", sigaction( signal, &action, nullptr ) );
+  }
+}
+
+void Trace::configure_from_environment()
+{
+  const char* const path = getenv( "MINNOW_TRACE" ); // NOLINT(*-mt-unsafe)
+  if ( path == nullptr or *path == '\0' ) {
+    return;
+  }
+  enable( true );
+  dump_on_signal( path );
+  atexit( [] {
+    const int fd = ::open( signal_dump_path.data(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 );
+    if ( fd >= 0 ) {
+      write_dump( fd );
+      ::close( fd );
+    }
+  } );
+}
+
+vector<pair<uint32_t, TraceRecord>> Trace::load( const string& path )
+{
+  ifstream file { path, ios::binary };
+  if ( not file ) {
+    throw runtime_error( "could not open " + path );
+  }
+
+  const auto read = [&]( auto& value ) {
+    if ( not file.read( reinterpret_cast<char*>( &value ), sizeof( value ) ) ) { // NOLINT(*-reinterpret-cast)
+      throw runtime_error( path + ": truncated trace" );
+    }
+  };
+
+  DumpHeader header {};
+  read( header );
+  if ( header.magic != DUMP_MAGIC or header.record_size != sizeof( TraceRecord ) ) {
+    throw runtime_error( path + ": not a trace from this version of minnow" );
+  }
+
+  vector<pair<uint32_t, TraceRecord>> records;
+  for ( uint32_t i = 0; i < header.threads; i++ ) {
+    DumpSection section {};
+    read( section );
+    for ( uint32_t j = 0; j < section.records; j++ ) {
+      TraceRecord record {};
+      read( record );
+      records.emplace_back( section.thread, record );
+    }
+  }
+
+  ranges::stable_sort( records, {}, []( const auto& entry ) { return entry.second.time_ns; } );
+  return records;
+}
+
+string to_string( const TraceRecord& record )
+{
+  ostringstream out;
+  switch ( record.event ) {
+    case TraceEvent::SegmentSent:
+      out << "segment sent: " << segment( record );
+      break;
+    case TraceEvent::SegmentReceived:
+      out << "segment received: " << segment( record );
+      break;
+    case TraceEvent::Retransmit:
+      out << "retransmit: abs_seqno=" << record.b << " length=" << ( record.c & 0xffff'ffffU )
+          << " rto=" << ( record.c >> 32 ) << "ms";
+      break;
+    case TraceEvent::Ack:
+      out << "ack: abs_ackno=" << record.b << " newly_acked=" << ( record.c & 0xffff'ffffU )
+          << " win=" << ( record.c >> 32 );
+      break;
+    case TraceEvent::InterfaceCreated:
+      out << "interface created: " << ip( record.a ) << " at " << ethernet( record.b );
+      break;
+    case TraceEvent::ArpRequestSent:
+      out << "ARP request sent: who has " << ip( record.a );
+      break;
+    case TraceEvent::ArpReplySent:
+      out << "ARP reply sent to " << ip( record.a );
+      break;
+    case TraceEvent::ArpLearned:
+      out << "ARP learned: " << ip( record.a ) << " is at " << ethernet( record.b );
+      break;
+    case TraceEvent::ArpFailed:
+      out << "ARP failed: " << ip( record.a ) << " did not answer, " << record.b << " datagrams dropped";
+      break;
+    case TraceEvent::RouteAdded:
+      out << "route added: " << ip( record.a ) << "/" << ( record.b & 0xff ) << " => "
+          << ( record.flags ? ip( record.b >> 32 ) : "(direct)" ) << " on interface " << record.c;
+      break;
+    case TraceEvent::RouteForwarded:
+      out << "routed: " << ip( record.a ) << " via " << ip( record.b ) << " on interface " << record.c;
+      break;
+    case TraceEvent::RouteDropped:
+      out << "dropped: " << ip( record.a )
+          << ( record.flags == TRACE_TTL_EXPIRED ? " (TTL expired)" : " (no route)" );
+      break;
+    case TraceEvent::OutboundClosed:
+      out << "outbound stream closed by the application, " << record.b << " seqnos in flight";
+      break;
+    case TraceEvent::OutboundAcked:
+      out << "outbound stream fully acknowledged";
+      break;
+    case TraceEvent::InboundFinished:
+      out << "inbound stream finished " << ( record.flags ? "uncleanly" : "cleanly" );
+      break;
+    case TraceEvent::Connecting:
+      out << "connecting to " << ip( record.a ) << ":" << record.b;
+      break;
+    case TraceEvent::Connected:
+      out << ( record.flags ? "error on connecting to " : "connected to " ) << ip( record.a ) << ":" << record.b;
+      break;
+    case TraceEvent::Listening:
+      out << "listening for an incoming connection";
+      break;
+    case TraceEvent::Accepted:
+      out << "new connection from " << ip( record.a ) << ":" << record.b;
+      break;
+    case TraceEvent::StreamError:
+      out << ( record.flags ? "inbound" : "outbound" ) << " stream had an error";
+      break;
+    case TraceEvent::Closing:
+      out << "waiting for the connection to close";
+      break;
+    case TraceEvent::ConnectionEnded:
+      out << "connection finished " << ( record.flags ? "uncleanly" : "cleanly" );
+      break;
+    default:
+      out << "unknown event " << static_cast<unsigned>( record.event );
+  }
+  return out.str();
+}
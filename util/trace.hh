@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Trace points compile to nothing when MINNOW_TRACE is 0 (configure with -DMINNOW_TRACE=OFF)
+#ifndef MINNOW_TRACE
+#define MINNOW_TRACE 1
+#endif
+
+//! The events that can be traced; the comment on each says what its record's fields hold
+enum class TraceEvent : uint16_t
+{
+  SegmentSent = 1,  //!< a: seqno, b: payload length, c: ackno << 32 | window; flags: TraceFlag
+  SegmentReceived,  //!< a: seqno, b: payload length, c: ackno << 32 | window; flags: TraceFlag
+  Retransmit,       //!< b: absolute seqno, c: RTO in ms (before backing off) << 32 | sequence length
+  Ack,              //!< b: absolute ackno, c: window << 32 | sequence numbers newly acknowledged
+  InterfaceCreated, //!< a: IP address, b: Ethernet address
+  ArpRequestSent,   //!< a: IP address being resolved
+  ArpReplySent,     //!< a: IP address of the requester
+  ArpLearned,       //!< a: IP address, b: Ethernet address
+  ArpFailed,        //!< a: IP address that did not resolve, b: datagrams dropped
+  RouteAdded,       //!< a: prefix, b: next hop << 32 | prefix length, c: interface; flags: 1 if next hop
+  RouteForwarded,   //!< a: destination, b: next hop, c: interface
+  RouteDropped,     //!< a: destination; flags: TraceDropReason
+  OutboundClosed,   //!< the application closed the outbound stream; b: sequence numbers in flight
+  OutboundAcked,    //!< the outbound stream was fully acknowledged
+  InboundFinished,  //!< the inbound stream ended; flags: 1 if it ended with an error
+  Connecting,       //!< a: destination IP address, b: destination port
+  Connected,        //!< a: destination IP address, b: destination port; flags: 1 if the connection failed
+  Listening,        //!< the socket is waiting for an incoming connection
+  Accepted,         //!< a: peer's IP address, b: peer's port
+  StreamError,      //!< the application's end of a stream had an error; flags: 1 if inbound, 0 if outbound
+  Closing,          //!< the application is waiting for the connection to close
+  ConnectionEnded,  //!< the connection is no longer active; flags: 1 if it ended with an error
+};
+
+//! Flags of the SegmentSent and SegmentReceived events
+enum TraceFlag : uint16_t
+{
+  TRACE_SYN = 1,
+  TRACE_FIN = 2,
+  TRACE_RST = 4,
+  TRACE_ACK = 8, //!< the ackno (in c) is valid
+};
+
+//! Why a router dropped a datagram
+enum TraceDropReason : uint16_t
+{
+  TRACE_TTL_EXPIRED = 1,
+  TRACE_NO_ROUTE = 2,
+};
+
+//! One event: a fixed-size binary record, so recording it is a handful of stores
+struct TraceRecord
+{
+  uint64_t time_ns; //!< steady_clock time
+  TraceEvent event;
+  uint16_t flags;
+  uint32_t a;
+  uint64_t b;
+  uint64_t c;
+};
+
+//! Decode a record's fields into words (without its time)
+std::string to_string( const TraceRecord& record );
+
+//! \brief Records events into per-thread ring buffers, to be dumped after a stall or crash
+//! \details Each thread writes to its own ring of the last RING_SIZE events, without locks; a record costs a
+//! clock read and a copy. While tracing is off (the default), a trace point costs one relaxed atomic load, and
+//! with MINNOW_TRACE set to 0 it costs nothing at all.
+//!
+//! A dump is a binary file (decoded by the `trace_dump` app) holding every thread's ring. Reading a ring while
+//! its thread writes to it is best-effort: records overwritten during the dump are left out.
+class Trace
+{
+public:
+  static constexpr size_t RING_SIZE = 4096; //!< Records kept per thread (a power of two)
+  static constexpr size_t MAX_THREADS = 64; //!< Threads that can trace (later ones are ignored)
+
+  //! Record an event (if tracing is on)
+  static void record( TraceEvent event, uint32_t a = 0, uint64_t b = 0, uint64_t c = 0, uint16_t flags = 0 )
+  {
+    if constexpr ( MINNOW_TRACE ) {
+      if ( enabled_.load( std::memory_order_relaxed ) ) {
+        append( event, a, b, c, flags );
+      }
+    }
+  }
+
+  static void enable( bool on ) { enabled_.store( on, std::memory_order_relaxed ); }
+  static bool enabled() { return enabled_.load( std::memory_order_relaxed ); }
+
+  //! Write every thread's ring to `path`
+  static void dump( const std::string& path );
+
+  //! Dump to `path` when the process receives SIGUSR1 (and carry on), or crashes with SIGSEGV, SIGBUS, SIGFPE,
+  //! SIGILL or SIGABRT (then die of the signal as usual)
+  static void dump_on_signal( const std::string& path );
+
+  //! If the environment variable MINNOW_TRACE names a file, turn tracing on, and dump to that file on a signal
+  //! and at exit
+  static void configure_from_environment();
+
+  //! Read a dump, returning each record with the index of the thread that recorded it, in order of time
+  static std::vector<std::pair<uint32_t, TraceRecord>> load( const std::string& path );
+
+private:
+  static void append( TraceEvent event, uint32_t a, uint64_t b, uint64_t c, uint16_t flags );
+  static void write_dump( int fd ); // async-signal-safe
+  static void handle_signal( int signal );
+
+  static std::atomic<bool> enabled_;
+};
@@ -1,21 +1,60 @@
 #include "tuntap_adapter.hh"
+#include "packet_pool.hh"
 #include "parser.hh"
 
+#include <vector>
+
 using namespace std;
 
+bool TCPOverIPv4OverTunFdAdapter::_read_datagram( optional<TCPMessage>& segment )
+{
+  auto datagram = PacketPool::global().acquire();
+  datagram.resize( _tun.read( datagram.buffer() ) );
+  if ( datagram.size() == 0 ) {
+    return false;
+  }
+  capture( datagram.view() );
+
+  segment = unwrap_tcp_in_ip( datagram.view() );
+  return true;
+}
+
 optional<TCPMessage> TCPOverIPv4OverTunFdAdapter::read()
 {
-  vector<string> strs( 2 );
-  strs.front().resize( IPv4Header::LENGTH );
-  _tun.read( strs );
-
-  InternetDatagram ip_dgram;
-  const vector<string> buffers = { strs.at( 0 ), strs.at( 1 ) };
-  if ( parse( ip_dgram, buffers ) ) {
-    return unwrap_tcp_in_ip( ip_dgram );
+  optional<TCPMessage> segment;
+  _read_datagram( segment );
+  return segment;
+}
+
+void TCPOverIPv4OverTunFdAdapter::read_batch( vector<TCPMessage>& segments, const size_t max_datagrams )
+{
+  optional<TCPMessage> segment;
+  for ( size_t i = 0; i < max_datagrams and _read_datagram( segment ); i++ ) {
+    if ( segment.has_value() ) {
+      segments.push_back( std::move( segment.value() ) );
+    }
   }
-  return {};
+}
+
+void TCPOverIPv4OverTunFdAdapter::write( const TCPMessage& seg )
+{
+  if ( HEADROOM + seg.sender.payload.size() > PacketPool::BUFFER_SIZE ) {
+    PacketBuffer packet { HEADROOM, seg.sender.payload.size() };
+    wrap_tcp_in_ip( seg, packet );
+    capture( packet.view() );
+    _tun.write( packet.view() );
+    return;
+  }
+
+  auto storage = PacketPool::global().acquire();
+  PacketBuffer packet { storage.buffer(), HEADROOM };
+  wrap_tcp_in_ip( seg, packet );
+  capture( packet.view() );
+  _tun.write( packet.view() );
 }
 
 //! Specialize LossyFdAdapter to TCPOverIPv4OverTunFdAdapter
 template class LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>;
+
+//! Specialize EmulatedFdAdapter to the lossy TCPOverIPv4OverTunFdAdapter
+template class EmulatedFdAdapter<LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>>;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "emulated_fd_adapter.hh"
 #include "tcp_over_ip.hh"
 #include "tcp_segment.hh"
 #include "tun.hh"
@@ -7,9 +8,10 @@
 #include <optional>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 template<class T>
-concept TCPDatagramAdapter = requires( T a, TCPMessage seg ) {
+concept TCPDatagramAdapter = requires( T a, TCPMessage seg, std::vector<TCPMessage>& segments ) {
                                {
                                  a.write( seg )
                                  } -> std::same_as<void>;
@@ -17,6 +19,10 @@ concept TCPDatagramAdapter = requires( T a, TCPMessage seg ) {
                                {
                                  a.read()
                                  } -> std::same_as<std::optional<TCPMessage>>;
+
+                               {
+                                 a.read_batch( segments, size_t {} )
+                                 } -> std::same_as<void>;
                              };
 
 //! \brief A FD adapter for IPv4 datagrams read from and written to a TUN device
@@ -25,15 +31,22 @@ class TCPOverIPv4OverTunFdAdapter : public TCPOverIPv4Adapter
 private:
   TunFD _tun;
 
+  //! Read one datagram if one is waiting, and parse it (false if none was waiting)
+  bool _read_datagram( std::optional<TCPMessage>& segment );
+
 public:
-  //! Construct from a TunFD
-  explicit TCPOverIPv4OverTunFdAdapter( TunFD&& tun ) : _tun( std::move( tun ) ) {}
+  //! Construct from a TunFD (which is made non-blocking, so that read_batch can read until none are waiting)
+  explicit TCPOverIPv4OverTunFdAdapter( TunFD&& tun ) : _tun( std::move( tun ) ) { _tun.set_blocking( false ); }
 
   //! Attempts to read and parse an IPv4 datagram containing a TCP segment related to the current connection
   std::optional<TCPMessage> read();
 
+  //! Reads up to `max_datagrams` of the datagrams waiting (without blocking), and appends the TCP segments
+  //! among them to `segments`
+  void read_batch( std::vector<TCPMessage>& segments, size_t max_datagrams );
+
   //! Creates an IPv4 datagram from a TCP segment and writes it to the TUN device
-  void write( const TCPMessage& seg ) { _tun.write( serialize( wrap_tcp_in_ip( seg ) ) ); }
+  void write( const TCPMessage& seg );
 
   //! Access the underlying TUN device
   explicit operator TunFD&() { return _tun; }
@@ -47,3 +60,4 @@ public:
 
 static_assert( TCPDatagramAdapter<TCPOverIPv4OverTunFdAdapter> );
 static_assert( TCPDatagramAdapter<LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>> );
+static_assert( TCPDatagramAdapter<EmulatedFdAdapter<LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>>> );